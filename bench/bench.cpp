@@ -0,0 +1,502 @@
+// Stage-level benchmarks: each pipeline stage on the dataset images and on
+// synthetic inputs of growing size. Results are printed as JSON so runs of
+// different builds can be compared.
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "dataloader.hpp"
+#include "detection.hpp"
+#include "feature_cache.hpp"
+#include "matching.hpp"
+#include "object_localizer.hpp"
+#include "percentile.hpp"
+#include "pipeline.hpp"
+#include "preprocessing.hpp"
+#include "simd_matcher.hpp"
+#include "text_escape.hpp"
+
+namespace fs = std::filesystem;
+
+// Command line options
+struct BenchOptions
+{
+    fs::path dataPath = "../data/object_detection_dataset/";
+    fs::path cachePath = "../data/cache/";
+    std::string outPath;       // JSON output file (empty = stdout)
+    std::string filter;        // run only cases whose name contains this
+    size_t iterations = 20;    // timed iterations per synthetic case
+    size_t imagesPerObject = 4; // dataset images per object (0 = all)
+    bool skipDataset = false;
+    bool skipSynthetic = false;
+};
+
+// Latency distribution and throughput of one case
+struct BenchResult
+{
+    std::string name;
+    std::string input;   // "dataset" or a description of the synthetic size
+    size_t samples = 0;  // timed calls
+    double itemsPerCall = 1.0;
+    double p50Ms = 0.0;
+    double p99Ms = 0.0;
+    double meanMs = 0.0;
+    double throughput = 0.0; // items per second
+};
+
+class BenchRunner
+{
+public:
+    explicit BenchRunner(const BenchOptions &options) : options_(options) {}
+
+    // Time fn() `iterations` times after one warm-up call; items is the number
+    // of work items (images, descriptors, points) a call processes
+    void run(const std::string &name, const std::string &input, size_t iterations, double items,
+             const std::function<void()> &fn)
+    {
+        if (!options_.filter.empty() && name.find(options_.filter) == std::string::npos)
+            return;
+        fn();
+        std::vector<double> ms;
+        ms.reserve(iterations);
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        record(name, input, items, ms);
+    }
+
+    // Time fn(i) once for every i in [0, count), e.g. once per dataset image
+    void runEach(const std::string &name, const std::string &input, size_t count,
+                 const std::function<void(size_t)> &fn)
+    {
+        if (!options_.filter.empty() && name.find(options_.filter) == std::string::npos)
+            return;
+        if (count == 0)
+            return;
+        fn(0);
+        std::vector<double> ms;
+        ms.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn(i);
+            ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        record(name, input, 1.0, ms);
+    }
+
+    const std::vector<BenchResult> &results() const { return results_; }
+
+private:
+    void record(const std::string &name, const std::string &input, double items, std::vector<double> &ms)
+    {
+        BenchResult r;
+        r.name = name;
+        r.input = input;
+        r.samples = ms.size();
+        r.itemsPerCall = items;
+        if (!ms.empty())
+        {
+            std::sort(ms.begin(), ms.end());
+            double total = 0.0;
+            for (double v : ms)
+                total += v;
+            r.meanMs = total / ms.size();
+            r.p50Ms = percentile(ms, 0.5);
+            r.p99Ms = percentile(ms, 0.99);
+            r.throughput = total > 0.0 ? items * ms.size() / (total / 1000.0) : 0.0;
+        }
+        std::cerr << "  " << std::left << std::setw(28) << name << std::setw(20) << input << std::right
+                  << " p50 " << std::fixed << std::setprecision(3) << r.p50Ms << " ms"
+                  << "  p99 " << r.p99Ms << " ms" << std::endl;
+        results_.push_back(r);
+    }
+
+    const BenchOptions &options_;
+    std::vector<BenchResult> results_;
+};
+
+static void printUsage()
+{
+    std::cerr << "Usage: bench [--data DIR] [--cache DIR] [--out FILE] [--filter NAME]"
+              << " [--iterations N] [--images-per-object N] [--no-dataset] [--no-synthetic]" << std::endl;
+}
+
+// Whole counts only; anything else (trailing characters, a sign, out of range) throws
+static size_t parseCount(const std::string &value)
+{
+    size_t pos = 0;
+    if (value.empty() || value[0] == '-' || value[0] == '+')
+        throw std::invalid_argument(value);
+    unsigned long long n = std::stoull(value, &pos);
+    if (pos != value.size() || n > std::numeric_limits<size_t>::max())
+        throw std::out_of_range(value);
+    return static_cast<size_t>(n);
+}
+
+static bool parseOptions(int argc, char **argv, BenchOptions &options)
+{
+    std::string arg;
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            arg = argv[i];
+            if (arg == "--data" && i + 1 < argc)
+                options.dataPath = argv[++i];
+            else if (arg == "--cache" && i + 1 < argc)
+                options.cachePath = argv[++i];
+            else if (arg == "--out" && i + 1 < argc)
+                options.outPath = argv[++i];
+            else if (arg == "--filter" && i + 1 < argc)
+                options.filter = argv[++i];
+            else if (arg == "--iterations" && i + 1 < argc)
+            {
+                options.iterations = parseCount(argv[++i]);
+                if (options.iterations == 0)
+                    throw std::invalid_argument(arg);
+            }
+            else if (arg == "--images-per-object" && i + 1 < argc)
+                options.imagesPerObject = parseCount(argv[++i]);
+            else if (arg == "--no-dataset")
+                options.skipDataset = true;
+            else if (arg == "--no-synthetic")
+                options.skipSynthetic = true;
+            else
+            {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                printUsage();
+                return false;
+            }
+        }
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << "Invalid value for " << arg << std::endl;
+        printUsage();
+        return false;
+    }
+    return true;
+}
+
+// Textured grayscale image: smoothed noise with random rectangles and circles
+static cv::Mat syntheticImage(int width, int height, cv::RNG &rng)
+{
+    cv::Mat noise(height, width, CV_8U);
+    rng.fill(noise, cv::RNG::UNIFORM, 0, 256);
+    cv::Mat img;
+    cv::GaussianBlur(noise, img, cv::Size(0, 0), 3.0);
+    int shapes = width * height / 4000;
+    for (int i = 0; i < shapes; ++i)
+    {
+        cv::Point p(rng.uniform(0, width), rng.uniform(0, height));
+        int size = rng.uniform(4, 40);
+        cv::Scalar color(rng.uniform(0, 256));
+        if (i % 2)
+            cv::rectangle(img, cv::Rect(p.x, p.y, size, size), color, cv::FILLED);
+        else
+            cv::circle(img, p, size / 2, color, cv::FILLED);
+    }
+    return img;
+}
+
+// Random SIFT-like descriptors (non-negative, L2 norm 512)
+static cv::Mat syntheticDescriptors(int rows, cv::RNG &rng)
+{
+    cv::Mat desc(rows, 128, CV_32F);
+    rng.fill(desc, cv::RNG::UNIFORM, 0.0, 1.0);
+    for (int r = 0; r < rows; ++r)
+    {
+        cv::Mat row = desc.row(r);
+        cv::normalize(row, row, 512.0, 0.0, cv::NORM_L2);
+    }
+    return desc;
+}
+
+// Model/test keypoints related by a homography, with a fraction of outlier matches
+struct SyntheticCorrespondences
+{
+    std::vector<cv::KeyPoint> model;
+    std::vector<cv::KeyPoint> test;
+    std::vector<cv::DMatch> matches;
+    cv::Size modelSize;
+};
+
+static SyntheticCorrespondences syntheticCorrespondences(int count, double outlierRatio, cv::RNG &rng)
+{
+    SyntheticCorrespondences c;
+    c.modelSize = cv::Size(400, 400);
+    cv::Mat H = (cv::Mat_<double>(3, 3) << 0.9, -0.1, 120.0, 0.12, 0.95, 80.0, 1e-4, -5e-5, 1.0);
+    std::vector<cv::Point2f> src, dst;
+    for (int i = 0; i < count; ++i)
+        src.emplace_back(rng.uniform(0.f, 400.f), rng.uniform(0.f, 400.f));
+    cv::perspectiveTransform(src, dst, H);
+    for (int i = 0; i < count; ++i)
+    {
+        cv::Point2f t = dst[i];
+        bool inlier = rng.uniform(0.0, 1.0) >= outlierRatio;
+        if (!inlier)
+            t = cv::Point2f(rng.uniform(0.f, 640.f), rng.uniform(0.f, 480.f));
+        else
+            t += cv::Point2f(static_cast<float>(rng.gaussian(0.5)), static_cast<float>(rng.gaussian(0.5)));
+        c.model.emplace_back(src[i], 4.0f);
+        c.test.emplace_back(t, 4.0f);
+        // Inliers tend to have smaller descriptor distances, as after the ratio test
+        c.matches.emplace_back(i, i, rng.uniform(inlier ? 50.f : 120.f, inlier ? 250.f : 320.f));
+    }
+    return c;
+}
+
+// Points drawn around a few cluster centres plus uniform background
+static std::vector<cv::Point2f> syntheticClusterPoints(int count, cv::RNG &rng)
+{
+    const cv::Point2f centers[] = {{160, 120}, {420, 300}, {520, 90}};
+    std::vector<cv::Point2f> points;
+    points.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        if (i % 5 == 4)
+        {
+            points.emplace_back(rng.uniform(0.f, 640.f), rng.uniform(0.f, 480.f));
+            continue;
+        }
+        const cv::Point2f &c = centers[i % 3];
+        points.emplace_back(c.x + static_cast<float>(rng.gaussian(20.0)), c.y + static_cast<float>(rng.gaussian(20.0)));
+    }
+    return points;
+}
+
+// Stages on synthetic inputs of growing size
+static void runSynthetic(BenchRunner &bench, const BenchOptions &options, const FeatureExtractor &extractor)
+{
+    cv::RNG rng(12345);
+    const size_t iters = options.iterations;
+
+    const cv::Size imageSizes[] = {{320, 240}, {640, 480}, {1280, 960}, {1920, 1440}};
+    for (const cv::Size &size : imageSizes)
+    {
+        cv::Mat img = syntheticImage(size.width, size.height, rng);
+        std::string input = std::to_string(size.width) + "x" + std::to_string(size.height);
+        double mpix = size.area() / 1e6;
+        bench.run("reduce_noise", input, iters, mpix, [&]
+                  { cv::Mat out = Preprocessing::reduceNoise(img); });
+        bench.run("reduce_noise_" + std::string(denoiseModeName(DenoiseMode::Guided)), input, iters, mpix, [&]
+                  { cv::Mat out = Preprocessing::reduceNoise(img, DenoiseMode::Guided); });
+        bench.run("reduce_noise_" + std::string(denoiseModeName(DenoiseMode::Recursive)), input, iters, mpix, [&]
+                  { cv::Mat out = Preprocessing::reduceNoise(img, DenoiseMode::Recursive); });
+        bench.run("extract_features", input, std::max<size_t>(3, iters / 4), mpix, [&]
+                  { ImageFeatures f = extractor.extract(img); });
+    }
+
+    const int descriptorCounts[] = {256, 1024, 4096};
+    for (int n : descriptorCounts)
+    {
+        cv::Mat model = syntheticDescriptors(n, rng);
+        cv::Mat test = syntheticDescriptors(n, rng);
+        std::string input = std::to_string(n) + "x" + std::to_string(n);
+        bench.run("match_descriptors_opencv", input, iters, n, [&]
+                  { auto m = Matching::matchDescriptors(model, test, 0.75f, MatcherBackend::OpenCV); });
+        bench.run("match_descriptors_simd", input, iters, n, [&]
+                  { auto m = Matching::matchDescriptors(model, test, 0.75f, MatcherBackend::Simd); });
+    }
+
+    const int correspondenceCounts[] = {100, 1000, 5000};
+    for (int n : correspondenceCounts)
+    {
+        SyntheticCorrespondences c = syntheticCorrespondences(n, 0.4, rng);
+        std::string input = std::to_string(n) + " matches";
+        bench.run("ransac_inliers", input, iters, n, [&]
+                  { auto in = Matching::findRansacInliers(c.model, c.test, c.matches); });
+        bench.run("verify_prosac", input, iters, n, [&]
+                  { auto v = Matching::verifyHomography(c.model, c.test, c.matches, 3.0, RansacMethod::Prosac); });
+        bench.run("bbox_from_homography", input, iters, n, [&]
+                  { cv::Rect box = ObjectLocalizer::getBoundingBoxFromHomography(c.model, c.test, c.matches, c.modelSize); });
+    }
+
+    const int pointCounts[] = {100, 1000, 10000};
+    for (int n : pointCounts)
+    {
+        std::vector<cv::Point2f> points = syntheticClusterPoints(n, rng);
+        bench.run("cluster_mean_shift", std::to_string(n) + " points", iters, n, [&]
+                  { auto cluster = ObjectLocalizer::clusterMeanShift(points, 45.0); });
+    }
+}
+
+// Stages on the dataset test images, matched against their own object
+static void runDataset(BenchRunner &bench, const BenchOptions &options, const FeatureExtractor &extractor)
+{
+    FileSystemDataLoader loader;
+    if (loader.checkIntegrity(options.dataPath) != IntegrityCode::OK)
+    {
+        std::cerr << "Dataset not found at " << options.dataPath << ", skipping dataset cases" << std::endl;
+        return;
+    }
+
+    FeatureCache cache(options.cachePath);
+    std::vector<ObjectModel> objects;
+    std::vector<cv::Mat> grays;
+    std::vector<size_t> imageObject;
+    for (const auto &key : loader.listObjectKeys(options.dataPath))
+    {
+        objects.push_back(loadObjectModel(loader, options.dataPath, key, getObjectParams(key), extractor, cache));
+        size_t taken = 0;
+        for (const auto &ti : loader.listTestImages(options.dataPath, key))
+        {
+            if (options.imagesPerObject && taken == options.imagesPerObject)
+                break;
+            cv::Mat gray = loader.loadTestImage(ti);
+            if (gray.empty())
+                continue;
+            grays.push_back(gray);
+            imageObject.push_back(objects.size() - 1);
+            ++taken;
+        }
+    }
+    const std::string input = "dataset";
+    const size_t n = grays.size();
+
+    std::vector<cv::Mat> processed(n);
+    bench.runEach("reduce_noise", input, n, [&](size_t i)
+                  { processed[i] = Preprocessing::reduceNoise(grays[i]); });
+
+    std::vector<ImageFeatures> features(n);
+    bench.runEach("extract_features", input, n, [&](size_t i)
+                  { features[i] = extractor.extract(processed[i]); });
+
+    // Best view per image, for the per-view stages
+    std::vector<ObjectMatches> matches(n);
+    std::vector<int> bestView(n, -1);
+    for (size_t i = 0; i < n; ++i)
+    {
+        matches[i] = matchObject(objects[imageObject[i]], features[i]);
+        size_t best = 0;
+        for (size_t v = 0; v < matches[i].viewMatches.size(); ++v)
+        {
+            if (matches[i].viewMatches[v].size() > best)
+            {
+                best = matches[i].viewMatches[v].size();
+                bestView[i] = static_cast<int>(v);
+            }
+        }
+    }
+
+    bench.runEach("match_descriptors_opencv", input, n, [&](size_t i)
+                  {
+                      if (bestView[i] >= 0)
+                          Matching::matchDescriptors(objects[imageObject[i]].views[bestView[i]].descriptors,
+                                                     features[i].descriptors, 0.75f, MatcherBackend::OpenCV);
+                  });
+    bench.runEach("match_descriptors_simd", input, n, [&](size_t i)
+                  {
+                      if (bestView[i] >= 0)
+                          Matching::matchDescriptors(objects[imageObject[i]].views[bestView[i]].descriptors,
+                                                     features[i].descriptors, 0.75f, MatcherBackend::Simd);
+                  });
+    bench.runEach("gallery_match", input, n, [&](size_t i)
+                  { objects[imageObject[i]].gallery.matchViews(features[i].descriptors); });
+    bench.runEach("ransac_inliers", input, n, [&](size_t i)
+                  {
+                      if (bestView[i] >= 0)
+                          Matching::findRansacInliers(objects[imageObject[i]].views[bestView[i]].keypoints,
+                                                      features[i].keypoints, matches[i].viewMatches[bestView[i]]);
+                  });
+    bench.runEach("verify_prosac", input, n, [&](size_t i)
+                  {
+                      if (bestView[i] >= 0)
+                          Matching::verifyHomography(objects[imageObject[i]].views[bestView[i]].keypoints,
+                                                     features[i].keypoints, matches[i].viewMatches[bestView[i]],
+                                                     3.0, RansacMethod::Prosac);
+                  });
+    bench.runEach("bbox_from_homography", input, n, [&](size_t i)
+                  {
+                      if (bestView[i] < 0)
+                          return;
+                      const ViewFeatures &view = objects[imageObject[i]].views[bestView[i]];
+                      ObjectLocalizer::getBoundingBoxFromHomography(view.keypoints, features[i].keypoints,
+                                                                    matches[i].viewVerification[bestView[i]].inliers,
+                                                                    view.maskSize);
+                  });
+    bench.runEach("cluster_mean_shift", input, n, [&](size_t i)
+                  {
+                      if (bestView[i] < 0)
+                          return;
+                      const ObjectModel &object = objects[imageObject[i]];
+                      auto points = ObjectLocalizer::extractDetectedPoints(
+                          object.views[bestView[i]].keypoints, features[i].keypoints, matches[i].viewMatches[bestView[i]]);
+                      ObjectLocalizer::clusterMeanShift(points, object.params.clusterBandwidth);
+                  });
+    bench.runEach("pipeline", input, n, [&](size_t i)
+                  {
+                      const ObjectModel &object = objects[imageObject[i]];
+                      ImageFeatures f = extractTestFeatures(extractor, grays[i], object.params.denoise);
+                      detectObject(object, f, grays[i].size());
+                  });
+}
+
+static void writeJson(std::ostream &out, const std::vector<BenchResult> &results)
+{
+    out << "{\n"
+        << "  \"opencv\": \"" << CV_VERSION << "\",\n"
+        << "  \"isa\": \"" << SimdMatcher::isaName(SimdMatcher::detectIsa()) << "\",\n"
+        << "  \"opencv_threads\": " << cv::getNumThreads() << ",\n"
+        << "  \"results\": [\n";
+    out << std::fixed << std::setprecision(4);
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult &r = results[i];
+        out << "    {\"name\": \"" << jsonEscape(r.name) << "\", \"input\": \"" << jsonEscape(r.input) << "\""
+            << ", \"samples\": " << r.samples
+            << ", \"items_per_call\": " << r.itemsPerCall
+            << ", \"p50_ms\": " << r.p50Ms
+            << ", \"p99_ms\": " << r.p99Ms
+            << ", \"mean_ms\": " << r.meanMs
+            << ", \"throughput_per_s\": " << r.throughput << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    // Single-threaded stage latencies
+    cv::setNumThreads(1);
+    FeatureExtractor extractor;
+    BenchRunner bench(options);
+
+    if (!options.skipSynthetic)
+        runSynthetic(bench, options, extractor);
+    if (!options.skipDataset)
+        runDataset(bench, options, extractor);
+
+    if (options.outPath.empty())
+    {
+        writeJson(std::cout, bench.results());
+    }
+    else
+    {
+        std::ofstream out(options.outPath);
+        if (!out.is_open())
+        {
+            std::cerr << "Failed to open " << options.outPath << std::endl;
+            return 1;
+        }
+        writeJson(out, bench.results());
+    }
+    return 0;
+}
@@ -0,0 +1,549 @@
+#include "dataset_runner.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include "detector_stages.hpp"
+#include "result_records.hpp"
+#include "stage_pipeline.hpp"
+#include "trace.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Output produced while processing one test image
+    struct ImageReport
+    {
+        std::ostringstream console; // detail text
+        std::ostringstream errors;
+        std::ostringstream log;     // detail text for the text log
+        std::ostringstream summary; // one line per image
+        ImageRecord record;         // structured result
+    };
+
+    // Measures the wall time of the enclosing scope into a StageTimings field
+    class StepTimer
+    {
+    public:
+        explicit StepTimer(double &ms) : ms_(ms), start_(std::chrono::steady_clock::now()) {}
+        ~StepTimer()
+        {
+            ms_ += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+        }
+
+    private:
+        double &ms_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // Writes image reports in input order while images complete out of order.
+    // Records go to the results writer; text goes out only at the selected verbosity,
+    // one write per image without flushing.
+    class OrderedEmitter
+    {
+    public:
+        OrderedEmitter(size_t count, std::ofstream &logFile, ResultsWriter &writer, Verbosity verbosity)
+            : reports_(count), ready_(count, false), logFile_(logFile), writer_(writer), verbosity_(verbosity) {}
+
+        void complete(size_t index, ImageReport &&report)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            reports_[index] = std::move(report);
+            ready_[index] = true;
+            while (next_ < reports_.size() && ready_[next_])
+            {
+                ImageReport &r = reports_[next_];
+                if (verbosity_ == Verbosity::Detail)
+                {
+                    std::cout << r.console.str();
+                    logFile_ << r.log.str();
+                }
+                else if (verbosity_ == Verbosity::Summary)
+                {
+                    std::cout << r.summary.str();
+                    logFile_ << r.summary.str();
+                }
+                std::cerr << r.errors.str();
+                writer_.submit(std::move(r.record));
+                r = ImageReport();
+                ++next_;
+            }
+        }
+
+    private:
+        std::vector<ImageReport> reports_;
+        std::vector<bool> ready_;
+        size_t next_ = 0;
+        std::ofstream &logFile_;
+        ResultsWriter &writer_;
+        Verbosity verbosity_;
+        std::mutex mutex_;
+    };
+
+    // A test image moving through the detection steps
+    struct ImageJob
+    {
+        size_t index = 0;
+        TestImage image;
+        bool failed = false;  // set by a step; later steps skip the job
+        int traceImage = -1;  // image id in the trace (tracing builds only)
+        DetectionJob work;    // state of the detector stages
+        ImageReport report;
+    };
+
+    // Settings shared by all steps of a run
+    struct JobContext
+    {
+        DetectorStages stages;
+        ResultRenderer &renderer; // result images, drawn and encoded in the background
+        fs::path outDir;
+        bool sceneMode;
+        ThreadPool *pool; // parallelizes per-view RANSAC (batch executor only)
+    };
+
+    // Step 1: decode the test image
+    void decodeStep(ImageJob &job, const JobContext &ctx)
+    {
+        const TestImage &ti = job.image;
+        job.report.record.image = ti.name;
+        if (!ctx.sceneMode)
+        {
+            job.report.console << "  Processing test image: " << ti.name << "\n";
+            job.report.log << "  Processing test image: " << ti.name << "\n";
+        }
+        else
+        {
+            job.report.console << "Processing scene: " << ti.name << "\n";
+            job.report.log << "Processing scene: " << ti.name << "\n";
+        }
+
+        // Straight to grayscale; the colour image is decoded only if a result image is saved
+        ctx.stages.decode(job.work, ti.path);
+        if (job.work.failed())
+        {
+            job.report.errors << "  Failed to read image: " << ti.name << "\n";
+            job.report.log << "  Failed to read image: " << ti.name << "\n";
+            job.report.record.error = "failed to read image";
+            job.failed = true;
+        }
+    }
+
+    // Step 2: reduce noise
+    void preprocessStep(ImageJob &job, const JobContext &ctx)
+    {
+        if (job.failed)
+            return;
+        ctx.stages.preprocess(job.work);
+    }
+
+    // Step 3: detect keypoints and compute descriptors
+    void featuresStep(ImageJob &job, const JobContext &ctx)
+    {
+        if (job.failed)
+            return;
+        ctx.stages.extractFeatures(job.work);
+        if (job.work.failed())
+        {
+            job.report.errors << "  Warning: No descriptors found in test image: " << job.image.name << "\n";
+            job.report.log << "  Warning: No descriptors found in test image: " << job.image.name << "\n";
+            job.report.record.error = job.work.output.error;
+            job.failed = true;
+        }
+    }
+
+    // Step 4: match against every target gallery and verify views with RANSAC
+    void matchStep(ImageJob &job, const JobContext &ctx)
+    {
+        if (job.failed)
+            return;
+        ctx.stages.match(job.work, ctx.pool);
+    }
+
+    // Step 5: localize every target (and refine it at full resolution in coarse-to-fine mode)
+    void localizeStep(ImageJob &job, const JobContext &ctx)
+    {
+        if (job.failed)
+            return;
+        ctx.stages.localize(job.work, ctx.pool);
+    }
+
+    // Report the result of a single-object search and queue its result image
+    void encodeObjectResult(ImageJob &job, const JobContext &ctx)
+    {
+        const TestImage &ti = job.image;
+        const ObjectModel &object = *job.work.targets[0];
+        const DetectionResult &result = job.work.output.objects[0];
+
+        for (const auto &vs : result.viewStats)
+        {
+            job.report.console << "    Model View: " << vs.name
+                               << " - Good Matches: " << vs.goodMatches
+                               << " - Inliers: " << vs.inliers << "\n";
+            job.report.log << "    Model View: " << vs.name
+                           << " - Good Matches: " << vs.goodMatches
+                           << " - Inliers: " << vs.inliers << "\n";
+        }
+
+        if (result.detected)
+        {
+            const cv::Rect &detectedBox = result.box;
+            ctx.renderer.submit(RenderTask{ti.path, ctx.outDir, {result}, false});
+
+            // Log detection
+            job.report.log << "  " << ti.name << ": Object detected at "
+                           << detectedBox.x << "," << detectedBox.y << " - "
+                           << detectedBox.x + detectedBox.width << ","
+                           << detectedBox.y + detectedBox.height
+                           << " (matches: " << result.matches
+                           << ", inliers: " << result.inliers << ")\n";
+        }
+        else if (result.matches >= object.params.matchesThreshold)
+        {
+            job.report.console << "  No valid bounding box found for: " << ti.name << "\n";
+            job.report.log << "  " << ti.name << ": No valid bounding box found\n";
+        }
+        else
+        {
+            job.report.console << "  Not enough matches for image: " << ti.name << "\n";
+            job.report.log << "  " << ti.name << ": Not enough matches (best: " << result.matches
+                           << ", inliers: " << result.inliers << ")\n";
+        }
+    }
+
+    // Report all detections of a scene search and queue its result image
+    void encodeSceneResult(ImageJob &job, const JobContext &ctx)
+    {
+        const TestImage &ti = job.image;
+
+        RenderTask render{ti.path, ctx.outDir, {}, true};
+        for (const auto &result : job.work.output.objects)
+        {
+            if (!result.detected)
+                continue;
+            render.results.push_back(result);
+
+            const cv::Rect &box = result.box;
+            job.report.console << "  " << result.objectKey << ": " << box.x << "," << box.y << " - "
+                               << box.x + box.width << "," << box.y + box.height << "\n";
+            job.report.log << "  " << ti.name << ": " << result.objectKey << " detected at "
+                           << box.x << "," << box.y << " - "
+                           << box.x + box.width << "," << box.y + box.height
+                           << " (matches: " << result.matches
+                           << ", inliers: " << result.inliers
+                           << ", strategy: " << strategyName(result.strategy) << ")\n";
+        }
+
+        if (render.results.empty())
+        {
+            job.report.console << "  No objects detected\n";
+            job.report.log << "  " << ti.name << ": No objects detected\n";
+            return;
+        }
+        ctx.renderer.submit(std::move(render));
+    }
+
+    // Fill the structured record and the one-line summary from the results
+    void recordResults(ImageJob &job)
+    {
+        ImageRecord &record = job.report.record;
+        std::ostringstream &summary = job.report.summary;
+        const StageTimings &stages = job.work.output.timings;
+        record.keypoints = job.work.output.keypoints;
+        record.timings.decodeMs = stages.decodeMs;
+        record.timings.preprocessMs = stages.preprocessMs;
+        record.timings.featuresMs = stages.featuresMs;
+        record.timings.matchMs = stages.matchMs;
+        record.timings.localizeMs = stages.localizeMs;
+        summary << "  " << job.image.name << ":";
+        if (job.failed)
+        {
+            summary << " " << record.error << "\n";
+            return;
+        }
+
+        size_t detections = 0;
+        for (const auto &result : job.work.output.objects)
+        {
+            record.objects.push_back(makeObjectRecord(result));
+
+            if (!result.detected)
+                continue;
+            const cv::Rect &box = result.box;
+            summary << (detections++ ? "; " : " ") << result.objectKey << " " << box.x << "," << box.y << " - "
+                    << box.x + box.width << "," << box.y + box.height << " (" << strategyName(result.strategy) << ")";
+        }
+        if (detections == 0)
+            summary << " not detected";
+        summary << "\n";
+    }
+
+    // Step 6: report and queue the result image (encodeMs includes waiting for the render queue)
+    void encodeStep(ImageJob &job, const JobContext &ctx)
+    {
+        if (!job.failed)
+        {
+            TRACE_SCOPE("encode");
+            StepTimer timer(job.report.record.timings.encodeMs);
+            if (ctx.sceneMode)
+                encodeSceneResult(job, ctx);
+            else
+                encodeObjectResult(job, ctx);
+        }
+        recordResults(job);
+    }
+
+    // A step threw (e.g. OpenCV on a corrupt image): the image is reported as failed
+    // and the later steps skip it
+    void failStep(ImageJob &job, const std::string &step, const std::string &error)
+    {
+        job.report.errors << "  Error in " << step << " step for " << job.image.name << ": " << error << "\n";
+        job.report.log << "  Error in " << step << " step for " << job.image.name << ": " << error << "\n";
+        job.report.record.error = step + ": " + error;
+        job.failed = true;
+    }
+
+    // Batch executor: every image runs all steps on one pool thread
+    void runBatch(std::vector<ImageJob> &jobs, const JobContext &ctx, ThreadPool &pool, OrderedEmitter &emitter)
+    {
+        pool.parallelFor(0, jobs.size(), [&](size_t i)
+                         {
+                             ImageJob &job = jobs[i];
+                             TRACE_IMAGE(job.traceImage);
+                             try
+                             {
+                                 decodeStep(job, ctx);
+                                 preprocessStep(job, ctx);
+                                 featuresStep(job, ctx);
+                                 matchStep(job, ctx);
+                                 localizeStep(job, ctx);
+                             }
+                             catch (const std::exception &e)
+                             {
+                                 failStep(job, "detect", e.what());
+                             }
+                             try
+                             {
+                                 encodeStep(job, ctx);
+                             }
+                             catch (const std::exception &e)
+                             {
+                                 failStep(job, "encode", e.what());
+                             }
+                             emitter.complete(job.index, std::move(job.report));
+                         });
+    }
+
+    // Pipelined executor: each step is a stage with its own workers and bounded input queue
+    void runPipelined(std::vector<ImageJob> &jobs, const JobContext &ctx, const RunOptions &options,
+                      size_t threads, OrderedEmitter &emitter, std::ofstream &logFile)
+    {
+        std::vector<size_t> workers = options.stageWorkers;
+        if (workers.empty())
+        {
+            // I/O stages get a few threads, feature extraction gets the most
+            workers = {std::max<size_t>(1, threads / 8), std::max<size_t>(1, threads / 4),
+                       std::max<size_t>(1, threads / 2), std::max<size_t>(1, threads / 4),
+                       1, std::max<size_t>(1, threads / 8)};
+        }
+
+        StagePipeline<ImageJob> pipeline;
+        pipeline.setErrorHandler([&](ImageJob &job, const std::string &stage, const std::string &error)
+                                 {
+                                     failStep(job, stage, error);
+                                     // The encode stage emits the report; a failure there must still emit it
+                                     if (stage == "encode")
+                                         emitter.complete(job.index, std::move(job.report));
+                                 });
+        pipeline.addStage("decode", workers[0], options.queueDepth, [&](ImageJob &job)
+                          {
+                              TRACE_IMAGE(job.traceImage);
+                              decodeStep(job, ctx);
+                          });
+        pipeline.addStage("preprocess", workers[1], options.queueDepth, [&](ImageJob &job)
+                          {
+                              TRACE_IMAGE(job.traceImage);
+                              preprocessStep(job, ctx);
+                          });
+        pipeline.addStage("features", workers[2], options.queueDepth, [&](ImageJob &job)
+                          {
+                              TRACE_IMAGE(job.traceImage);
+                              featuresStep(job, ctx);
+                          });
+        pipeline.addStage("match", workers[3], options.queueDepth, [&](ImageJob &job)
+                          {
+                              TRACE_IMAGE(job.traceImage);
+                              matchStep(job, ctx);
+                          });
+        pipeline.addStage("localize", workers[4], options.queueDepth, [&](ImageJob &job)
+                          {
+                              TRACE_IMAGE(job.traceImage);
+                              localizeStep(job, ctx);
+                          });
+        pipeline.addStage("encode", workers[5], options.queueDepth, [&](ImageJob &job)
+                          {
+                              TRACE_IMAGE(job.traceImage);
+                              encodeStep(job, ctx);
+                              emitter.complete(job.index, std::move(job.report));
+                          });
+
+        size_t next = 0;
+        pipeline.run([&]() -> std::unique_ptr<ImageJob>
+                     {
+                         if (next >= jobs.size())
+                             return nullptr;
+                         return std::make_unique<ImageJob>(std::move(jobs[next++]));
+                     });
+
+        // Per-stage report: a deep input queue or many producer waits marks the bottleneck
+        std::ostringstream table;
+        table << "  Stage        workers  queue  processed  failed  busy[s]  mean-depth  max-depth  full-waits  empty-waits\n";
+        for (const auto &st : pipeline.stats())
+        {
+            table << "  " << std::left << std::setw(12) << st.name << std::right
+                  << std::setw(8) << st.workers
+                  << std::setw(7) << st.queueCapacity
+                  << std::setw(11) << st.processed
+                  << std::setw(8) << st.failures
+                  << std::setw(9) << std::fixed << std::setprecision(2) << st.busySeconds
+                  << std::setw(12) << st.meanOccupancy
+                  << std::setw(11) << st.maxOccupancy
+                  << std::setw(12) << st.producerWaits
+                  << std::setw(13) << st.consumerWaits << "\n";
+        }
+        std::cout << table.str();
+        logFile << table.str();
+    }
+
+    // Run the jobs on the selected executor
+    void runJobs(std::vector<ImageJob> &jobs, const JobContext &ctx, const RunOptions &options,
+                 ThreadPool &pool, std::ofstream &logFile, ResultsWriter &writer)
+    {
+        OrderedEmitter emitter(jobs.size(), logFile, writer, options.verbosity);
+        if (options.pipelined)
+        {
+            JobContext stageCtx = ctx;
+            stageCtx.pool = nullptr; // stages provide the parallelism
+            runPipelined(jobs, stageCtx, options, pool.size(), emitter, logFile);
+        }
+        else
+        {
+            runBatch(jobs, ctx, pool, emitter);
+        }
+    }
+}
+
+void runObjectMode(const IDataLoader &loader,
+                   const fs::path &rootPath,
+                   const fs::path &resultsPath,
+                   const Detector &detector,
+                   const RunOptions &options,
+                   std::ofstream &logFile,
+                   ResultsWriter &writer,
+                   ResultRenderer &renderer)
+{
+    ThreadPool &pool = detector.pool();
+    DetectorStages stages(detector);
+    for (const auto &object : detector.objects())
+    {
+        const std::string &key = object.key;
+        std::cout << "Processing object: " << key
+                  << " (denoise: " << denoiseModeName(object.params.denoise) << ")\n";
+        logFile << "Processing object: " << key
+                << " (denoise: " << denoiseModeName(object.params.denoise) << ")\n";
+
+        fs::path outDir = resultsPath / key;
+        if (!fs::exists(outDir))
+        {
+            fs::create_directories(outDir);
+        }
+
+        if (options.verbosity == Verbosity::Detail)
+        {
+            for (const auto &vf : object.views)
+            {
+                std::cout << "  Model view '" << vf.name << "' keypoints: " << vf.keypoints.size()
+                          << (object.fromCache ? " (cached)" : "") << "\n";
+                logFile << "  Model view '" << vf.name << "' keypoints: " << vf.keypoints.size()
+                        << (object.fromCache ? " (cached)" : "") << "\n";
+            }
+        }
+
+        // Process test images; reports are written in input order
+        std::vector<ImageJob> jobs;
+        for (const auto &ti : loader.listTestImages(rootPath, key))
+        {
+            ImageJob job;
+            job.index = jobs.size();
+            job.image = ti;
+            job.work = stages.makeJob({&object}, false);
+            TRACE_REGISTER_IMAGE(job.traceImage, key + "/" + ti.name);
+            jobs.push_back(std::move(job));
+        }
+
+        JobContext ctx{stages, renderer, outDir, false, &pool};
+        std::vector<TestImage> order;
+        for (const auto &job : jobs)
+            order.push_back(job.image);
+        loader.prefetch(order, detector.decodeScale());
+        runJobs(jobs, ctx, options, pool, logFile, writer);
+    }
+}
+
+void runSceneMode(const IDataLoader &loader,
+                  const fs::path &rootPath,
+                  const fs::path &resultsPath,
+                  const Detector &detector,
+                  const RunOptions &options,
+                  std::ofstream &logFile,
+                  ResultsWriter &writer,
+                  ResultRenderer &renderer)
+{
+    const std::vector<ObjectModel> &objects = detector.objects();
+    ThreadPool &pool = detector.pool();
+    DetectorStages stages(detector);
+    fs::path outDir = resultsPath / "scene";
+    if (!fs::exists(outDir))
+    {
+        fs::create_directories(outDir);
+    }
+
+    std::vector<const ObjectModel *> targets;
+    for (const auto &object : objects)
+        targets.push_back(&object);
+
+    // Collect every test image once, whichever object directory it is in
+    std::vector<ImageJob> jobs;
+    std::set<std::string> seen;
+    for (const auto &object : objects)
+    {
+        for (const auto &ti : loader.listTestImages(rootPath, object.key))
+        {
+            if (!seen.insert(ti.name).second)
+                continue;
+            ImageJob job;
+            job.index = jobs.size();
+            job.image = ti;
+            job.work = stages.makeJob(targets, true);
+            TRACE_REGISTER_IMAGE(job.traceImage, ti.name);
+            jobs.push_back(std::move(job));
+        }
+    }
+
+    // Scene images are preprocessed once for all objects, with the default mode
+    std::cout << "Scene mode (denoise: " << denoiseModeName(options.denoise) << ")\n";
+    logFile << "Scene mode (denoise: " << denoiseModeName(options.denoise) << ")\n";
+
+    std::vector<TestImage> order;
+    for (const auto &job : jobs)
+        order.push_back(job.image);
+    loader.prefetch(order, detector.decodeScale());
+
+    JobContext ctx{stages, renderer, outDir, true, &pool};
+    runJobs(jobs, ctx, options, pool, logFile, writer);
+}
+
@@ -0,0 +1,34 @@
+#ifndef CLI_DATASET_RUNNER_HPP
+#define CLI_DATASET_RUNNER_HPP
+
+#include <filesystem>
+#include <fstream>
+#include "dataloader.hpp"
+#include "detector.hpp"
+#include "result_renderer.hpp"
+#include "results_writer.hpp"
+#include "run_options.hpp"
+
+// Per-object mode: search each test image only for the object whose directory it is in.
+// Result images go to a directory per object under resultsPath.
+void runObjectMode(const IDataLoader &loader,
+                   const std::filesystem::path &rootPath,
+                   const std::filesystem::path &resultsPath,
+                   const Detector &detector,
+                   const RunOptions &options,
+                   std::ofstream &logFile,
+                   ResultsWriter &writer,
+                   ResultRenderer &renderer);
+
+// Scene mode: extract features from each test image once and search it for every object.
+// Result images go to resultsPath/scene.
+void runSceneMode(const IDataLoader &loader,
+                  const std::filesystem::path &rootPath,
+                  const std::filesystem::path &resultsPath,
+                  const Detector &detector,
+                  const RunOptions &options,
+                  std::ofstream &logFile,
+                  ResultsWriter &writer,
+                  ResultRenderer &renderer);
+
+#endif // CLI_DATASET_RUNNER_HPP
@@ -0,0 +1,393 @@
+#include "run_options.hpp"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include "descriptor_format.hpp"
+
+namespace
+{
+    // Whole option values; anything else (trailing characters, a sign on a count, out of
+    // range) throws std::invalid_argument or std::out_of_range
+    size_t parseCount(const std::string &value)
+    {
+        size_t pos = 0;
+        if (value.empty() || value[0] == '-' || value[0] == '+')
+            throw std::invalid_argument(value);
+        unsigned long long n = std::stoull(value, &pos);
+        if (pos != value.size() || n > std::numeric_limits<size_t>::max())
+            throw std::out_of_range(value);
+        return static_cast<size_t>(n);
+    }
+
+    int parseInt(const std::string &value)
+    {
+        size_t pos = 0;
+        int n = std::stoi(value, &pos);
+        if (pos != value.size())
+            throw std::invalid_argument(value);
+        return n;
+    }
+
+    double parseReal(const std::string &value)
+    {
+        size_t pos = 0;
+        double x = std::stod(value, &pos);
+        if (pos != value.size() || !std::isfinite(x))
+            throw std::invalid_argument(value);
+        return x;
+    }
+}
+
+void printUsage()
+{
+    std::cerr << "Usage: object-detect [--scene] [--threads N] [--pipeline]"
+              << " [--stage-workers d,p,f,m,l,e] [--queue-depth N]"
+              << " [--matcher flann|opencv|simd] [--verify-matcher]"
+              << " [--descriptors float|uint8|rootsift] [--quant-parity]"
+              << " [--denoise [KEY=]bilateral|bilateral-half|guided|recursive|none] [--denoise-bench]"
+              << " [--trace FILE] [--results jsonl|csv] [--verbosity quiet|summary|detail]"
+              << " [--evaluate] [--eval-grid SPEC] [--accuracy-bar F1] [--iou-threshold T]"
+              << " [--shortlist K] [--shortlist-dominance X]"
+              << " [--vocab] [--vocab-candidates N] [--vocab-train] [--ransac-method ransac|prosac]"
+              << " [--coarse-to-fine] [--coarse-scale S] [--roi-margin M]"
+              << " [--sequence PATH] [--keyframe-interval N] [--min-track-points N]"
+              << " [--data DIR] [--cache DIR] [--results-dir DIR] [--serve [SOCKET]] [--socket-mode MODE] [--max-batch N] [--batch-window MS]"
+              << " [--render off|json|annotated] [--render-format EXT] [--render-quality Q]"
+              << " [--render-threads N] [--prefetch N] [--io-threads N] [--frame-cache MB]"
+              << " [--pack FILE] [--write-pack FILE] [--pack-encoding planes|encoded]" << std::endl;
+}
+
+bool parseOptions(int argc, char **argv, RunOptions &options)
+{
+    // Malformed numbers throw from the parse helpers and are reported as a usage error
+    std::string arg;
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            arg = argv[i];
+            if (arg == "--scene")
+            {
+                options.sceneMode = true;
+            }
+            else if (arg == "--threads" && i + 1 < argc)
+            {
+                options.threads = parseCount(argv[++i]);
+            }
+            else if (arg == "--pipeline")
+            {
+                options.pipelined = true;
+            }
+            else if (arg == "--stage-workers" && i + 1 < argc)
+            {
+                std::stringstream list(argv[++i]);
+                std::string item;
+                while (std::getline(list, item, ','))
+                    options.stageWorkers.push_back(parseCount(item));
+                if (options.stageWorkers.size() != 6)
+                {
+                    std::cerr << "--stage-workers expects 6 comma-separated counts" << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--queue-depth" && i + 1 < argc)
+            {
+                options.queueDepth = parseCount(argv[++i]);
+                if (options.queueDepth == 0)
+                {
+                    std::cerr << "--queue-depth expects at least 1" << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--matcher" && i + 1 < argc)
+            {
+                std::string name = argv[++i];
+                if (name == "flann")
+                    options.gallery.search = GallerySearch::Flann;
+                else if (name == "opencv")
+                    options.gallery.search = GallerySearch::OpenCV;
+                else if (name == "simd")
+                    options.gallery.search = GallerySearch::Simd;
+                else
+                {
+                    std::cerr << "Unknown matcher: " << name << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--verify-matcher")
+            {
+                options.verifyMatcher = true;
+            }
+            else if (arg == "--descriptors" && i + 1 < argc)
+            {
+                std::string name = argv[++i];
+                if (!parseDescriptorFormat(name, options.gallery.format))
+                {
+                    std::cerr << "Unknown descriptor format: " << name << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--quant-parity")
+            {
+                options.quantParity = true;
+            }
+            else if (arg == "--denoise" && i + 1 < argc)
+            {
+                // MODE sets the default, KEY=MODE overrides one object
+                std::string value = argv[++i];
+                size_t eq = value.find('=');
+                std::string name = eq == std::string::npos ? value : value.substr(eq + 1);
+                DenoiseMode mode;
+                if (!parseDenoiseMode(name, mode))
+                {
+                    std::cerr << "Unknown denoise mode: " << name << std::endl;
+                    return false;
+                }
+                if (eq == std::string::npos)
+                    options.denoise = mode;
+                else
+                    options.objectDenoise[value.substr(0, eq)] = mode;
+            }
+            else if (arg == "--denoise-bench")
+            {
+                options.denoiseBench = true;
+            }
+            else if (arg == "--results" && i + 1 < argc)
+            {
+                std::string name = argv[++i];
+                if (!parseResultsFormat(name, options.resultsFormat))
+                {
+                    std::cerr << "Unknown results format: " << name << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--verbosity" && i + 1 < argc)
+            {
+                std::string name = argv[++i];
+                if (!parseVerbosity(name, options.verbosity))
+                {
+                    std::cerr << "Unknown verbosity: " << name << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--shortlist" && i + 1 < argc)
+            {
+                options.gallery.shortlistK = parseInt(argv[++i]);
+            }
+            else if (arg == "--shortlist-dominance" && i + 1 < argc)
+            {
+                options.gallery.shortlistDominance = parseReal(argv[++i]);
+            }
+            else if (arg == "--ransac-method" && i + 1 < argc)
+            {
+                std::string name = argv[++i];
+                if (!parseRansacMethod(name, options.ransacMethod))
+                {
+                    std::cerr << "Unknown RANSAC method: " << name << std::endl;
+                    return false;
+                }
+                // Report the estimator that will actually run
+                if (options.ransacMethod == RansacMethod::Prosac && !prosacAvailable())
+                {
+                    std::cerr << "PROSAC needs OpenCV 4.5 or newer; using RANSAC" << std::endl;
+                    options.ransacMethod = RansacMethod::Ransac;
+                }
+            }
+            else if (arg == "--coarse-to-fine")
+            {
+                options.coarseToFine.enabled = true;
+            }
+            else if (arg == "--coarse-scale" && i + 1 < argc)
+            {
+                options.coarseToFine.enabled = true;
+                options.coarseToFine.scale = parseReal(argv[++i]);
+                if (options.coarseToFine.scale <= 0.0 || options.coarseToFine.scale > 1.0)
+                {
+                    std::cerr << "--coarse-scale expects a value in (0, 1]" << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--roi-margin" && i + 1 < argc)
+            {
+                options.coarseToFine.roiMargin = parseReal(argv[++i]);
+                if (options.coarseToFine.roiMargin < 0.0)
+                {
+                    std::cerr << "--roi-margin expects a value >= 0" << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--sequence" && i + 1 < argc)
+            {
+                options.sequencePath = argv[++i];
+            }
+            else if (arg == "--keyframe-interval" && i + 1 < argc)
+            {
+                options.tracking.keyframeInterval = std::max(1, parseInt(argv[++i]));
+            }
+            else if (arg == "--min-track-points" && i + 1 < argc)
+            {
+                options.tracking.minTrackedPoints = std::max(1, parseInt(argv[++i]));
+            }
+            else if (arg == "--data" && i + 1 < argc)
+            {
+                options.dataPath = argv[++i];
+            }
+            else if (arg == "--cache" && i + 1 < argc)
+            {
+                options.cachePath = argv[++i];
+            }
+            else if (arg == "--results-dir" && i + 1 < argc)
+            {
+                options.resultsPath = argv[++i];
+            }
+            else if (arg == "--serve")
+            {
+                options.serve = true;
+                if (i + 1 < argc && argv[i + 1][0] != '-')
+                    options.server.socketPath = argv[++i];
+            }
+            else if (arg == "--socket-mode" && i + 1 < argc)
+            {
+                std::string value = argv[++i];
+                size_t pos = 0;
+                unsigned long mode = std::stoul(value, &pos, 8);
+                if (pos != value.size() || mode > 0777)
+                    throw std::invalid_argument(value);
+                options.server.socketMode = static_cast<mode_t>(mode);
+            }
+            else if (arg == "--max-batch" && i + 1 < argc)
+            {
+                options.server.maxBatch = std::max<size_t>(1, parseCount(argv[++i]));
+            }
+            else if (arg == "--batch-window" && i + 1 < argc)
+            {
+                options.server.batchWindowMs = parseReal(argv[++i]);
+            }
+            else if (arg == "--render" && i + 1 < argc)
+            {
+                std::string name = argv[++i];
+                if (!parseRenderMode(name, options.render.mode))
+                {
+                    std::cerr << "Unknown render mode: " << name << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--render-format" && i + 1 < argc)
+            {
+                options.render.format = argv[++i];
+                if (!options.render.format.empty() && options.render.format[0] == '.')
+                    options.render.format.erase(0, 1);
+                // Fail now rather than on every result image
+                if (options.render.format.empty() || !cv::haveImageWriter("result." + options.render.format))
+                {
+                    std::cerr << "Unsupported render format: " << options.render.format << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--render-quality" && i + 1 < argc)
+            {
+                options.render.quality = std::min(100, std::max(0, parseInt(argv[++i])));
+            }
+            else if (arg == "--render-threads" && i + 1 < argc)
+            {
+                options.render.threads = std::max<size_t>(1, parseCount(argv[++i]));
+            }
+            else if (arg == "--prefetch" && i + 1 < argc)
+            {
+                options.prefetch.lookahead = parseCount(argv[++i]);
+            }
+            else if (arg == "--io-threads" && i + 1 < argc)
+            {
+                options.prefetch.threads = std::max<size_t>(1, parseCount(argv[++i]));
+            }
+            else if (arg == "--frame-cache" && i + 1 < argc)
+            {
+                options.prefetch.cacheBytes = static_cast<size_t>(parseCount(argv[++i])) << 20;
+            }
+            else if (arg == "--pack" && i + 1 < argc)
+            {
+                options.packPath = argv[++i];
+            }
+            else if (arg == "--write-pack" && i + 1 < argc)
+            {
+                options.writePackPath = argv[++i];
+            }
+            else if (arg == "--pack-encoding" && i + 1 < argc)
+            {
+                std::string name = argv[++i];
+                if (!parsePackEncoding(name, options.packEncoding))
+                {
+                    std::cerr << "Unknown pack encoding: " << name << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--vocab")
+            {
+                options.vocab = true;
+            }
+            else if (arg == "--vocab-candidates" && i + 1 < argc)
+            {
+                options.vocab = true;
+                options.vocabCandidates = parseCount(argv[++i]);
+            }
+            else if (arg == "--vocab-train")
+            {
+                options.vocab = true;
+                options.vocabTrain = true;
+            }
+            else if (arg == "--evaluate")
+            {
+                options.evaluate = true;
+            }
+            else if (arg == "--eval-grid" && i + 1 < argc)
+            {
+                options.evaluate = true;
+                options.evalGrid = argv[++i];
+            }
+            else if (arg == "--accuracy-bar" && i + 1 < argc)
+            {
+                options.accuracyBar = parseReal(argv[++i]);
+            }
+            else if (arg == "--iou-threshold" && i + 1 < argc)
+            {
+                options.iouThreshold = parseReal(argv[++i]);
+            }
+            else if (arg == "--trace" && i + 1 < argc)
+            {
+                options.tracePath = argv[++i];
+    #ifndef OBJECT_DETECT_TRACE
+                std::cerr << "Tracing is not compiled in; configure with -DOBJECT_DETECT_TRACING=ON" << std::endl;
+    #endif
+            }
+            else
+            {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                printUsage();
+                return false;
+            }
+        }
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << "Invalid value for " << arg << std::endl;
+        printUsage();
+        return false;
+    }
+    return true;
+}
+
+DetectionParams objectParams(const std::string &key, const RunOptions &options)
+{
+    DetectionParams params = getObjectParams(key);
+    params.denoise = options.denoise;
+    params.ransacMethod = options.ransacMethod;
+    auto it = options.objectDenoise.find(key);
+    if (it != options.objectDenoise.end())
+        params.denoise = it->second;
+    return params;
+}
+
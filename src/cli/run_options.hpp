@@ -0,0 +1,66 @@
+#ifndef CLI_RUN_OPTIONS_HPP
+#define CLI_RUN_OPTIONS_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include "dataset_pack.hpp"
+#include "detection_server.hpp"
+#include "gallery_index.hpp"
+#include "matching.hpp"
+#include "pipeline.hpp"
+#include "prefetching_loader.hpp"
+#include "preprocessing.hpp"
+#include "result_renderer.hpp"
+#include "results_writer.hpp"
+#include "video_tracker.hpp"
+
+// Command line options
+struct RunOptions
+{
+    bool sceneMode = false;          // search every test image for all objects
+    size_t threads = 0;              // worker threads (0 = all hardware threads)
+    bool pipelined = false;          // run the stages on the pipelined executor
+    std::vector<size_t> stageWorkers; // workers per pipeline stage (empty = derived from threads)
+    size_t queueDepth = 8;           // capacity of each stage input queue
+    GalleryParams gallery;           // gallery search settings
+    bool verifyMatcher = false;      // compare the SIMD matcher with OpenCV and exit
+    bool quantParity = false;        // compare quantized descriptor formats with float and exit
+    DenoiseMode denoise = DenoiseMode::Bilateral;       // default preprocessing mode
+    std::map<std::string, DenoiseMode> objectDenoise; // per-object overrides
+    bool denoiseBench = false;       // compare the denoise modes on the dataset and exit
+    std::string tracePath;           // Chrome trace output (tracing builds only)
+    ResultsFormat resultsFormat = ResultsFormat::Jsonl; // per-image results file format
+    Verbosity verbosity = Verbosity::Quiet;             // console and text log output
+    bool evaluate = false;           // score detections against the labels and exit
+    std::string evalGrid;            // parameter grid to sweep (empty = current parameters)
+    double accuracyBar = 0.0;        // minimum F1 of the recommended configuration
+    double iouThreshold = 0.5;       // IoU needed for a correct detection
+    RansacMethod ransacMethod = RansacMethod::Ransac; // estimator of the view homographies
+    CoarseToFineParams coarseToFine; // detect on a downscaled image, refine around the box
+    std::string sequencePath;        // video file or image directory to process as a sequence
+    TrackingParams tracking;         // keyframe and tracking settings of sequence mode
+    std::string dataPath = "../data/object_detection_dataset/"; // dataset root
+    std::string cachePath = "../data/cache/";                  // feature cache directory
+    std::string resultsPath = "../data/results/";              // results files, text log and result images
+    bool serve = false;              // run the detection daemon
+    ServerOptions server;            // daemon socket and batching settings
+    bool vocab = false;              // preselect views with the vocabulary tree
+    bool vocabTrain = false;         // retrain the vocabulary tree even if a matching one exists
+    size_t vocabCandidates = 10;     // views returned by the vocabulary tree per image
+    RenderOptions render;            // result images or JSON files, written in the background
+    PrefetchParams prefetch{4, 0};   // test image prefetching (lookahead 0 = off)
+    std::string packPath;            // read the dataset from this pack instead of its files
+    std::string writePackPath;       // pack the dataset into this file and exit
+    PackEncoding packEncoding = PackEncoding::Planes; // image storage of --write-pack
+};
+
+void printUsage();
+
+// Parse the command line into options; prints the problem and returns false on a bad option
+bool parseOptions(int argc, char **argv, RunOptions &options);
+
+// Detection parameters of an object with the command line overrides applied
+DetectionParams objectParams(const std::string &key, const RunOptions &options);
+
+#endif // CLI_RUN_OPTIONS_HPP
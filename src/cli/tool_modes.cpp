@@ -0,0 +1,454 @@
+#include "tool_modes.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include "dataset_pack.hpp"
+#include "descriptor_format.hpp"
+#include "evaluation.hpp"
+#include "matching.hpp"
+#include "object_localizer.hpp"
+#include "percentile.hpp"
+#include "preprocessing.hpp"
+#include "result_records.hpp"
+#include "simd_matcher.hpp"
+#include "text_escape.hpp"
+#include "video_tracker.hpp"
+
+namespace fs = std::filesystem;
+
+int runSequenceMode(const std::vector<ObjectModel> &objects,
+                    const FeatureExtractor &extractor,
+                    const RunOptions &options,
+                    ThreadPool &pool,
+                    std::ofstream &logFile,
+                    ResultsWriter &writer)
+{
+    using Clock = std::chrono::steady_clock;
+    FrameSource source;
+    if (!source.open(options.sequencePath))
+    {
+        std::cerr << "Failed to open sequence: " << options.sequencePath << std::endl;
+        return 1;
+    }
+
+    std::vector<const ObjectModel *> targets;
+    for (const auto &object : objects)
+        targets.push_back(&object);
+    SequenceTracker tracker(targets, extractor, options.tracking, options.denoise, &pool);
+
+    std::cout << "Sequence: " << options.sequencePath << " (keyframe interval " << options.tracking.keyframeInterval
+              << ", denoise: " << denoiseModeName(options.denoise) << ")" << std::endl;
+    logFile << "Sequence: " << options.sequencePath << "\n";
+
+    std::vector<double> keyframeMs, trackedMs;
+    size_t lost = 0;
+    cv::Mat gray;
+    auto start = Clock::now();
+    for (;;)
+    {
+        auto frameStart = Clock::now();
+        if (!source.read(gray))
+            break;
+        double decodeMs = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+
+        FrameResult result = tracker.process(gray);
+        double frameMs = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+        (result.keyframe == KeyframeReason::None ? trackedMs : keyframeMs).push_back(frameMs);
+        if (result.keyframe == KeyframeReason::Lost)
+            ++lost;
+
+        ImageRecord record;
+        record.image = source.frameName();
+        record.timings.decodeMs = decodeMs;
+        record.timings.preprocessMs = result.preprocessMs;
+        record.timings.featuresMs = result.featuresMs;
+        record.timings.matchMs = result.matchMs;
+        record.timings.localizeMs = result.localizeMs;
+        for (const auto &r : result.objects)
+            record.objects.push_back(makeObjectRecord(r));
+        if (options.verbosity != Verbosity::Quiet)
+        {
+            std::ostringstream line;
+            line << "  " << record.image;
+            if (result.keyframe != KeyframeReason::None)
+                line << " [keyframe: " << keyframeReasonName(result.keyframe) << "]";
+            line << ":";
+            size_t detections = 0;
+            for (const auto &r : result.objects)
+            {
+                if (!r.detected)
+                    continue;
+                line << (detections++ ? "; " : " ") << r.objectKey << " " << r.box.x << "," << r.box.y << " - "
+                     << r.box.x + r.box.width << "," << r.box.y + r.box.height;
+            }
+            if (detections == 0)
+                line << " not detected";
+            std::cout << line.str() << "\n";
+            logFile << line.str() << "\n";
+        }
+        writer.submit(std::move(record));
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Frame rate and per-frame latency of keyframes and tracked frames
+    size_t frames = keyframeMs.size() + trackedMs.size();
+    std::vector<double> all = keyframeMs;
+    all.insert(all.end(), trackedMs.begin(), trackedMs.end());
+    std::sort(all.begin(), all.end());
+    std::sort(keyframeMs.begin(), keyframeMs.end());
+    std::sort(trackedMs.begin(), trackedMs.end());
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(2)
+           << "Frames: " << frames << " (" << keyframeMs.size() << " keyframes, " << lost << " after track loss), "
+           << (seconds > 0.0 ? frames / seconds : 0.0) << " fps\n"
+           << "  latency [ms]   p50      p99\n"
+           << "  all        " << std::setw(8) << percentile(all, 0.5) << " " << std::setw(8) << percentile(all, 0.99) << "\n"
+           << "  keyframe   " << std::setw(8) << percentile(keyframeMs, 0.5) << " " << std::setw(8) << percentile(keyframeMs, 0.99) << "\n"
+           << "  tracked    " << std::setw(8) << percentile(trackedMs, 0.5) << " " << std::setw(8) << percentile(trackedMs, 0.99) << "\n";
+    std::cout << report.str();
+    logFile << report.str();
+    return 0;
+}
+
+int runMatcherCheck(const IDataLoader &loader,
+                    const fs::path &rootPath,
+                    const std::vector<ObjectModel> &objects,
+                    const FeatureExtractor &extractor,
+                    ThreadPool &pool)
+{
+    std::cout << "Matcher check (" << SimdMatcher::isaName(SimdMatcher::detectIsa())
+              << " kernel vs cv::BFMatcher)" << std::endl;
+
+    bool allAgree = true;
+    for (const auto &object : objects)
+    {
+        auto testImages = loader.listTestImages(rootPath, object.key);
+        std::vector<MatcherComparison> results(testImages.size() * object.views.size());
+        pool.parallelFor(0, testImages.size(), [&](size_t i)
+                         {
+                             cv::Mat gray = loader.loadTestImage(testImages[i]);
+                             if (gray.empty())
+                                 return;
+                             ImageFeatures features = extractTestFeatures(extractor, gray, object.params.denoise);
+                             cv::Mat testDesc = DescriptorQuantizer::convert(
+                                 features.descriptors, object.gallery.params().format);
+                             for (size_t v = 0; v < object.views.size(); ++v)
+                                 results[i * object.views.size() + v] = Matching::compareBackends(
+                                     object.views[v].descriptors, testDesc);
+                         });
+
+        MatcherComparison total;
+        for (const auto &r : results)
+        {
+            total.opencvMatches += r.opencvMatches;
+            total.simdMatches += r.simdMatches;
+            total.agreeing += r.agreeing;
+            total.maxDistanceDiff = std::max(total.maxDistanceDiff, r.maxDistanceDiff);
+        }
+
+        double agreement = total.opencvMatches ? 100.0 * total.agreeing / total.opencvMatches : 100.0;
+        std::cout << "  " << object.key << ": opencv " << total.opencvMatches
+                  << ", simd " << total.simdMatches
+                  << ", agreeing " << total.agreeing << " (" << agreement << "%)"
+                  << ", max distance diff " << total.maxDistanceDiff << std::endl;
+
+        // Ties and float summation order may flip a handful of borderline matches
+        if (agreement < 99.0)
+            allAgree = false;
+    }
+    return allAgree ? 0 : 1;
+}
+
+int runQuantParity(const IDataLoader &loader,
+                   const fs::path &rootPath,
+                   const FeatureExtractor &extractor,
+                   const FeatureCache &cache,
+                   const RunOptions &options,
+                   ThreadPool &pool)
+{
+    const DescriptorFormat formats[] = {DescriptorFormat::Float32, DescriptorFormat::Uint8, DescriptorFormat::RootSift8};
+
+    // Test images and their grayscale features are shared by all formats
+    struct Sample
+    {
+        size_t object;
+        ImageFeatures features;
+        cv::Size size;
+    };
+    std::vector<std::string> keys = loader.listObjectKeys(rootPath);
+    std::vector<TestImage> images;
+    std::vector<size_t> imageObject;
+    for (size_t o = 0; o < keys.size(); ++o)
+    {
+        for (const auto &ti : loader.listTestImages(rootPath, keys[o]))
+        {
+            images.push_back(ti);
+            imageObject.push_back(o);
+        }
+    }
+    std::vector<Sample> samples(images.size());
+    pool.parallelFor(0, images.size(), [&](size_t i)
+                     {
+                         cv::Mat gray = loader.loadTestImage(images[i]);
+                         samples[i].object = imageObject[i];
+                         samples[i].size = gray.size();
+                         if (!gray.empty())
+                             samples[i].features = extractTestFeatures(
+                                 extractor, gray, objectParams(keys[imageObject[i]], options).denoise);
+                     });
+
+    std::vector<DetectionResult> baseline;
+    std::cout << "Descriptor format parity (" << images.size() << " test images)" << std::endl;
+    std::cout << "  format    bytes/desc  gallery[KB]  detected  same-detection  mean-IoU  matches-ratio  time[ms]" << std::endl;
+
+    for (DescriptorFormat format : formats)
+    {
+        GalleryParams galleryParams = options.gallery;
+        galleryParams.format = format;
+
+        std::vector<ObjectModel> objects;
+        size_t galleryBytes = 0;
+        for (const auto &key : keys)
+        {
+            objects.push_back(loadObjectModel(loader, rootPath, key, objectParams(key, options),
+                                              extractor, cache, galleryParams));
+            galleryBytes += objects.back().gallery.memoryBytes();
+        }
+
+        std::vector<DetectionResult> results(samples.size());
+        auto start = std::chrono::steady_clock::now();
+        pool.parallelFor(0, samples.size(), [&](size_t i)
+                         { results[i] = detectObject(objects[samples[i].object], samples[i].features, samples[i].size); });
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (format == DescriptorFormat::Float32)
+            baseline = results;
+
+        // Agreement with the float baseline
+        size_t detected = 0, same = 0, both = 0;
+        double iouSum = 0.0, baseMatches = 0.0, matches = 0.0;
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            detected += results[i].detected;
+            same += results[i].detected == baseline[i].detected;
+            baseMatches += baseline[i].matches;
+            matches += results[i].matches;
+            if (results[i].detected && baseline[i].detected)
+            {
+                iouSum += boxIoU(results[i].box, baseline[i].box);
+                ++both;
+            }
+        }
+
+        std::cout << "  " << std::left << std::setw(10) << descriptorFormatName(format) << std::right
+                  << std::setw(10) << DescriptorQuantizer::bytesPerDescriptor(format)
+                  << std::setw(13) << galleryBytes / 1024
+                  << std::setw(10) << detected
+                  << std::setw(16) << same
+                  << std::setw(10) << std::fixed << std::setprecision(3) << (both ? iouSum / both : 0.0)
+                  << std::setw(15) << (baseMatches > 0 ? matches / baseMatches : 0.0)
+                  << std::setw(10) << std::setprecision(1) << ms << std::endl;
+    }
+    return 0;
+}
+
+int runDenoiseBench(const IDataLoader &loader,
+                    const fs::path &rootPath,
+                    const FeatureExtractor &extractor,
+                    const fs::path &cachePath,
+                    const RunOptions &options,
+                    ThreadPool &pool)
+{
+    const DenoiseMode modes[] = {DenoiseMode::Bilateral, DenoiseMode::BilateralDownscaled,
+                                 DenoiseMode::Guided, DenoiseMode::Recursive, DenoiseMode::None};
+
+    // Grayscale test images are decoded once and shared by all modes
+    std::vector<std::string> keys = loader.listObjectKeys(rootPath);
+    std::vector<TestImage> images;
+    std::vector<size_t> imageObject;
+    for (size_t o = 0; o < keys.size(); ++o)
+    {
+        for (const auto &ti : loader.listTestImages(rootPath, keys[o]))
+        {
+            images.push_back(ti);
+            imageObject.push_back(o);
+        }
+    }
+    std::vector<cv::Mat> grays(images.size());
+    pool.parallelFor(0, images.size(), [&](size_t i)
+                     { grays[i] = loader.loadTestImage(images[i]); });
+
+    std::cout << "Denoise modes (" << images.size() << " test images, " << pool.size() << " threads)" << std::endl;
+    std::cout << "  mode            mean[ms]  p50[ms]  p90[ms]  detected  rate[%]  total[s]" << std::endl;
+
+    for (DenoiseMode mode : modes)
+    {
+        // A cache file holds one extractor key per object, so the models of each mode
+        // are cached in a directory of their own and stay valid across runs
+        FeatureCache cache(cachePath / denoiseModeName(mode));
+        std::vector<ObjectModel> objects;
+        for (const auto &key : keys)
+        {
+            // The run's parameters (e.g. --ransac-method) with the mode under test
+            DetectionParams params = objectParams(key, options);
+            params.denoise = mode;
+            objects.push_back(loadObjectModel(loader, rootPath, key, params, extractor, cache, options.gallery));
+        }
+
+        std::vector<double> latency(images.size(), 0.0);
+        std::vector<char> detected(images.size(), 0);
+        auto start = std::chrono::steady_clock::now();
+        pool.parallelFor(0, images.size(), [&](size_t i)
+                         {
+                             if (grays[i].empty())
+                                 return;
+                             auto t0 = std::chrono::steady_clock::now();
+                             cv::Mat processed = Preprocessing::reduceNoise(grays[i], mode);
+                             latency[i] = std::chrono::duration<double, std::milli>(
+                                              std::chrono::steady_clock::now() - t0).count();
+                             ImageFeatures features = extractor.extract(processed);
+                             detected[i] = detectObject(objects[imageObject[i]], features, grays[i].size()).detected;
+                         });
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<double> sorted = latency;
+        std::sort(sorted.begin(), sorted.end());
+        double mean = sorted.empty() ? 0.0 : std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+        size_t hits = std::count(detected.begin(), detected.end(), 1);
+
+        std::cout << "  " << std::left << std::setw(14) << denoiseModeName(mode) << std::right
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(10) << mean
+                  << std::setw(9) << percentile(sorted, 0.5)
+                  << std::setw(9) << percentile(sorted, 0.9)
+                  << std::setw(10) << hits
+                  << std::setw(9) << std::setprecision(1) << (images.empty() ? 0.0 : 100.0 * hits / images.size())
+                  << std::setw(10) << std::setprecision(2) << seconds << std::endl;
+    }
+    return 0;
+}
+
+int runEvaluation(const IDataLoader &loader,
+                  const fs::path &rootPath,
+                  const fs::path &resultsPath,
+                  const FeatureExtractor &extractor,
+                  const fs::path &cachePath,
+                  const RunOptions &options,
+                  ThreadPool &pool)
+{
+    ParamGrid grid;
+    std::string error;
+    if (!ParamGrid::parse(options.evalGrid, grid, error))
+    {
+        std::cerr << "Invalid --eval-grid: " << error << std::endl;
+        return 1;
+    }
+    std::vector<EvalConfig> configs = grid.configs();
+
+    // Opened before the run, so an unwritable results directory fails fast
+    const fs::path jsonPath = resultsPath / "evaluation.jsonl";
+    std::ofstream out(jsonPath);
+    if (!out.is_open())
+    {
+        std::cerr << "Failed to open evaluation file: " << jsonPath.string() << std::endl;
+        return 1;
+    }
+
+    Evaluator evaluator(loader, rootPath, extractor, cachePath, options.gallery, pool);
+    evaluator.setBaseParams([&](const std::string &key)
+                            { return objectParams(key, options); });
+    evaluator.setSceneMode(options.sceneMode);
+    evaluator.setIoUThreshold(options.iouThreshold);
+    evaluator.setCoarseToFine(options.coarseToFine);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<ConfigScore> scores = evaluator.run(configs);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto printRow = [](std::ostream &out, const std::string &name, const ObjectScore &s, double latency)
+    {
+        out << "  " << std::left << std::setw(44) << name << std::right
+            << std::setw(5) << s.truePositives << std::setw(5) << s.falsePositives << std::setw(5) << s.falseNegatives
+            << std::fixed << std::setprecision(3)
+            << std::setw(8) << s.precision() << std::setw(8) << s.recall() << std::setw(8) << s.f1()
+            << std::setw(9) << s.meanIoU();
+        if (latency >= 0.0)
+            out << std::setw(12) << std::setprecision(1) << latency;
+        out << "\n";
+    };
+    const char *header = "  configuration                                  TP   FP   FN    prec  recall      F1  mean-IoU  latency[ms]\n";
+
+    std::cout << "Evaluation: " << configs.size() << " configuration(s), IoU >= " << options.iouThreshold
+              << (options.sceneMode ? ", every object in every image" : ", each image for its own object")
+              << ", " << std::fixed << std::setprecision(1) << seconds << " s\n";
+    std::cout << header;
+    for (const auto &s : scores)
+        printRow(std::cout, s.config.label(), s.total, s.latencyMs());
+
+    std::vector<size_t> front = paretoFront(scores);
+    std::cout << "\nPareto front (latency vs F1)\n" << header;
+    for (size_t i : front)
+    {
+        printRow(std::cout, scores[i].config.label(), scores[i].total, scores[i].latencyMs());
+        for (const auto &o : scores[i].objects)
+            printRow(std::cout, "    " + o.objectKey, o, -1.0);
+    }
+
+    // Fastest configuration on the front that meets the bar
+    auto pick = std::find_if(front.begin(), front.end(), [&](size_t i)
+                             { return scores[i].total.f1() >= options.accuracyBar; });
+    if (pick != front.end())
+        std::cout << "\nFastest configuration with F1 >= " << std::setprecision(3) << options.accuracyBar << ": "
+                  << scores[*pick].config.label() << " (F1 " << scores[*pick].total.f1() << ", "
+                  << std::setprecision(1) << scores[*pick].latencyMs() << " ms/image)\n";
+    else
+        std::cout << "\nNo configuration reaches F1 >= " << std::setprecision(3) << options.accuracyBar << "\n";
+
+    // Machine-readable copy, one configuration per line
+    for (const auto &s : scores)
+    {
+        out << "{\"config\":\"" << jsonEscape(s.config.label()) << "\"" << std::fixed << std::setprecision(4)
+            << ",\"feature_ms\":" << s.featureMs << ",\"detect_ms\":" << s.detectMs << ",\"objects\":[";
+        for (size_t o = 0; o <= s.objects.size(); ++o)
+        {
+            const ObjectScore &os = o < s.objects.size() ? s.objects[o] : s.total;
+            out << (o ? "," : "") << "{\"object\":\"" << jsonEscape(os.objectKey) << "\",\"tp\":" << os.truePositives
+                << ",\"fp\":" << os.falsePositives << ",\"fn\":" << os.falseNegatives
+                << ",\"precision\":" << os.precision() << ",\"recall\":" << os.recall()
+                << ",\"f1\":" << os.f1() << ",\"mean_iou\":" << os.meanIoU() << "}";
+        }
+        out << "]}\n";
+    }
+    out.close();
+    std::cout << std::flush;
+    if (!out)
+    {
+        std::cerr << "Failed to write evaluation file: " << jsonPath.string() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int runWritePack(const IDataLoader &loader, const fs::path &rootPath, const RunOptions &options)
+{
+    ThreadPool pool(options.threads);
+    PackSummary summary;
+    auto start = std::chrono::steady_clock::now();
+    if (!writeDatasetPack(loader, rootPath, options.writePackPath, options.packEncoding, &pool, &summary))
+    {
+        std::cerr << "Failed to write dataset pack: " << options.writePackPath << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Packed " << summary.objects << " objects, " << summary.views << " views, "
+              << summary.testImages << " test images and " << summary.labels << " labels ("
+              << packEncodingName(options.packEncoding) << ", " << std::fixed << std::setprecision(1)
+              << summary.bytes / 1048576.0 << " MB) into " << options.writePackPath << " in "
+              << std::setprecision(2) << seconds << " s" << std::endl;
+    if (summary.skipped > 0)
+        std::cout << "Skipped " << summary.skipped << " unreadable files" << std::endl;
+    return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef CLI_TOOL_MODES_HPP
+#define CLI_TOOL_MODES_HPP
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include "dataloader.hpp"
+#include "detection.hpp"
+#include "feature_cache.hpp"
+#include "pipeline.hpp"
+#include "results_writer.hpp"
+#include "run_options.hpp"
+#include "thread_pool.hpp"
+
+// Modes of object-detect besides the dataset runs; each returns the exit code
+
+// Sequence mode: read a video or an ordered image sequence, detect every object on
+// keyframes and track the boxes in between
+int runSequenceMode(const std::vector<ObjectModel> &objects,
+                    const FeatureExtractor &extractor,
+                    const RunOptions &options,
+                    ThreadPool &pool,
+                    std::ofstream &logFile,
+                    ResultsWriter &writer);
+
+// Compare the SIMD matcher against cv::BFMatcher on every (view, test image) pair
+int runMatcherCheck(const IDataLoader &loader,
+                    const std::filesystem::path &rootPath,
+                    const std::vector<ObjectModel> &objects,
+                    const FeatureExtractor &extractor,
+                    ThreadPool &pool);
+
+// Run per-object detection on the dataset with each descriptor format and
+// compare the quantized formats with the float baseline
+int runQuantParity(const IDataLoader &loader,
+                   const std::filesystem::path &rootPath,
+                   const FeatureExtractor &extractor,
+                   const FeatureCache &cache,
+                   const RunOptions &options,
+                   ThreadPool &pool);
+
+// Run per-object detection on the dataset with each denoise mode and report
+// the preprocessing latency against the detection rate
+int runDenoiseBench(const IDataLoader &loader,
+                    const std::filesystem::path &rootPath,
+                    const FeatureExtractor &extractor,
+                    const std::filesystem::path &cachePath,
+                    const RunOptions &options,
+                    ThreadPool &pool);
+
+// Score detections against the labels for every configuration of the grid,
+// then print the latency/F1 Pareto front and the fastest configuration that
+// meets the accuracy bar
+int runEvaluation(const IDataLoader &loader,
+                  const std::filesystem::path &rootPath,
+                  const std::filesystem::path &resultsPath,
+                  const FeatureExtractor &extractor,
+                  const std::filesystem::path &cachePath,
+                  const RunOptions &options,
+                  ThreadPool &pool);
+
+// Pack the dataset into one memory-mappable file and read it back (--write-pack)
+int runWritePack(const IDataLoader &loader, const std::filesystem::path &rootPath, const RunOptions &options);
+
+#endif // CLI_TOOL_MODES_HPP
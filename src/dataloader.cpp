@@ -1,7 +1,9 @@
 // dataloader.cpp
 
 #include "dataloader.hpp"
+#include <fstream>
 #include <iostream>
+#include "image_io.hpp"
 
 using Path = std::filesystem::path;
 using DirIter = std::filesystem::directory_iterator;
@@ -40,11 +42,11 @@ std::vector<std::string> FileSystemDataLoader::listObjectKeys(const Path &root)
     }
     return keys;
 }
-// Load all color images and binary masks for each model view of the specified object
-std::vector<ModelView>
-FileSystemDataLoader::loadModelViews(const Path &root, const std::string &objectKey) const
+// List the color and mask files for each model view of the specified object
+std::vector<ModelViewFiles>
+FileSystemDataLoader::listModelViewFiles(const Path &root, const std::string &objectKey) const
 {
-    std::vector<ModelView> views;
+    std::vector<ModelViewFiles> files;
     Path modelsDir = root / objectKey / "models";
 
     for (auto &entry : DirIter(modelsDir))
@@ -56,16 +58,38 @@ FileSystemDataLoader::loadModelViews(const Path &root, const std::string &object
         std::string base = fname.substr(0, pos);
         std::string ext = entry.path().extension().string();
 
-        ModelView mv;
-        mv.name = base;
-        mv.color = cv::imread((modelsDir / (base + "_color" + ext)).string(), cv::IMREAD_COLOR);
-        mv.mask = cv::imread((modelsDir / (base + "_mask" + ext)).string(), cv::IMREAD_GRAYSCALE);
-        if (mv.color.empty())
+        ModelViewFiles mf;
+        mf.name = base;
+        mf.colorPath = modelsDir / (base + "_color" + ext);
+        mf.maskPath = modelsDir / (base + "_mask" + ext);
+        files.push_back(mf);
+    }
+    return files;
+}
+// Load the grayscale images and binary masks of each model view of the specified object
+std::vector<ModelView>
+FileSystemDataLoader::loadModelViews(const Path &root, const std::string &objectKey) const
+{
+    std::vector<ModelView> views;
+    for (const auto &mf : listModelViewFiles(root, objectKey))
+    {
+        ModelView mv = loadModelView(mf);
+        if (mv.gray.empty())
             continue;
         views.push_back(mv);
     }
     return views;
 }
+
+// Decode the grayscale image and the mask of one model view
+ModelView FileSystemDataLoader::loadModelView(const ModelViewFiles &files) const
+{
+    ModelView mv;
+    mv.name = files.name;
+    mv.gray = readImage(files.colorPath, cv::IMREAD_GRAYSCALE);
+    mv.mask = readImage(files.maskPath, cv::IMREAD_GRAYSCALE);
+    return mv;
+}
 // List all test image files for the specified object
 std::vector<TestImage>
 FileSystemDataLoader::listTestImages(const Path &root, const std::string &objectKey) const
@@ -83,3 +107,28 @@ FileSystemDataLoader::listTestImages(const Path &root, const std::string &object
     }
     return files;
 }
+// Decode a test image straight to grayscale
+cv::Mat FileSystemDataLoader::loadTestImage(const TestImage &image, double scale) const
+{
+    return readGrayscale(image.path, scale);
+}
+// Load the boxes of labels/<stem>-box.txt, where <stem> is the test image name
+// without its "-color" suffix; each line is "objectKey xmin ymin xmax ymax"
+std::vector<GroundTruthBox>
+FileSystemDataLoader::loadLabels(const Path &root, const std::string &objectKey, const TestImage &image) const
+{
+    std::vector<GroundTruthBox> boxes;
+    std::string stem = image.path.stem().string();
+    auto pos = stem.rfind("-color");
+    if (pos != std::string::npos)
+        stem = stem.substr(0, pos);
+
+    std::ifstream in(root / objectKey / "labels" / (stem + "-box.txt"));
+    std::string key;
+    int xmin, ymin, xmax, ymax;
+    while (in >> key >> xmin >> ymin >> xmax >> ymax)
+    {
+        boxes.push_back({key, cv::Rect(xmin, ymin, xmax - xmin, ymax - ymin)});
+    }
+    return boxes;
+}
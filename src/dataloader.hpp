@@ -3,6 +3,7 @@
 #define DATA_LOADER_HPP
 
 #include <opencv2/opencv.hpp>
+#include <cstdint>
 #include <filesystem>
 #include <vector>
 #include <string>
@@ -16,14 +17,24 @@ enum class IntegrityCode
     MissingModelsOrTests
 };
 
-// Representation of a single model view (color + optional mask)
+// Representation of a single model view (grayscale image + optional mask)
 struct ModelView
 {
-    cv::Mat color;
+    cv::Mat gray;     // decoded straight to grayscale; features never need the colour
     cv::Mat mask;     // empty if no mask available
     std::string name; // base file name without suffix
 };
 
+// Files backing a single model view (color + mask paths)
+struct ModelViewFiles
+{
+    std::string name; // base file name without suffix
+    std::filesystem::path colorPath;
+    std::filesystem::path maskPath;
+    uint64_t colorHash = 0; // content hashes recorded by an archive (0 = fingerprint the files)
+    uint64_t maskHash = 0;
+};
+
 // Representation of a test image (path + file name)
 struct TestImage
 {
@@ -31,6 +42,13 @@ struct TestImage
     std::string name;
 };
 
+// Ground-truth box of one object in a test image
+struct GroundTruthBox
+{
+    std::string objectKey;
+    cv::Rect box;
+};
+
 // Abstract interface for dataset loading (supports extension)
 class IDataLoader
 {
@@ -43,13 +61,31 @@ public:
     // List all object keys (e.g. "004_sugar_box") under the root
     virtual std::vector<std::string> listObjectKeys(const std::filesystem::path &root) const = 0;
 
-    // Load all model views (color + mask) for a given object key
+    // List the files of all model views for a given object key (no decoding)
+    virtual std::vector<ModelViewFiles>
+    listModelViewFiles(const std::filesystem::path &root, const std::string &objectKey) const = 0;
+
+    // Load all model views (grayscale + mask) for a given object key
     virtual std::vector<ModelView>
     loadModelViews(const std::filesystem::path &root, const std::string &objectKey) const = 0;
 
+    // Load one model view (empty gray if it cannot be read)
+    virtual ModelView loadModelView(const ModelViewFiles &files) const = 0;
+
     // List all test images (with path and name) for a given object key
     virtual std::vector<TestImage>
     listTestImages(const std::filesystem::path &root, const std::string &objectKey) const = 0;
+
+    // Decode a test image straight to grayscale at about `scale` of its size (empty on
+    // failure). The pixels may be shared with a cache and must not be modified.
+    virtual cv::Mat loadTestImage(const TestImage &image, double scale = 1.0) const = 0;
+
+    // Hint the order in which test images will be loaded next (no-op unless the loader prefetches)
+    virtual void prefetch(const std::vector<TestImage> &order, double scale = 1.0) const {}
+
+    // Load the ground-truth boxes of a test image (empty if it has no label file)
+    virtual std::vector<GroundTruthBox>
+    loadLabels(const std::filesystem::path &root, const std::string &objectKey, const TestImage &image) const = 0;
 };
 
 // Concrete filesystem-based loader
@@ -58,10 +94,16 @@ class FileSystemDataLoader : public IDataLoader
 public:
     IntegrityCode checkIntegrity(const std::filesystem::path &root) const override;
     std::vector<std::string> listObjectKeys(const std::filesystem::path &root) const override;
+    std::vector<ModelViewFiles>
+    listModelViewFiles(const std::filesystem::path &root, const std::string &objectKey) const override;
     std::vector<ModelView>
     loadModelViews(const std::filesystem::path &root, const std::string &objectKey) const override;
+    ModelView loadModelView(const ModelViewFiles &files) const override;
     std::vector<TestImage>
     listTestImages(const std::filesystem::path &root, const std::string &objectKey) const override;
+    cv::Mat loadTestImage(const TestImage &image, double scale = 1.0) const override;
+    std::vector<GroundTruthBox>
+    loadLabels(const std::filesystem::path &root, const std::string &objectKey, const TestImage &image) const override;
 };
 
 #endif // DATA_LOADER_HPP
@@ -0,0 +1,634 @@
+#include "dataset_pack.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include "image_io.hpp"
+
+struct PackDataLoader::StringRef
+{
+    uint32_t offset; // into the string table
+    uint32_t length;
+};
+
+struct PackDataLoader::Header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t encoding; // PackEncoding
+    uint32_t objectCount;
+    uint32_t viewCount;
+    uint32_t testCount;
+    uint32_t entryCount;
+    uint32_t labelCount;
+    uint64_t objectsOffset;
+    uint64_t viewsOffset;
+    uint64_t testsOffset;
+    uint64_t entriesOffset;
+    uint64_t labelsOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsBytes;
+};
+
+// One stored image: an 8-bit plane (rows x cols) or encoded bytes
+struct PackDataLoader::Entry
+{
+    uint64_t offset;
+    uint64_t size;
+    int32_t rows;
+    int32_t cols;
+    uint32_t encoding; // PackEncoding
+    uint32_t reserved;
+};
+
+struct PackDataLoader::ObjectRecord
+{
+    StringRef key;
+    uint32_t firstView;
+    uint32_t viewCount;
+    uint32_t firstTest;
+    uint32_t testCount;
+};
+
+struct PackDataLoader::ViewRecord
+{
+    StringRef name;
+    StringRef colorFile;
+    StringRef maskFile; // empty without a mask
+    uint32_t colorEntry;
+    uint32_t maskEntry; // kNoEntry without a mask
+    uint64_t colorHash; // content hashes of the packed files (feature cache fingerprints)
+    uint64_t maskHash;
+};
+
+struct PackDataLoader::TestRecord
+{
+    StringRef name;
+    uint32_t entry;
+    uint32_t firstLabel;
+    uint32_t labelCount;
+    uint32_t reserved;
+};
+
+struct PackDataLoader::LabelRecord
+{
+    StringRef objectKey;
+    int32_t x, y, width, height;
+};
+
+namespace
+{
+    const char kMagic[4] = {'O', 'D', 'P', 'K'};
+    const uint32_t kFormatVersion = 1;
+    const uint32_t kNoEntry = 0xFFFFFFFFu;
+    const size_t kPlaneAlignment = 64; // planes start on a cache line
+
+    using Pack = PackDataLoader;
+
+    // An image read from the dataset, ready to be written
+    struct StagedImage
+    {
+        std::vector<uint8_t> bytes;
+        int rows = 0;
+        int cols = 0;
+        uint64_t contentHash = 0; // of the source file
+        bool ok = false;
+        bool missing = false; // encoded only: the source file does not exist
+    };
+
+    bool isImageFile(const std::filesystem::path &path)
+    {
+        std::string ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        return !path.filename().string().empty() && path.filename().string()[0] != '.' &&
+               (ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".bmp" || ext == ".tif" || ext == ".tiff");
+    }
+
+    // Content hash of a model file: the one recorded by the loader, else that of the file
+    uint64_t contentHash(const std::filesystem::path &path, uint64_t recorded)
+    {
+        if (recorded)
+            return recorded;
+        MappedFile file;
+        return file.open(path) && file.size() > 0 ? fnv1a64(file.data(), file.size()) : 0;
+    }
+
+    // Copy an 8-bit grayscale image read through the loader into a plane
+    StagedImage stagePlane(const cv::Mat &gray, uint64_t hash = 0)
+    {
+        StagedImage staged;
+        if (gray.empty() || gray.type() != CV_8U)
+            return staged;
+        cv::Mat plane = gray.isContinuous() ? gray : gray.clone();
+        staged.rows = plane.rows;
+        staged.cols = plane.cols;
+        staged.bytes.assign(plane.data, plane.data + plane.total());
+        staged.contentHash = hash;
+        staged.ok = true;
+        return staged;
+    }
+
+    // Read the original bytes of an image file (encoded packs). The loader only returns
+    // decoded pixels, so encoded packs need the dataset files themselves.
+    StagedImage stageFile(const std::filesystem::path &path)
+    {
+        StagedImage staged;
+        if (!isImageFile(path))
+            return staged;
+        MappedFile file;
+        if (!file.open(path) || file.size() == 0)
+        {
+            staged.missing = !std::filesystem::exists(path);
+            return staged;
+        }
+        staged.contentHash = fnv1a64(file.data(), file.size());
+        staged.bytes.assign(file.data(), file.data() + file.size());
+        staged.ok = true;
+        return staged;
+    }
+
+    // Sequential writer of aligned sections
+    class PackWriter
+    {
+    public:
+        explicit PackWriter(std::ofstream &out) : out_(out) {}
+
+        uint64_t append(const void *data, size_t size, size_t alignment = 8)
+        {
+            static const char zeros[kPlaneAlignment] = {};
+            size_t pad = (alignment - offset_ % alignment) % alignment;
+            out_.write(zeros, static_cast<std::streamsize>(pad));
+            offset_ += pad;
+            uint64_t at = offset_;
+            out_.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+            offset_ += size;
+            return at;
+        }
+
+        uint64_t offset() const { return offset_; }
+
+    private:
+        std::ofstream &out_;
+        uint64_t offset_ = 0;
+    };
+
+    // Table of the strings of the pack
+    struct StringTable
+    {
+        std::vector<char> chars;
+
+        Pack::StringRef add(const std::string &s)
+        {
+            Pack::StringRef ref{static_cast<uint32_t>(chars.size()), static_cast<uint32_t>(s.size())};
+            chars.insert(chars.end(), s.begin(), s.end());
+            return ref;
+        }
+    };
+
+    // Key of an image path in the lookup tables: <object>/<directory>/<file>
+    std::string relativeKey(const std::filesystem::path &path)
+    {
+        return (path.parent_path().parent_path().filename() / path.parent_path().filename() / path.filename())
+            .generic_string();
+    }
+}
+
+const char *packEncodingName(PackEncoding encoding)
+{
+    return encoding == PackEncoding::Encoded ? "encoded" : "planes";
+}
+
+bool parsePackEncoding(const std::string &name, PackEncoding &encoding)
+{
+    if (name == "planes")
+        encoding = PackEncoding::Planes;
+    else if (name == "encoded")
+        encoding = PackEncoding::Encoded;
+    else
+        return false;
+    return true;
+}
+
+bool writeDatasetPack(const IDataLoader &loader,
+                      const std::filesystem::path &root,
+                      const std::filesystem::path &path,
+                      PackEncoding encoding,
+                      ThreadPool *pool,
+                      PackSummary *summary)
+{
+    PackSummary sum;
+
+    // Write to a temporary file and rename, so a reader never maps a partial pack
+    std::error_code ec;
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path(), ec);
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        std::cerr << "Failed to write dataset pack: " << tmpPath << std::endl;
+        return false;
+    }
+    auto abandon = [&]()
+    {
+        out.close();
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    };
+    // Encoded packs copy the dataset files; a loader without them (e.g. a pack) cannot
+    // provide the original bytes
+    auto missingFile = [&](const std::vector<StagedImage> &staged, const std::function<std::filesystem::path(size_t)> &path)
+    {
+        for (size_t i = 0; i < staged.size(); ++i)
+        {
+            if (staged[i].missing)
+            {
+                std::cerr << "Encoded packs copy the dataset files, and " << path(i).string()
+                          << " does not exist; pack the files or use planes" << std::endl;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    Pack::Header header{};
+    PackWriter writer(out);
+    writer.append(&header, sizeof(header)); // rewritten at the end
+
+    std::vector<Pack::ObjectRecord> objects;
+    std::vector<Pack::ViewRecord> views;
+    std::vector<Pack::TestRecord> tests;
+    std::vector<Pack::Entry> entries;
+    std::vector<Pack::LabelRecord> labels;
+    StringTable strings;
+
+    // Image data goes out as it is staged, so memory holds one object at a time
+    auto writeEntry = [&](const StagedImage &staged)
+    {
+        Pack::Entry entry{};
+        entry.encoding = static_cast<uint32_t>(encoding);
+        entry.rows = staged.rows;
+        entry.cols = staged.cols;
+        entry.size = staged.bytes.size();
+        entry.offset = writer.append(staged.bytes.data(), staged.bytes.size(),
+                                     encoding == PackEncoding::Planes ? kPlaneAlignment : 8);
+        entries.push_back(entry);
+        return static_cast<uint32_t>(entries.size() - 1);
+    };
+    auto parallel = [&](size_t count, const std::function<void(size_t)> &body)
+    {
+        if (pool)
+            pool->parallelFor(0, count, body);
+        else
+            for (size_t i = 0; i < count; ++i)
+                body(i);
+    };
+
+    for (const auto &key : loader.listObjectKeys(root))
+    {
+        Pack::ObjectRecord object{};
+        object.key = strings.add(key);
+        object.firstView = static_cast<uint32_t>(views.size());
+        object.firstTest = static_cast<uint32_t>(tests.size());
+
+        // Model views: colour image (stored as grayscale planes) and optional mask.
+        // Planes are read through the loader, so a pack can be repacked.
+        std::vector<ModelViewFiles> viewFiles = loader.listModelViewFiles(root, key);
+        std::vector<StagedImage> colors(viewFiles.size()), masks(viewFiles.size());
+        parallel(viewFiles.size(), [&](size_t i)
+                 {
+                     const ModelViewFiles &files = viewFiles[i];
+                     if (encoding == PackEncoding::Encoded)
+                     {
+                         colors[i] = stageFile(files.colorPath);
+                         if (!files.maskPath.empty() && (files.maskHash || std::filesystem::exists(files.maskPath)))
+                             masks[i] = stageFile(files.maskPath);
+                         return;
+                     }
+                     ModelView view = loader.loadModelView(files);
+                     colors[i] = stagePlane(view.gray, contentHash(files.colorPath, files.colorHash));
+                     if (!view.mask.empty())
+                         masks[i] = stagePlane(view.mask, contentHash(files.maskPath, files.maskHash));
+                 });
+        if (missingFile(colors, [&](size_t i) { return viewFiles[i].colorPath; }) ||
+            missingFile(masks, [&](size_t i) { return viewFiles[i].maskPath; }))
+            return abandon();
+        for (size_t i = 0; i < viewFiles.size(); ++i)
+        {
+            if (!colors[i].ok)
+            {
+                ++sum.skipped;
+                continue;
+            }
+            Pack::ViewRecord view{};
+            view.name = strings.add(viewFiles[i].name);
+            view.colorFile = strings.add(viewFiles[i].colorPath.filename().string());
+            view.colorEntry = writeEntry(colors[i]);
+            view.colorHash = colors[i].contentHash;
+            view.maskEntry = kNoEntry;
+            if (masks[i].ok)
+            {
+                view.maskFile = strings.add(viewFiles[i].maskPath.filename().string());
+                view.maskEntry = writeEntry(masks[i]);
+                view.maskHash = masks[i].contentHash;
+            }
+            views.push_back(view);
+        }
+
+        // Test images with their parsed labels
+        std::vector<TestImage> images = loader.listTestImages(root, key);
+        std::vector<StagedImage> staged(images.size());
+        parallel(images.size(), [&](size_t i)
+                 {
+                     staged[i] = encoding == PackEncoding::Encoded ? stageFile(images[i].path)
+                                                                   : stagePlane(loader.loadTestImage(images[i]));
+                 });
+        if (missingFile(staged, [&](size_t i) { return images[i].path; }))
+            return abandon();
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            if (!staged[i].ok)
+            {
+                ++sum.skipped;
+                continue;
+            }
+            Pack::TestRecord test{};
+            test.name = strings.add(images[i].name);
+            test.entry = writeEntry(staged[i]);
+            test.firstLabel = static_cast<uint32_t>(labels.size());
+            for (const auto &gt : loader.loadLabels(root, key, images[i]))
+                labels.push_back({strings.add(gt.objectKey), gt.box.x, gt.box.y, gt.box.width, gt.box.height});
+            test.labelCount = static_cast<uint32_t>(labels.size() - test.firstLabel);
+            tests.push_back(test);
+        }
+
+        object.viewCount = static_cast<uint32_t>(views.size() - object.firstView);
+        object.testCount = static_cast<uint32_t>(tests.size() - object.firstTest);
+        objects.push_back(object);
+    }
+
+    // Index tables after the data, then the header with their offsets
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFormatVersion;
+    header.encoding = static_cast<uint32_t>(encoding);
+    header.objectCount = static_cast<uint32_t>(objects.size());
+    header.viewCount = static_cast<uint32_t>(views.size());
+    header.testCount = static_cast<uint32_t>(tests.size());
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.labelCount = static_cast<uint32_t>(labels.size());
+    header.objectsOffset = writer.append(objects.data(), objects.size() * sizeof(Pack::ObjectRecord));
+    header.viewsOffset = writer.append(views.data(), views.size() * sizeof(Pack::ViewRecord));
+    header.testsOffset = writer.append(tests.data(), tests.size() * sizeof(Pack::TestRecord));
+    header.entriesOffset = writer.append(entries.data(), entries.size() * sizeof(Pack::Entry));
+    header.labelsOffset = writer.append(labels.data(), labels.size() * sizeof(Pack::LabelRecord));
+    header.stringsOffset = writer.append(strings.chars.data(), strings.chars.size());
+    header.stringsBytes = strings.chars.size();
+    sum.bytes = writer.offset();
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.close();
+    if (!out)
+        return abandon();
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec)
+        return false;
+
+    sum.objects = objects.size();
+    sum.views = views.size();
+    sum.testImages = tests.size();
+    sum.labels = labels.size();
+    if (summary)
+        *summary = sum;
+    return true;
+}
+
+bool PackDataLoader::open(const std::filesystem::path &path)
+{
+    header_ = nullptr;
+    objectIndex_.clear();
+    viewIndex_.clear();
+    testIndex_.clear();
+    if (!file_.open(path) || file_.size() < sizeof(Header))
+        return false;
+
+    const uint8_t *base = file_.data();
+    const size_t size = file_.size();
+    const Header *h = reinterpret_cast<const Header *>(base);
+    if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 || h->version != kFormatVersion)
+        return false;
+
+    // Every table must lie inside the file
+    auto fits = [&](uint64_t offset, uint64_t bytes)
+    { return offset <= size && bytes <= size - offset; };
+    if (!fits(h->objectsOffset, uint64_t(h->objectCount) * sizeof(ObjectRecord)) ||
+        !fits(h->viewsOffset, uint64_t(h->viewCount) * sizeof(ViewRecord)) ||
+        !fits(h->testsOffset, uint64_t(h->testCount) * sizeof(TestRecord)) ||
+        !fits(h->entriesOffset, uint64_t(h->entryCount) * sizeof(Entry)) ||
+        !fits(h->labelsOffset, uint64_t(h->labelCount) * sizeof(LabelRecord)) ||
+        !fits(h->stringsOffset, h->stringsBytes))
+        return false;
+
+    objects_ = reinterpret_cast<const ObjectRecord *>(base + h->objectsOffset);
+    views_ = reinterpret_cast<const ViewRecord *>(base + h->viewsOffset);
+    tests_ = reinterpret_cast<const TestRecord *>(base + h->testsOffset);
+    entries_ = reinterpret_cast<const Entry *>(base + h->entriesOffset);
+    labels_ = reinterpret_cast<const LabelRecord *>(base + h->labelsOffset);
+    strings_ = reinterpret_cast<const char *>(base + h->stringsOffset);
+
+    // Validate the references once, so lookups need no checks
+    auto stringOk = [&](const StringRef &ref)
+    { return uint64_t(ref.offset) + ref.length <= h->stringsBytes; };
+    auto entryOk = [&](uint32_t e)
+    { return e < h->entryCount && fits(entries_[e].offset, entries_[e].size); };
+    for (uint32_t e = 0; e < h->entryCount; ++e)
+    {
+        const Entry &entry = entries_[e];
+        if (entry.encoding == static_cast<uint32_t>(PackEncoding::Planes) &&
+            uint64_t(entry.rows) * uint64_t(entry.cols) != entry.size)
+            return false;
+    }
+    for (uint32_t l = 0; l < h->labelCount; ++l)
+        if (!stringOk(labels_[l].objectKey))
+            return false;
+
+    header_ = h; // string() is usable from here on
+    bool ok = true;
+    for (uint32_t o = 0; o < h->objectCount && ok; ++o)
+    {
+        const ObjectRecord &object = objects_[o];
+        ok = stringOk(object.key) && uint64_t(object.firstView) + object.viewCount <= h->viewCount &&
+             uint64_t(object.firstTest) + object.testCount <= h->testCount;
+        if (!ok)
+            break;
+        const std::string key = string(object.key);
+        objectIndex_[key] = o;
+        for (uint32_t v = object.firstView; v < object.firstView + object.viewCount && ok; ++v)
+        {
+            const ViewRecord &view = views_[v];
+            ok = stringOk(view.name) && stringOk(view.colorFile) && stringOk(view.maskFile) &&
+                 entryOk(view.colorEntry) && (view.maskEntry == kNoEntry || entryOk(view.maskEntry));
+            if (ok)
+                viewIndex_[key + "/models/" + string(view.colorFile)] = v;
+        }
+        for (uint32_t t = object.firstTest; t < object.firstTest + object.testCount && ok; ++t)
+        {
+            const TestRecord &test = tests_[t];
+            ok = stringOk(test.name) && entryOk(test.entry) &&
+                 uint64_t(test.firstLabel) + test.labelCount <= h->labelCount;
+            if (ok)
+                testIndex_[key + "/test_images/" + string(test.name)] = t;
+        }
+    }
+    if (!ok)
+    {
+        header_ = nullptr;
+        objectIndex_.clear();
+        viewIndex_.clear();
+        testIndex_.clear();
+    }
+    return ok;
+}
+
+PackEncoding PackDataLoader::encoding() const
+{
+    return header_ ? static_cast<PackEncoding>(header_->encoding) : PackEncoding::Planes;
+}
+
+std::string PackDataLoader::string(const StringRef &ref) const
+{
+    return std::string(strings_ + ref.offset, ref.length);
+}
+
+const PackDataLoader::ObjectRecord *PackDataLoader::findObject(const std::string &key) const
+{
+    auto it = objectIndex_.find(key);
+    return it == objectIndex_.end() ? nullptr : &objects_[it->second];
+}
+
+cv::Mat PackDataLoader::image(uint32_t index, double scale, bool mask) const
+{
+    const Entry &entry = entries_[index];
+    const uint8_t *data = file_.data() + entry.offset;
+    if (entry.encoding == static_cast<uint32_t>(PackEncoding::Encoded))
+        return mask ? decodeImage(data, entry.size, cv::IMREAD_GRAYSCALE) : decodeGrayscale(data, entry.size, scale);
+
+    // Planes point into the mapping; only a rescale copies
+    cv::Mat plane(entry.rows, entry.cols, CV_8U, const_cast<uint8_t *>(data));
+    if (scale >= 1.0 - 1e-9)
+        return plane;
+    cv::Mat resized;
+    cv::resize(plane, resized, cv::Size(), scale, scale, cv::INTER_AREA);
+    return resized;
+}
+
+IntegrityCode PackDataLoader::checkIntegrity(const std::filesystem::path &) const
+{
+    if (!header_)
+        return IntegrityCode::InvalidRoot;
+    return header_->objectCount == 0 ? IntegrityCode::MissingObjectDirs : IntegrityCode::OK;
+}
+
+std::vector<std::string> PackDataLoader::listObjectKeys(const std::filesystem::path &) const
+{
+    std::vector<std::string> keys;
+    for (uint32_t o = 0; header_ && o < header_->objectCount; ++o)
+        keys.push_back(string(objects_[o].key));
+    return keys;
+}
+
+std::vector<ModelViewFiles>
+PackDataLoader::listModelViewFiles(const std::filesystem::path &root, const std::string &objectKey) const
+{
+    std::vector<ModelViewFiles> files;
+    const ObjectRecord *object = findObject(objectKey);
+    if (!object)
+        return files;
+    const std::filesystem::path modelsDir = root / objectKey / "models";
+    for (uint32_t v = object->firstView; v < object->firstView + object->viewCount; ++v)
+    {
+        const ViewRecord &view = views_[v];
+        ModelViewFiles mf;
+        mf.name = string(view.name);
+        mf.colorPath = modelsDir / string(view.colorFile);
+        mf.colorHash = view.colorHash;
+        if (view.maskEntry != kNoEntry)
+        {
+            mf.maskPath = modelsDir / string(view.maskFile);
+            mf.maskHash = view.maskHash;
+        }
+        files.push_back(mf);
+    }
+    return files;
+}
+
+std::vector<ModelView>
+PackDataLoader::loadModelViews(const std::filesystem::path &root, const std::string &objectKey) const
+{
+    std::vector<ModelView> views;
+    for (const auto &mf : listModelViewFiles(root, objectKey))
+    {
+        ModelView mv = loadModelView(mf);
+        if (!mv.gray.empty())
+            views.push_back(mv);
+    }
+    return views;
+}
+
+ModelView PackDataLoader::loadModelView(const ModelViewFiles &files) const
+{
+    ModelView mv;
+    mv.name = files.name;
+    auto it = viewIndex_.find(relativeKey(files.colorPath));
+    if (it == viewIndex_.end())
+        return mv;
+    const ViewRecord &view = views_[it->second];
+    mv.gray = image(view.colorEntry, 1.0, false);
+    if (view.maskEntry != kNoEntry)
+        mv.mask = image(view.maskEntry, 1.0, true);
+    return mv;
+}
+
+std::vector<TestImage>
+PackDataLoader::listTestImages(const std::filesystem::path &root, const std::string &objectKey) const
+{
+    std::vector<TestImage> images;
+    const ObjectRecord *object = findObject(objectKey);
+    if (!object)
+        return images;
+    const std::filesystem::path testDir = root / objectKey / "test_images";
+    for (uint32_t t = object->firstTest; t < object->firstTest + object->testCount; ++t)
+    {
+        TestImage ti;
+        ti.name = string(tests_[t].name);
+        ti.path = testDir / ti.name;
+        images.push_back(ti);
+    }
+    return images;
+}
+
+cv::Mat PackDataLoader::loadTestImage(const TestImage &image, double scale) const
+{
+    auto it = testIndex_.find(relativeKey(image.path));
+    if (it == testIndex_.end())
+        return cv::Mat();
+    return this->image(tests_[it->second].entry, scale, false);
+}
+
+std::vector<GroundTruthBox>
+PackDataLoader::loadLabels(const std::filesystem::path &, const std::string &, const TestImage &image) const
+{
+    std::vector<GroundTruthBox> boxes;
+    auto it = testIndex_.find(relativeKey(image.path));
+    if (it == testIndex_.end())
+        return boxes;
+    const TestRecord &test = tests_[it->second];
+    for (uint32_t l = test.firstLabel; l < test.firstLabel + test.labelCount; ++l)
+    {
+        const LabelRecord &label = labels_[l];
+        boxes.push_back({string(label.objectKey), cv::Rect(label.x, label.y, label.width, label.height)});
+    }
+    return boxes;
+}
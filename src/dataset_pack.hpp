@@ -0,0 +1,101 @@
+#ifndef DATASET_PACK_HPP
+#define DATASET_PACK_HPP
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "dataloader.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+
+// How the images of a dataset pack are stored
+enum class PackEncoding
+{
+    Planes, // decoded 8-bit grayscale images and masks, read without decoding
+    Encoded // the original PNG/JPEG bytes, decoded on load
+};
+
+const char *packEncodingName(PackEncoding encoding);
+bool parsePackEncoding(const std::string &name, PackEncoding &encoding);
+
+// Contents of a written pack
+struct PackSummary
+{
+    size_t objects = 0;
+    size_t views = 0;
+    size_t testImages = 0;
+    size_t labels = 0;
+    size_t skipped = 0; // files that are not readable images (e.g. .DS_Store)
+    uint64_t bytes = 0;
+};
+
+// Write the model views, test images and parsed labels of every object of a dataset
+// into one indexed file. Images are decoded on the pool (nullptr = serially). Planes
+// are read through the loader, so any loader (including a pack) can be packed; encoded
+// packs copy the original files and fail if the loader has none. Returns false if the
+// file cannot be written.
+bool writeDatasetPack(const IDataLoader &loader,
+                      const std::filesystem::path &root,
+                      const std::filesystem::path &path,
+                      PackEncoding encoding,
+                      ThreadPool *pool = nullptr,
+                      PackSummary *summary = nullptr);
+
+// Reads a dataset from a pack written by writeDatasetPack. The file is memory-mapped
+// and every image, view and label set is found in O(1) through the tables built by open();
+// planes are returned without a copy. Paths are those of the dataset that was packed,
+// relative to the root passed to the listing calls (the files need not exist).
+class PackDataLoader : public IDataLoader
+{
+public:
+    // Map a pack and build its lookup tables; returns false if it is missing or invalid
+    bool open(const std::filesystem::path &path);
+
+    bool isOpen() const { return header_ != nullptr; }
+    PackEncoding encoding() const;
+    size_t fileBytes() const { return file_.size(); }
+
+    IntegrityCode checkIntegrity(const std::filesystem::path &root) const override;
+    std::vector<std::string> listObjectKeys(const std::filesystem::path &root) const override;
+    std::vector<ModelViewFiles>
+    listModelViewFiles(const std::filesystem::path &root, const std::string &objectKey) const override;
+    std::vector<ModelView>
+    loadModelViews(const std::filesystem::path &root, const std::string &objectKey) const override;
+    ModelView loadModelView(const ModelViewFiles &files) const override;
+    std::vector<TestImage>
+    listTestImages(const std::filesystem::path &root, const std::string &objectKey) const override;
+    cv::Mat loadTestImage(const TestImage &image, double scale = 1.0) const override;
+    std::vector<GroundTruthBox>
+    loadLabels(const std::filesystem::path &root, const std::string &objectKey, const TestImage &image) const override;
+
+    // On-disk records (defined in dataset_pack.cpp)
+    struct Header;
+    struct StringRef;
+    struct Entry;
+    struct ObjectRecord;
+    struct ViewRecord;
+    struct TestRecord;
+    struct LabelRecord;
+
+private:
+    std::string string(const StringRef &ref) const;
+    cv::Mat image(uint32_t entry, double scale, bool mask) const;
+    const ObjectRecord *findObject(const std::string &key) const;
+
+    MappedFile file_;
+    const Header *header_ = nullptr;
+    const ObjectRecord *objects_ = nullptr;
+    const ViewRecord *views_ = nullptr;
+    const TestRecord *tests_ = nullptr;
+    const Entry *entries_ = nullptr;
+    const LabelRecord *labels_ = nullptr;
+    const char *strings_ = nullptr;
+    std::unordered_map<std::string, uint32_t> objectIndex_; // object key -> object
+    std::unordered_map<std::string, uint32_t> viewIndex_;   // <key>/models/<color file> -> view
+    std::unordered_map<std::string, uint32_t> testIndex_;   // <key>/test_images/<name> -> test image
+};
+
+#endif // DATASET_PACK_HPP
@@ -0,0 +1,89 @@
+#include "descriptor_format.hpp"
+#include <cmath>
+
+// SIFT stores its normalized descriptor scaled by 512; RootSIFT values (<= 1)
+// use the same factor, saturating the rare components above 255/512
+static const float kRootSiftScale = 512.0f;
+
+const char *descriptorFormatName(DescriptorFormat format)
+{
+    switch (format)
+    {
+    case DescriptorFormat::Uint8:
+        return "uint8";
+    case DescriptorFormat::RootSift8:
+        return "rootsift";
+    default:
+        return "float";
+    }
+}
+
+bool parseDescriptorFormat(const std::string &name, DescriptorFormat &format)
+{
+    if (name == "float")
+        format = DescriptorFormat::Float32;
+    else if (name == "uint8")
+        format = DescriptorFormat::Uint8;
+    else if (name == "rootsift")
+        format = DescriptorFormat::RootSift8;
+    else
+        return false;
+    return true;
+}
+
+cv::Mat DescriptorQuantizer::convert(const cv::Mat &descriptors, DescriptorFormat format)
+{
+    if (descriptors.empty())
+        return descriptors;
+
+    switch (format)
+    {
+    case DescriptorFormat::Float32:
+    {
+        if (descriptors.type() == CV_32F)
+            return descriptors;
+        cv::Mat out;
+        descriptors.convertTo(out, CV_32F);
+        return out;
+    }
+    case DescriptorFormat::Uint8:
+    {
+        if (descriptors.type() == CV_8U)
+            return descriptors;
+        // OpenCV's float SIFT values are already whole numbers in [0, 255]
+        cv::Mat out;
+        descriptors.convertTo(out, CV_8U);
+        return out;
+    }
+    case DescriptorFormat::RootSift8:
+    {
+        // Byte rows are RootSIFT already; rooting them again would move them to
+        // another space than the float queries converted once
+        if (descriptors.type() == CV_8U)
+            return descriptors;
+        cv::Mat src;
+        descriptors.convertTo(src, CV_32F);
+        cv::Mat out(src.rows, src.cols, CV_8U);
+        for (int r = 0; r < src.rows; ++r)
+        {
+            const float *in = src.ptr<float>(r);
+            uchar *dst = out.ptr<uchar>(r);
+
+            float l1 = 0.0f;
+            for (int c = 0; c < src.cols; ++c)
+                l1 += std::abs(in[c]);
+            float inv = l1 > 0.0f ? 1.0f / l1 : 0.0f;
+
+            for (int c = 0; c < src.cols; ++c)
+                dst[c] = cv::saturate_cast<uchar>(std::sqrt(std::abs(in[c]) * inv) * kRootSiftScale);
+        }
+        return out;
+    }
+    }
+    return descriptors;
+}
+
+size_t DescriptorQuantizer::bytesPerDescriptor(DescriptorFormat format, int dims)
+{
+    return format == DescriptorFormat::Float32 ? dims * sizeof(float) : dims;
+}
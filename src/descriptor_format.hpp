@@ -0,0 +1,31 @@
+#ifndef DESCRIPTOR_FORMAT_HPP
+#define DESCRIPTOR_FORMAT_HPP
+
+#include <opencv2/opencv.hpp>
+#include <string>
+
+// Storage format of SIFT descriptors
+enum class DescriptorFormat
+{
+    Float32,  // CV_32F rows as produced by SIFT (512 bytes per keypoint)
+    Uint8,    // CV_8U rows, SIFT values rounded to bytes (128 bytes per keypoint)
+    RootSift8 // CV_8U rows of RootSIFT (L1-normalized, square-rooted)
+};
+
+const char *descriptorFormatName(DescriptorFormat format);
+
+// Parse "float", "uint8" or "rootsift"; returns false for unknown names
+bool parseDescriptorFormat(const std::string &name, DescriptorFormat &format);
+
+class DescriptorQuantizer
+{
+public:
+    // Convert float SIFT descriptors to the given format. Idempotent: rows already in
+    // the format (CV_8U for the byte formats) are returned without a copy.
+    static cv::Mat convert(const cv::Mat &descriptors, DescriptorFormat format);
+
+    // Bytes used by one descriptor row of the given width
+    static size_t bytesPerDescriptor(DescriptorFormat format, int dims = 128);
+};
+
+#endif // DESCRIPTOR_FORMAT_HPP
@@ -1,26 +1,44 @@
 #include "detection.hpp"
 
-std::vector<cv::KeyPoint> Detection::detectKeypoints(const cv::Mat &image, const cv::Mat &mask)
+FeatureExtractor::FeatureExtractor(const SiftParams &params)
+    : params_(params)
 {
-    // Use SIFT with optimized parameters for industrial objects
-    cv::Ptr<cv::SIFT> sift = cv::SIFT::create(
-        0,    // nfeatures (0 = no limit)
-        3,    // nOctaveLayers
-        0.04, // contrastThreshold
-        10.0, // edgeThreshold
-        1.6   // sigma
-    );
+}
+
+ImageFeatures FeatureExtractor::extract(const cv::Mat &image, const cv::Mat &mask) const
+{
+    cv::Ptr<cv::SIFT> sift = acquire();
+
+    ImageFeatures features;
+    sift->detectAndCompute(image, mask, features.keypoints, features.descriptors);
 
-    std::vector<cv::KeyPoint> keypoints;
-    sift->detect(image, keypoints, mask);
+    release(sift);
+    return features;
+}
+
+cv::Ptr<cv::SIFT> FeatureExtractor::acquire() const
+{
+    {
+        std::lock_guard<std::mutex> lock(poolMutex_);
+        if (!pool_.empty())
+        {
+            cv::Ptr<cv::SIFT> sift = pool_.back();
+            pool_.pop_back();
+            return sift;
+        }
+    }
 
-    return keypoints;
+    // No idle detector: this caller is a new concurrent worker
+    return cv::SIFT::create(
+        params_.nFeatures,
+        params_.nOctaveLayers,
+        params_.contrastThreshold,
+        params_.edgeThreshold,
+        params_.sigma);
 }
 
-cv::Mat Detection::computeDescriptors(const cv::Mat &image, std::vector<cv::KeyPoint> &keypoints)
+void FeatureExtractor::release(cv::Ptr<cv::SIFT> sift) const
 {
-    cv::Ptr<cv::SIFT> sift = cv::SIFT::create();
-    cv::Mat descriptors;
-    sift->compute(image, keypoints, descriptors);
-    return descriptors;
-}
\ No newline at end of file
+    std::lock_guard<std::mutex> lock(poolMutex_);
+    pool_.push_back(std::move(sift));
+}
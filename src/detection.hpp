@@ -2,20 +2,56 @@
 #define DETECTION_HPP
 
 #include <opencv2/opencv.hpp>
+#include <mutex>
+#include <string>
 #include <vector>
 
-class Detection
+// SIFT parameters shared by keypoint detection and description
+struct SiftParams
+{
+    int nFeatures = 0;               // 0 = no limit
+    int nOctaveLayers = 3;
+    double contrastThreshold = 0.04;
+    double edgeThreshold = 10.0;
+    double sigma = 1.6;
+};
+
+// Keypoints and descriptors of one image
+struct ImageFeatures
+{
+    std::vector<cv::KeyPoint> keypoints;
+    cv::Mat descriptors;
+};
+
+// Features extracted from a single model view
+struct ViewFeatures
+{
+    std::string name;                   // base file name of the view
+    std::vector<cv::KeyPoint> keypoints;
+    cv::Mat descriptors;
+    cv::Size maskSize;                  // size of the view mask (model extent)
+};
+
+// SIFT feature extractor. Detection and description run in a single
+// detectAndCompute pass with one parameter set. Detectors are pooled, so each
+// concurrent caller gets its own instance and instances are reused across calls.
+class FeatureExtractor
 {
 public:
-    // Detect keypoints (with or without mask)
-    static std::vector<cv::KeyPoint> detectKeypoints(
-        const cv::Mat &image,
-        const cv::Mat &mask = cv::Mat());
-
-    // Compute SIFT descriptors
-    static cv::Mat computeDescriptors(
-        const cv::Mat &image,
-        std::vector<cv::KeyPoint> &keypoints);
+    explicit FeatureExtractor(const SiftParams &params = SiftParams());
+
+    const SiftParams &params() const { return params_; }
+
+    // Detect keypoints and compute descriptors (with or without mask); thread-safe
+    ImageFeatures extract(const cv::Mat &image, const cv::Mat &mask = cv::Mat()) const;
+
+private:
+    cv::Ptr<cv::SIFT> acquire() const;
+    void release(cv::Ptr<cv::SIFT> sift) const;
+
+    SiftParams params_;
+    mutable std::mutex poolMutex_;
+    mutable std::vector<cv::Ptr<cv::SIFT>> pool_; // idle detectors
 };
 
-#endif // DETECTION_HPP
\ No newline at end of file
+#endif // DETECTION_HPP
@@ -0,0 +1,437 @@
+#include "detection_server.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "image_io.hpp"
+#include "percentile.hpp"
+#include "result_records.hpp"
+#include "text_escape.hpp"
+
+namespace
+{
+    const size_t kLatencyWindow = 1024;       // recent requests kept for the percentiles
+    const size_t kMaxImageBytes = 64u << 20;  // largest DETECT_BYTES payload accepted
+
+    // Buffered reads of lines and byte blocks from a socket
+    class SocketReader
+    {
+    public:
+        explicit SocketReader(int fd) : fd_(fd) {}
+
+        bool readLine(std::string &line)
+        {
+            for (;;)
+            {
+                auto nl = std::find(buffer_.begin() + pos_, buffer_.end(), '\n');
+                if (nl != buffer_.end())
+                {
+                    line.assign(buffer_.begin() + pos_, nl);
+                    if (!line.empty() && line.back() == '\r')
+                        line.pop_back();
+                    pos_ = nl - buffer_.begin() + 1;
+                    return true;
+                }
+                if (!fill())
+                    return false;
+            }
+        }
+
+        bool readBytes(size_t n, std::vector<uchar> &out)
+        {
+            out.clear();
+            out.reserve(n);
+            while (out.size() < n)
+            {
+                if (pos_ == buffer_.size() && !fill())
+                    return false;
+                size_t take = std::min(n - out.size(), buffer_.size() - pos_);
+                out.insert(out.end(), buffer_.begin() + pos_, buffer_.begin() + pos_ + take);
+                pos_ += take;
+            }
+            return true;
+        }
+
+    private:
+        bool fill()
+        {
+            // Drop consumed data, then append what the socket has
+            buffer_.erase(buffer_.begin(), buffer_.begin() + pos_);
+            pos_ = 0;
+            char chunk[65536];
+            ssize_t n;
+            do
+                n = ::read(fd_, chunk, sizeof(chunk));
+            while (n < 0 && errno == EINTR);
+            if (n <= 0)
+                return false;
+            buffer_.insert(buffer_.end(), chunk, chunk + n);
+            return true;
+        }
+
+        int fd_;
+        std::vector<char> buffer_;
+        size_t pos_ = 0;
+    };
+
+    bool writeAll(int fd, const std::string &data)
+    {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // True if a daemon accepts connections on the socket at addr
+    bool socketInUse(const sockaddr_un &addr)
+    {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return false;
+        bool inUse = ::connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == 0;
+        ::close(fd);
+        return inUse;
+    }
+}
+
+std::string serverErrorLine(const std::string &message)
+{
+    std::string line = "{\"error\":";
+    appendJsonString(line, message);
+    line += "}\n";
+    return line;
+}
+
+std::string serverRecordLine(const ImageRecord &record)
+{
+    std::string line;
+    appendRecord(record, ResultsFormat::Jsonl, line);
+    return line;
+}
+
+DetectionServer::DetectionServer(const Detector &detector, const ServerOptions &options)
+    : detector_(detector), options_(options)
+{
+}
+
+bool DetectionServer::run()
+{
+    started_ = Clock::now();
+
+    int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0)
+    {
+        std::cerr << "Failed to create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (options_.socketPath.size() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "Socket path too long: " << options_.socketPath << std::endl;
+        ::close(listenFd);
+        return false;
+    }
+    std::strncpy(addr.sun_path, options_.socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    // Remove only the stale socket of a previous run: never a live daemon's socket
+    // or a file that is not a socket
+    struct stat st;
+    if (::lstat(options_.socketPath.c_str(), &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+        {
+            std::cerr << "Not a socket, refusing to replace: " << options_.socketPath << std::endl;
+            ::close(listenFd);
+            return false;
+        }
+        if (socketInUse(addr))
+        {
+            std::cerr << "Another daemon is serving on " << options_.socketPath << std::endl;
+            ::close(listenFd);
+            return false;
+        }
+        ::unlink(options_.socketPath.c_str());
+    }
+
+    // The socket file is created owner-only, then given the configured mode, so other
+    // local users cannot have the daemon open files on their behalf
+    mode_t oldMask = ::umask(0177);
+    bool bound = ::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+    ::umask(oldMask);
+    if (!bound || ::chmod(options_.socketPath.c_str(), options_.socketMode) < 0 || ::listen(listenFd, 64) < 0)
+    {
+        std::cerr << "Failed to listen on " << options_.socketPath << ": " << std::strerror(errno) << std::endl;
+        ::close(listenFd);
+        return false;
+    }
+
+    std::thread batcher([this]
+                        { batchLoop(); });
+
+    // Accept until stop() is requested; poll so the flag is checked regularly
+    while (!stopping_)
+    {
+        pollfd pfd{listenFd, POLLIN, 0};
+        int ready = ::poll(&pfd, 1, 200);
+        if (ready <= 0 || !(pfd.revents & POLLIN))
+            continue;
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+
+        // Join the threads of closed connections before starting a new one
+        for (auto it = connectionThreads_.begin(); it != connectionThreads_.end();)
+        {
+            if (*it->done)
+            {
+                it->thread.join();
+                it = connectionThreads_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        {
+            std::lock_guard<std::mutex> lock(connMutex_);
+            connections_.insert(fd);
+        }
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            ++openConnections_;
+        }
+        connectionThreads_.push_back({std::thread([this, fd, done]
+                                                  {
+                                                      serveConnection(fd);
+                                                      *done = true;
+                                                  }),
+                                      done});
+    }
+
+    ::close(listenFd);
+    ::unlink(options_.socketPath.c_str());
+
+    // Unblock the connection readers, then let the batcher drain
+    {
+        std::lock_guard<std::mutex> lock(connMutex_);
+        for (int fd : connections_)
+            ::shutdown(fd, SHUT_RDWR);
+    }
+    for (auto &c : connectionThreads_)
+        c.thread.join();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        queueStop_ = true;
+    }
+    queueWake_.notify_all();
+    batcher.join();
+    return true;
+}
+
+void DetectionServer::serveConnection(int fd)
+{
+    SocketReader reader(fd);
+    std::string line;
+    while (!stopping_ && reader.readLine(line))
+    {
+        std::string response;
+        if (line == "HEALTH")
+        {
+            response = health();
+        }
+        else if (line == "STATS")
+        {
+            response = stats();
+        }
+        else if (line.rfind("DETECT ", 0) == 0 || line.rfind("DETECT_BYTES ", 0) == 0)
+        {
+            Request request;
+            request.received = Clock::now();
+            if (line.rfind("DETECT ", 0) == 0)
+            {
+                request.path = line.substr(7);
+            }
+            else
+            {
+                size_t n = 0;
+                try
+                {
+                    n = std::stoul(line.substr(13));
+                }
+                catch (const std::exception &)
+                {
+                    n = 0;
+                }
+                if (n == 0 || n > kMaxImageBytes)
+                {
+                    writeAll(fd, serverErrorLine("invalid byte count"));
+                    break; // the payload cannot be skipped reliably
+                }
+                if (!reader.readBytes(n, request.bytes))
+                    break;
+            }
+
+            std::future<std::string> result = request.response.get_future();
+            {
+                std::lock_guard<std::mutex> lock(queueMutex_);
+                queue_.push_back(&request);
+            }
+            queueWake_.notify_one();
+            response = result.get();
+        }
+        else
+        {
+            response = serverErrorLine("unknown command");
+        }
+        if (!writeAll(fd, response))
+            break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(connMutex_);
+        connections_.erase(fd);
+        ::close(fd);
+    }
+
+    // The batcher may be waiting for a request from this connection
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        --openConnections_;
+    }
+    queueWake_.notify_one();
+}
+
+void DetectionServer::batchLoop()
+{
+    std::vector<Request *> batch;
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    for (;;)
+    {
+        queueWake_.wait(lock, [this]
+                        { return queueStop_ || !queue_.empty(); });
+        if (queue_.empty() && queueStop_)
+            break;
+
+        // Give requests that arrive together a short window to join the batch; none
+        // can join once every open connection has its request queued
+        auto window = std::chrono::duration<double, std::milli>(options_.batchWindowMs);
+        queueWake_.wait_for(lock, window, [this]
+                            { return queueStop_ || queue_.size() >= options_.maxBatch || queue_.size() >= openConnections_; });
+
+        size_t take = std::min(queue_.size(), std::max<size_t>(1, options_.maxBatch));
+        batch.assign(queue_.begin(), queue_.begin() + take);
+        queue_.erase(queue_.begin(), queue_.begin() + take);
+        lock.unlock();
+
+        // Decode in parallel, then detect the whole batch at once. A throw must not
+        // escape: it would terminate the daemon with clients waiting on their answers.
+        std::vector<cv::Mat> images(batch.size());
+        std::vector<double> decodeMs(batch.size());
+        std::vector<ImageDetections> detections;
+        try
+        {
+            detector_.pool().parallelFor(0, batch.size(), [&](size_t i)
+                                         {
+                                             auto start = Clock::now();
+                                             try
+                                             {
+                                                 images[i] = decode(*batch[i]);
+                                             }
+                                             catch (const std::exception &)
+                                             {
+                                                 images[i].release(); // reported as unreadable
+                                             }
+                                             decodeMs[i] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+                                         });
+            detections = detector_.detectBatch(images);
+        }
+        catch (const std::exception &e)
+        {
+            detections.assign(batch.size(), ImageDetections());
+            for (auto &d : detections)
+                d.error = std::string("detection failed: ") + e.what();
+        }
+
+        size_t failed = 0;
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            if (images[i].empty())
+                detections[i].error = "failed to read image";
+            ImageRecord record = makeImageRecord(batch[i]->path.empty() ? "<bytes>" : batch[i]->path, detections[i]);
+            record.timings.decodeMs = decodeMs[i];
+            std::string line = serverRecordLine(record);
+            if (!record.error.empty())
+                ++failed;
+            recordLatency(std::chrono::duration<double, std::milli>(Clock::now() - batch[i]->received).count());
+            batch[i]->response.set_value(std::move(line));
+        }
+        {
+            std::lock_guard<std::mutex> statsLock(statsMutex_);
+            errors_ += failed;
+            ++batches_;
+            batchedRequests_ += batch.size();
+        }
+
+        lock.lock();
+    }
+}
+
+cv::Mat DetectionServer::decode(const Request &request) const
+{
+    if (request.path.empty())
+        return cv::imdecode(request.bytes, cv::IMREAD_GRAYSCALE);
+    return readImage(request.path, cv::IMREAD_GRAYSCALE);
+}
+
+std::string DetectionServer::health() const
+{
+    size_t views = 0;
+    for (const auto &object : detector_.objects())
+        views += object.views.size();
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "{\"status\":\"ok\",\"objects\":%zu,\"views\":%zu,\"uptime_s\":%.1f}\n",
+                  detector_.objects().size(), views, std::chrono::duration<double>(Clock::now() - started_).count());
+    return buf;
+}
+
+std::string DetectionServer::stats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    std::vector<double> sorted = latencies_;
+    std::sort(sorted.begin(), sorted.end());
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+                  "{\"requests\":%zu,\"errors\":%zu,\"batches\":%zu,\"mean_batch\":%.2f,"
+                  "\"latency_ms\":{\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f},\"window\":%zu}\n",
+                  requests_, errors_, batches_, batches_ ? static_cast<double>(batchedRequests_) / batches_ : 0.0,
+                  percentile(sorted, 0.5), percentile(sorted, 0.9), percentile(sorted, 0.99),
+                  latencies_.size());
+    return buf;
+}
+
+void DetectionServer::recordLatency(double ms)
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    ++requests_;
+    if (latencies_.size() < kLatencyWindow)
+        latencies_.push_back(ms);
+    else
+        latencies_[latencyNext_] = ms;
+    latencyNext_ = (latencyNext_ + 1) % kLatencyWindow;
+}
@@ -0,0 +1,110 @@
+#ifndef DETECTION_SERVER_HPP
+#define DETECTION_SERVER_HPP
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+#include "detector.hpp"
+#include "results_writer.hpp"
+
+// Settings of the detection daemon
+struct ServerOptions
+{
+    std::string socketPath = "/tmp/object-detect.sock";
+    mode_t socketMode = 0600;   // permissions of the socket file (owner only by default)
+    size_t maxBatch = 8;        // requests processed together at most
+    double batchWindowMs = 2.0; // longest time a request waits for others to join its batch
+};
+
+// Answer lines of the protocol: one JSON object and a newline, with every string
+// escaped, so a client can always split the answers at newlines
+std::string serverErrorLine(const std::string &message);
+std::string serverRecordLine(const ImageRecord &record);
+
+// Long-running detection service on a Unix domain socket around a Detector, whose
+// object models are loaded once; every request searches one image for all objects.
+//
+// Protocol: newline-terminated commands, each answered with one JSON line.
+//   DETECT <path>        detect in an image file
+//   DETECT_BYTES <n>     detect in the n bytes of an encoded image that follow
+//   HEALTH               status, objects and views loaded, uptime
+//   STATS                request counts, batch sizes and latency percentiles
+// Queued requests are batched and run with Detector::detectBatch. A request waits at
+// most batchWindowMs for others to join, and not at all once every open connection
+// has its request queued, since no other request can arrive then.
+class DetectionServer
+{
+public:
+    DetectionServer(const Detector &detector, const ServerOptions &options);
+
+    DetectionServer(const DetectionServer &) = delete;
+    DetectionServer &operator=(const DetectionServer &) = delete;
+
+    // Serve until stop() is called; returns false if the socket cannot be created or
+    // another daemon is already serving on its path
+    bool run();
+
+    // Request shutdown; async-signal-safe
+    void stop() { stopping_ = true; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Request
+    {
+        std::string path;         // image file, or empty for bytes
+        std::vector<uchar> bytes; // encoded image
+        Clock::time_point received;
+        std::promise<std::string> response;
+    };
+
+    void serveConnection(int fd);
+    void batchLoop();
+    cv::Mat decode(const Request &request) const;
+    std::string health() const;
+    std::string stats() const;
+    void recordLatency(double ms);
+
+    const Detector &detector_;
+    ServerOptions options_;
+    Clock::time_point started_;
+    std::atomic<bool> stopping_{false};
+
+    // Pending requests of the batcher
+    std::mutex queueMutex_;
+    std::condition_variable queueWake_;
+    std::deque<Request *> queue_;
+    bool queueStop_ = false;
+    size_t openConnections_ = 0; // each has at most one request queued; guarded by queueMutex_
+
+    // Open connections, shut down on stop; finished threads are joined on the next accept
+    struct Connection
+    {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+    std::mutex connMutex_;
+    std::set<int> connections_;
+    std::vector<Connection> connectionThreads_;
+
+    // Statistics
+    mutable std::mutex statsMutex_;
+    size_t requests_ = 0;
+    size_t errors_ = 0;
+    size_t batches_ = 0;
+    size_t batchedRequests_ = 0;
+    std::vector<double> latencies_; // ring of recent request latencies [ms]
+    size_t latencyNext_ = 0;
+};
+
+#endif // DETECTION_SERVER_HPP
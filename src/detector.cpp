@@ -0,0 +1,328 @@
+#include "detector.hpp"
+#include <chrono>
+#include <map>
+#include "descriptor_format.hpp"
+#include "detector_stages.hpp"
+#include "feature_cache.hpp"
+#include "trace.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Measures the wall time of the enclosing scope into a StageTimings field
+    class StageTimer
+    {
+    public:
+        explicit StageTimer(double &ms) : ms_(ms), start_(Clock::now()) {}
+        ~StageTimer() { ms_ += std::chrono::duration<double, std::milli>(Clock::now() - start_).count(); }
+
+    private:
+        double &ms_;
+        Clock::time_point start_;
+    };
+}
+
+Detector::Detector(const DetectorConfig &config)
+    : config_(config), extractor_(config.sift), pool_(new ThreadPool(config.threads))
+{
+}
+
+std::unique_ptr<Detector> Detector::create(const DetectorConfig &config, std::string *error)
+{
+    std::unique_ptr<Detector> detector(new Detector(config));
+
+    const IDataLoader &loader = detector->loader();
+    FeatureCache cache(config.cachePath);
+    std::vector<std::string> keys = loader.listObjectKeys(config.dataPath);
+    if (keys.empty())
+    {
+        if (error)
+            *error = "no objects in " + config.dataPath.string();
+        return nullptr;
+    }
+    detector->objects_.reserve(keys.size()); // targets point into the vector
+    for (const auto &key : keys)
+    {
+        detector->objects_.push_back(loadObjectModel(loader, config.dataPath, key, config.objectParams(key),
+                                                     detector->extractor_, cache, config.gallery));
+    }
+    for (const auto &object : detector->objects_)
+        detector->allTargets_.push_back(&object);
+
+    if (config.vocab && !detector->prepareVocabulary(error))
+        return nullptr;
+    return detector;
+}
+
+const ObjectModel *Detector::object(const std::string &key) const
+{
+    for (const auto &object : objects_)
+        if (object.key == key)
+            return &object;
+    return nullptr;
+}
+
+// Load the vocabulary tree of the model views, training and saving it first if it is
+// missing, was requested, or was trained on other objects or views. The tree is trained
+// on the gallery rows, so each descriptor format has its own tree file.
+bool Detector::prepareVocabulary(std::string *error)
+{
+    const std::filesystem::path treePath =
+        config_.cachePath / (std::string("vocab.") + descriptorFormatName(config_.gallery.format) + ".tree");
+    std::map<std::pair<std::string, std::string>, std::pair<const ObjectModel *, int>> views;
+    for (const auto &object : objects_)
+        for (size_t v = 0; v < object.views.size(); ++v)
+            views[{object.key, object.views[v].name}] = {&object, static_cast<int>(v)};
+
+    // Resolve the documents of a loaded tree; fails if the views have changed
+    auto resolve = [&]()
+    {
+        vocabDocs_.clear();
+        if (vocab_.documentCount() != views.size())
+            return false;
+        for (size_t d = 0; d < vocab_.documentCount(); ++d)
+        {
+            auto it = views.find({vocab_.document(d).objectKey, vocab_.document(d).viewName});
+            if (it == views.end())
+                return false;
+            vocabDocs_.push_back(it->second);
+        }
+        return true;
+    };
+
+    if (!config_.vocabTrain && vocab_.load(treePath) && resolve())
+        return true;
+
+    std::vector<VocabDocument> docs;
+    std::vector<cv::Mat> descriptors;
+    for (const auto &object : objects_)
+    {
+        for (const auto &view : object.views)
+        {
+            docs.push_back({object.key, view.name});
+            descriptors.push_back(view.descriptors);
+        }
+    }
+    auto start = Clock::now();
+    if (!VocabularyTree::build(docs, descriptors, VocabTreeParams(), treePath) || !vocab_.load(treePath) || !resolve())
+    {
+        if (error)
+            *error = "failed to build vocabulary tree " + treePath.string();
+        return false;
+    }
+    vocabTrainSeconds_ = std::chrono::duration<double>(Clock::now() - start).count();
+    return true;
+}
+
+DetectionJob DetectorStages::makeJob(const std::vector<const ObjectModel *> &targets, bool scene) const
+{
+    DetectionJob job;
+    job.targets = targets;
+    job.scene = scene;
+    return job;
+}
+
+void DetectorStages::decode(DetectionJob &job, const std::filesystem::path &path) const
+{
+    if (job.failed())
+        return;
+    TRACE_SCOPE("decode");
+    StageTimer timer(job.output.timings.decodeMs);
+    job.source = path;
+    job.image = detector_.loader().loadTestImage(TestImage{path, path.filename().string()}, detector_.decodeScale());
+    if (job.image.empty())
+        job.output.error = "failed to read image";
+}
+
+void DetectorStages::preprocess(DetectionJob &job, const cv::Mat &image) const
+{
+    if (job.failed())
+        return;
+    {
+        TRACE_SCOPE("preprocess");
+        StageTimer timer(job.output.timings.preprocessMs);
+        cv::Mat gray;
+        if (image.channels() == 1)
+            gray = image;
+        else
+            cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+        if (detector_.config_.coarseToFine.enabled)
+        {
+            // Keep the full-resolution image for the refinement in the localize stage
+            job.gray = gray;
+            gray = coarseImage(gray, detector_.config_.coarseToFine.scale);
+        }
+        job.image = gray;
+    }
+    preprocess(job);
+}
+
+void DetectorStages::preprocess(DetectionJob &job) const
+{
+    if (job.failed())
+        return;
+    TRACE_SCOPE("preprocess");
+    StageTimer timer(job.output.timings.preprocessMs);
+    DenoiseMode mode = job.scene ? detector_.config_.sceneDenoise : job.targets[0]->params.denoise;
+    job.coarseSize = job.image.size();
+    job.processed = Preprocessing::reduceNoise(job.image, mode);
+    job.image.release();
+}
+
+void DetectorStages::extractFeatures(DetectionJob &job) const
+{
+    if (job.failed())
+        return;
+    {
+        TRACE_SCOPE("features");
+        StageTimer timer(job.output.timings.featuresMs);
+        job.features = detector_.extractor_.extract(job.processed);
+    }
+    TRACE_COUNTER("keypoints", job.features.keypoints.size());
+    job.output.keypoints = job.features.keypoints.size();
+    job.processed.release();
+    if (job.features.descriptors.empty())
+        job.output.error = "no descriptors";
+}
+
+void DetectorStages::match(DetectionJob &job, ThreadPool *pool) const
+{
+    if (job.failed())
+        return;
+    StageTimer timer(job.output.timings.matchMs);
+    if (!detector_.config_.vocab)
+    {
+        for (const ObjectModel *object : job.targets)
+            job.matches.push_back(matchObject(*object, job.features, pool));
+        return;
+    }
+
+    // Rank the views of all objects at once and match only the candidates. The tree was
+    // trained on the gallery rows, so the test descriptors are converted the same way.
+    std::vector<VocabCandidate> candidates;
+    {
+        TRACE_SCOPE("vocab_query");
+        cv::Mat query = DescriptorQuantizer::convert(job.features.descriptors, detector_.config_.gallery.format);
+        candidates = detector_.vocab_.query(query, detector_.config_.vocabCandidates);
+    }
+    for (const ObjectModel *object : job.targets)
+    {
+        std::vector<int> views;
+        for (const auto &c : candidates)
+            if (detector_.vocabDocs_[c.doc].first == object)
+                views.push_back(detector_.vocabDocs_[c.doc].second);
+        if (views.empty() && job.scene)
+        {
+            // No candidate view: the object is not searched in this scene
+            job.matches.emplace_back();
+            continue;
+        }
+        // A single target is known to be searched for, so fall back to all views
+        job.matches.push_back(matchObject(*object, object->params, job.features, pool,
+                                          views.empty() ? nullptr : &views));
+    }
+}
+
+void DetectorStages::localize(DetectionJob &job, ThreadPool *pool) const
+{
+    if (job.failed())
+        return;
+    StageTimer timer(job.output.timings.localizeMs);
+    for (size_t t = 0; t < job.targets.size(); ++t)
+    {
+        const ObjectModel &object = *job.targets[t];
+        DetectionResult result = localizeObject(object, job.features, job.matches[t], job.coarseSize);
+        if (detector_.config_.coarseToFine.enabled)
+        {
+            if (result.detected && job.gray.empty() && !job.source.empty())
+            {
+                // Files are decoded at the coarse scale; the full resolution only for refinement.
+                // The decode is reported as such, not as localization.
+                double before = job.output.timings.decodeMs;
+                {
+                    StageTimer decodeTimer(job.output.timings.decodeMs);
+                    job.gray = detector_.loader().loadTestImage(TestImage{job.source, job.source.filename().string()});
+                }
+                job.output.timings.localizeMs -= job.output.timings.decodeMs - before;
+            }
+            result = refineDetection(object, object.params, detector_.extractor_, job.gray, result,
+                                     detector_.config_.coarseToFine, pool);
+        }
+        job.output.objects.push_back(std::move(result));
+    }
+    job.matches.clear();
+    job.gray.release();
+}
+
+ImageDetections Detector::run(DetectionJob &job, const cv::Mat &image, ThreadPool *pool) const
+{
+    if (image.empty())
+    {
+        job.output.error = "empty image";
+        return std::move(job.output);
+    }
+    DetectorStages stages(*this);
+    stages.preprocess(job, image);
+    stages.extractFeatures(job);
+    stages.match(job, pool);
+    stages.localize(job, pool);
+    return std::move(job.output);
+}
+
+ImageDetections Detector::detect(const cv::Mat &image) const
+{
+    DetectionJob job = DetectorStages(*this).makeJob(allTargets_, true);
+    return run(job, image, pool_.get());
+}
+
+ImageDetections Detector::detect(const std::filesystem::path &path) const
+{
+    DetectorStages stages(*this);
+    DetectionJob job = stages.makeJob(allTargets_, true);
+    stages.decode(job, path);
+    stages.preprocess(job);
+    stages.extractFeatures(job);
+    stages.match(job, pool_.get());
+    stages.localize(job, pool_.get());
+    return std::move(job.output);
+}
+
+ImageDetections Detector::detect(const cv::Mat &image, const std::string &objectKey) const
+{
+    const ObjectModel *target = object(objectKey);
+    if (!target)
+    {
+        ImageDetections output;
+        output.error = "unknown object " + objectKey;
+        return output;
+    }
+    DetectionJob job = DetectorStages(*this).makeJob({target}, false);
+    return run(job, image, pool_.get());
+}
+
+std::vector<ImageDetections> Detector::detectBatch(const cv::Mat *images, size_t count) const
+{
+    // One image per pool thread; the views of each image are verified serially.
+    // An image that throws (e.g. OpenCV on degenerate input) fails on its own.
+    std::vector<ImageDetections> outputs(count);
+    pool_->parallelFor(0, count, [&](size_t i)
+                       {
+                           try
+                           {
+                               DetectionJob job = DetectorStages(*this).makeJob(allTargets_, true);
+                               outputs[i] = run(job, images[i], nullptr);
+                           }
+                           catch (const std::exception &e)
+                           {
+                               outputs[i] = ImageDetections();
+                               outputs[i].error = e.what();
+                           }
+                       });
+    return outputs;
+}
+
+std::vector<ImageDetections> Detector::detectBatch(const std::vector<cv::Mat> &images) const
+{
+    return detectBatch(images.data(), images.size());
+}
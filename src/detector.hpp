@@ -0,0 +1,111 @@
+#ifndef DETECTOR_HPP
+#define DETECTOR_HPP
+
+#include <opencv2/opencv.hpp>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "dataloader.hpp"
+#include "detection.hpp"
+#include "gallery_index.hpp"
+#include "pipeline.hpp"
+#include "stage_timings.hpp"
+#include "thread_pool.hpp"
+#include "vocab_tree.hpp"
+
+// Everything a Detector is built from
+struct DetectorConfig
+{
+    std::filesystem::path dataPath = "../data/object_detection_dataset/"; // object models
+    std::filesystem::path cachePath = "../data/cache/";                   // feature cache and vocabulary tree
+    const IDataLoader *loader = nullptr; // reads models and test images (nullptr = files); must outlive the detector
+    SiftParams sift;
+    GalleryParams gallery;
+    std::function<DetectionParams(const std::string &)> objectParams = getObjectParams; // per-object parameters
+    DenoiseMode sceneDenoise = DenoiseMode::Bilateral; // preprocessing when searching for every object
+    CoarseToFineParams coarseToFine;
+    bool vocab = false;          // preselect views with the vocabulary tree
+    bool vocabTrain = false;     // retrain the tree even if a matching one exists
+    size_t vocabCandidates = 10; // views returned by the tree per image
+    size_t threads = 0;          // pool threads (0 = all hardware threads)
+};
+
+// Detections of one image
+struct ImageDetections
+{
+    std::vector<DetectionResult> objects; // one per searched object
+    size_t keypoints = 0;
+    StageTimings timings; // decode (files only) to localize; encode is left to the caller
+    std::string error;    // empty unless the image could not be processed
+};
+
+struct DetectionJob; // state of one image between the stages (detector_stages.hpp)
+
+// Reentrant object detector. Built once from the object models of a dataset and a
+// configuration. create() reads the dataset through the loader and reads and writes
+// the feature and vocabulary caches in config.cachePath. After that, detect(path)
+// reads only the image file it is given, and detect() and detectBatch() on decoded
+// images do no file I/O. All of them may be called from any number of threads at once.
+class Detector
+{
+public:
+    // Load (or extract and cache) and index the models of every object in config.dataPath,
+    // and load (or train and save) the vocabulary tree if config.vocab is set.
+    // Returns nullptr and sets error if the detector cannot be built.
+    static std::unique_ptr<Detector> create(const DetectorConfig &config, std::string *error = nullptr);
+
+    Detector(const Detector &) = delete;
+    Detector &operator=(const Detector &) = delete;
+
+    const DetectorConfig &config() const { return config_; }
+    const std::vector<ObjectModel> &objects() const { return objects_; }
+    const ObjectModel *object(const std::string &key) const;
+    const FeatureExtractor &extractor() const { return extractor_; }
+    const IDataLoader &loader() const { return config_.loader ? *config_.loader : files_; }
+
+    // Scale at which decode() reads test images (the coarse scale in coarse-to-fine mode)
+    double decodeScale() const { return config_.coarseToFine.enabled ? config_.coarseToFine.scale : 1.0; }
+    ThreadPool &pool() const { return *pool_; }
+
+    // Vocabulary tree (nullptr unless config.vocab) and its training time (0 if it was loaded)
+    const VocabularyTree *vocabulary() const { return config_.vocab ? &vocab_ : nullptr; }
+    double vocabTrainSeconds() const { return vocabTrainSeconds_; }
+
+    // Search a BGR or grayscale image for every object
+    ImageDetections detect(const cv::Mat &image) const;
+
+    // Search an image file for every object. The file is decoded straight to grayscale,
+    // at the coarse scale in coarse-to-fine mode.
+    ImageDetections detect(const std::filesystem::path &path) const;
+
+    // Search a BGR or grayscale image for one object
+    ImageDetections detect(const cv::Mat &image, const std::string &objectKey) const;
+
+    // Search a batch of images for every object; images run in parallel on the pool.
+    // Never throws for one image: an exception is reported in its error.
+    std::vector<ImageDetections> detectBatch(const cv::Mat *images, size_t count) const;
+    std::vector<ImageDetections> detectBatch(const std::vector<cv::Mat> &images) const;
+
+private:
+    friend class DetectorStages; // detect() split into stages (detector_stages.hpp)
+
+    explicit Detector(const DetectorConfig &config);
+
+    bool prepareVocabulary(std::string *error);
+    ImageDetections run(DetectionJob &job, const cv::Mat &image, ThreadPool *pool) const;
+
+    DetectorConfig config_;
+    FileSystemDataLoader files_;
+    FeatureExtractor extractor_;
+    std::unique_ptr<ThreadPool> pool_;
+    std::vector<ObjectModel> objects_;
+    std::vector<const ObjectModel *> allTargets_;
+    VocabularyTree vocab_;
+    std::vector<std::pair<const ObjectModel *, int>> vocabDocs_; // (object, view index) per document
+    double vocabTrainSeconds_ = 0.0;
+};
+
+#endif // DETECTOR_HPP
@@ -0,0 +1,51 @@
+#ifndef DETECTOR_STAGES_HPP
+#define DETECTOR_STAGES_HPP
+
+#include <opencv2/opencv.hpp>
+#include <filesystem>
+#include <vector>
+#include "detection.hpp"
+#include "detector.hpp"
+#include "pipeline.hpp"
+#include "thread_pool.hpp"
+
+// Intermediate state of one image between the detection stages
+struct DetectionJob
+{
+    std::vector<const ObjectModel *> targets; // objects to search for
+    bool scene = false;   // search for several objects (scene denoise mode, vocabulary tree may skip objects)
+    std::filesystem::path source; // file the image was decoded from (decode() only)
+    cv::Mat image;        // grayscale at the feature scale, until preprocessed
+    cv::Mat gray;         // full-resolution grayscale (coarse-to-fine only; decoded on demand for files)
+    cv::Size coarseSize;  // size of the image the features were extracted from
+    cv::Mat processed;
+    ImageFeatures features;
+    std::vector<ObjectMatches> matches; // one per target
+    ImageDetections output;
+
+    bool failed() const { return !output.error.empty(); }
+};
+
+// The stages of Detector::detect(), for callers that schedule them separately (e.g. on
+// a stage pipeline). Each stage does nothing once the job has failed. pool parallelizes
+// the per-view RANSAC (nullptr = serial). The detector must outlive the stages.
+class DetectorStages
+{
+public:
+    explicit DetectorStages(const Detector &detector) : detector_(detector) {}
+
+    DetectionJob makeJob(const std::vector<const ObjectModel *> &targets, bool scene) const;
+    // Decode an image file straight to grayscale at the feature scale. In coarse-to-fine
+    // mode the full resolution is decoded again only if a coarse detection is refined.
+    void decode(DetectionJob &job, const std::filesystem::path &path) const;
+    void preprocess(DetectionJob &job) const;                         // after decode()
+    void preprocess(DetectionJob &job, const cv::Mat &image) const;   // image in memory
+    void extractFeatures(DetectionJob &job) const;
+    void match(DetectionJob &job, ThreadPool *pool) const;
+    void localize(DetectionJob &job, ThreadPool *pool) const;
+
+private:
+    const Detector &detector_;
+};
+
+#endif // DETECTOR_STAGES_HPP
@@ -0,0 +1,367 @@
+#include "evaluation.hpp"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <sstream>
+#include "object_localizer.hpp"
+
+double boxIoU(const cv::Rect &a, const cv::Rect &b)
+{
+    double inter = (a & b).area();
+    double uni = a.area() + b.area() - inter;
+    return uni > 0 ? inter / uni : 0.0;
+}
+
+bool setDetectionParam(DetectionParams &params, const std::string &name, const std::string &value)
+{
+    try
+    {
+        if (name == "matches")
+            params.matchesThreshold = std::stoi(value);
+        else if (name == "inliers")
+            params.minInliers = std::stoi(value);
+        else if (name == "bandwidth")
+            params.clusterBandwidth = std::stod(value);
+        else if (name == "max-distance")
+            params.maxDistanceFromCenter = std::stod(value);
+        else if (name == "ransac")
+            params.ransacThreshold = std::stod(value);
+        else if (name == "ransac-method")
+            return parseRansacMethod(value, params.ransacMethod);
+        else if (name == "padding")
+            params.boxPadding = std::stod(value);
+        else if (name == "denoise")
+            return parseDenoiseMode(value, params.denoise);
+        else
+            return false;
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    return true;
+}
+
+std::string EvalConfig::label() const
+{
+    if (values.empty())
+        return "defaults";
+    std::string s;
+    for (const auto &v : values)
+        s += (s.empty() ? "" : " ") + v.first + "=" + v.second;
+    return s;
+}
+
+bool ParamGrid::parse(const std::string &spec, ParamGrid &grid, std::string &error)
+{
+    grid.axes_.clear();
+    std::stringstream axes(spec);
+    std::string axis;
+    while (std::getline(axes, axis, ';'))
+    {
+        if (axis.empty())
+            continue;
+        auto eq = axis.find('=');
+        if (eq == std::string::npos)
+        {
+            error = "expected name=v1,v2,... in '" + axis + "'";
+            return false;
+        }
+        std::string name = axis.substr(0, eq);
+        std::vector<std::string> values;
+        std::stringstream list(axis.substr(eq + 1));
+        std::string value;
+        DetectionParams probe = getObjectParams("");
+        while (std::getline(list, value, ','))
+        {
+            if (!setDetectionParam(probe, name, value))
+            {
+                error = "invalid value '" + value + "' for parameter '" + name + "'";
+                return false;
+            }
+            values.push_back(value);
+        }
+        if (values.empty())
+        {
+            error = "no values for parameter '" + name + "'";
+            return false;
+        }
+        grid.axes_.emplace_back(name, values);
+    }
+    return true;
+}
+
+std::vector<EvalConfig> ParamGrid::configs() const
+{
+    std::vector<EvalConfig> configs(1);
+    for (const auto &axis : axes_)
+    {
+        std::vector<EvalConfig> expanded;
+        for (const auto &config : configs)
+        {
+            for (const auto &value : axis.second)
+            {
+                EvalConfig c = config;
+                c.values.emplace_back(axis.first, value);
+                expanded.push_back(std::move(c));
+            }
+        }
+        configs = std::move(expanded);
+    }
+    return configs;
+}
+
+double ObjectScore::precision() const
+{
+    size_t detected = truePositives + falsePositives;
+    return detected ? static_cast<double>(truePositives) / detected : 0.0;
+}
+
+double ObjectScore::recall() const
+{
+    size_t present = truePositives + falseNegatives;
+    return present ? static_cast<double>(truePositives) / present : 0.0;
+}
+
+double ObjectScore::f1() const
+{
+    double p = precision(), r = recall();
+    return p + r > 0.0 ? 2.0 * p * r / (p + r) : 0.0;
+}
+
+double ObjectScore::meanIoU() const
+{
+    return truePositives ? iouSum / truePositives : 0.0;
+}
+
+void ObjectScore::add(const ObjectScore &other)
+{
+    truePositives += other.truePositives;
+    falsePositives += other.falsePositives;
+    falseNegatives += other.falseNegatives;
+    iouSum += other.iouSum;
+    evaluated += other.evaluated;
+}
+
+std::vector<size_t> paretoFront(const std::vector<ConfigScore> &scores)
+{
+    std::vector<size_t> order(scores.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    // Fastest first; among equally fast, most accurate first
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+              {
+                  if (scores[a].latencyMs() != scores[b].latencyMs())
+                      return scores[a].latencyMs() < scores[b].latencyMs();
+                  return scores[a].total.f1() > scores[b].total.f1();
+              });
+
+    // A configuration is on the front if it is more accurate than every faster one
+    std::vector<size_t> front;
+    double bestF1 = -1.0;
+    for (size_t i : order)
+    {
+        if (scores[i].total.f1() > bestF1)
+        {
+            front.push_back(i);
+            bestF1 = scores[i].total.f1();
+        }
+    }
+    return front;
+}
+
+Evaluator::Evaluator(const IDataLoader &loader,
+                     const std::filesystem::path &root,
+                     const FeatureExtractor &extractor,
+                     const std::filesystem::path &cacheDir,
+                     const GalleryParams &galleryParams,
+                     ThreadPool &pool)
+    : loader_(loader), root_(root), extractor_(extractor), cacheDir_(cacheDir),
+      galleryParams_(galleryParams), pool_(pool)
+{
+}
+
+DetectionParams Evaluator::configParams(size_t object, const EvalConfig &config) const
+{
+    DetectionParams params = baseParams_(keys_[object]);
+    for (const auto &v : config.values)
+        setDetectionParam(params, v.first, v.second);
+    return params;
+}
+
+std::vector<ConfigScore> Evaluator::run(const std::vector<EvalConfig> &configs)
+{
+    using Clock = std::chrono::steady_clock;
+    keys_ = loader_.listObjectKeys(root_);
+
+    // Labelled test images, decoded once
+    std::vector<Sample> samples;
+    for (size_t o = 0; o < keys_.size(); ++o)
+    {
+        for (const auto &ti : loader_.listTestImages(root_, keys_[o]))
+        {
+            Sample s;
+            s.object = o;
+            s.image = ti;
+            s.labels = loader_.loadLabels(root_, keys_[o], ti);
+            if (!s.labels.empty())
+                samples.push_back(std::move(s));
+        }
+    }
+    pool_.parallelFor(0, samples.size(), [&](size_t i)
+                      { samples[i].gray = loader_.loadTestImage(samples[i].image); });
+
+    // Object models per (object, denoise mode) and test features per (mode, sample)
+    std::map<std::pair<size_t, DenoiseMode>, ObjectModel> models;
+    std::map<DenoiseMode, std::vector<ImageFeatures>> features;
+    auto extractFeatures = [&](size_t i, DenoiseMode mode)
+    {
+        cv::Mat gray = samples[i].gray;
+        if (coarseToFine_.enabled)
+            gray = coarseImage(gray, coarseToFine_.scale);
+        return extractTestFeatures(extractor_, gray, mode);
+    };
+    for (const auto &config : configs)
+    {
+        for (size_t o = 0; o < keys_.size(); ++o)
+        {
+            DetectionParams params = configParams(o, config);
+            auto key = std::make_pair(o, params.denoise);
+            if (models.count(key))
+                continue;
+            // One cache directory per mode, so the modes do not evict each other
+            FeatureCache cache(cacheDir_ / denoiseModeName(params.denoise));
+            models.emplace(key, loadObjectModel(loader_, root_, keys_[o], params, extractor_, cache, galleryParams_));
+        }
+        for (size_t o = 0; o < keys_.size(); ++o)
+        {
+            DenoiseMode mode = configParams(o, config).denoise;
+            if (features.count(mode))
+                continue;
+            auto &f = features[mode];
+            f.resize(samples.size());
+            pool_.parallelFor(0, samples.size(), [&](size_t i)
+                              {
+                                  if (!samples[i].gray.empty())
+                                      f[i] = extractFeatures(i, mode);
+                              });
+        }
+    }
+
+    // Detect the objects of one configuration in one sample; scored into objects if given
+    auto detectSample = [&](const std::vector<DetectionParams> &params, size_t i, std::vector<ObjectScore> *objects)
+    {
+        const Sample &sample = samples[i];
+        for (size_t t = 0; t < keys_.size(); ++t)
+        {
+            if (!sceneMode_ && t != sample.object)
+                continue;
+            // Each target is searched with the features of its own denoise mode
+            const ImageFeatures &f = features.at(params[t].denoise)[i];
+            const ObjectModel &model = models.at({t, params[t].denoise});
+            DetectionResult result;
+            if (!f.descriptors.empty())
+            {
+                ObjectMatches matches = matchObject(model, params[t], f);
+                cv::Size size = sample.gray.size();
+                if (coarseToFine_.enabled)
+                    size = cv::Size(cvRound(size.width * coarseToFine_.scale),
+                                    cvRound(size.height * coarseToFine_.scale));
+                result = localizeObject(model, params[t], f, matches, size);
+                if (coarseToFine_.enabled)
+                    result = refineDetection(model, params[t], extractor_, sample.gray, result, coarseToFine_);
+            }
+            if (!objects)
+                continue;
+
+            // Score against the ground truth of this object
+            ObjectScore &s = (*objects)[t];
+            ++s.evaluated;
+            auto gt = std::find_if(sample.labels.begin(), sample.labels.end(),
+                                   [&](const GroundTruthBox &b)
+                                   { return b.objectKey == keys_[t]; });
+            bool present = gt != sample.labels.end();
+            if (result.detected && present)
+            {
+                double iou = boxIoU(result.box, gt->box);
+                if (iou >= iouThreshold_)
+                {
+                    ++s.truePositives;
+                    s.iouSum += iou;
+                }
+                else
+                {
+                    ++s.falsePositives;
+                    ++s.falseNegatives;
+                }
+            }
+            else if (result.detected)
+            {
+                ++s.falsePositives;
+            }
+            else if (present)
+            {
+                ++s.falseNegatives;
+            }
+        }
+    };
+
+    std::vector<std::vector<DetectionParams>> configParamsList(configs.size());
+    for (size_t c = 0; c < configs.size(); ++c)
+        for (size_t o = 0; o < keys_.size(); ++o)
+            configParamsList[c].push_back(configParams(o, configs[c]));
+
+    // Accuracy does not depend on timing, so the configurations are scored in parallel
+    std::vector<ConfigScore> scores(configs.size());
+    pool_.parallelFor(0, configs.size(), [&](size_t c)
+                      {
+                          ConfigScore &score = scores[c];
+                          score.config = configs[c];
+                          score.objects.resize(keys_.size());
+                          for (size_t o = 0; o < keys_.size(); ++o)
+                              score.objects[o].objectKey = keys_[o];
+                          for (size_t i = 0; i < samples.size(); ++i)
+                              if (!samples[i].gray.empty())
+                                  detectSample(configParamsList[c], i, &score.objects);
+                          for (const auto &s : score.objects)
+                              score.total.add(s);
+                          score.total.objectKey = "all";
+                      });
+
+    // Latency is timed in isolation: one configuration (or denoise mode) at a time,
+    // images one after another on this thread, with the pool idle. Timed in the
+    // parallel phases it would include contention from whatever else was running.
+    std::map<DenoiseMode, std::vector<double>> featureMs;
+    for (const auto &entry : features)
+    {
+        std::vector<double> &ms = featureMs[entry.first];
+        ms.assign(samples.size(), 0.0);
+        for (size_t i = 0; i < samples.size(); ++i)
+        {
+            if (samples[i].gray.empty())
+                continue;
+            auto start = Clock::now();
+            extractFeatures(i, entry.first);
+            ms[i] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+    }
+    for (size_t c = 0; c < configs.size(); ++c)
+    {
+        const std::vector<DetectionParams> &params = configParamsList[c];
+        double featureTotal = 0.0, detectTotal = 0.0;
+        size_t images = 0;
+        for (size_t i = 0; i < samples.size(); ++i)
+        {
+            if (samples[i].gray.empty())
+                continue;
+            featureTotal += featureMs.at(params[samples[i].object].denoise)[i];
+            ++images;
+            auto start = Clock::now();
+            detectSample(params, i, nullptr);
+            detectTotal += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+        scores[c].featureMs = images ? featureTotal / images : 0.0;
+        scores[c].detectMs = images ? detectTotal / images : 0.0;
+    }
+    return scores;
+}
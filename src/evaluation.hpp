@@ -0,0 +1,133 @@
+#ifndef EVALUATION_HPP
+#define EVALUATION_HPP
+
+#include <opencv2/opencv.hpp>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "dataloader.hpp"
+#include "detection.hpp"
+#include "gallery_index.hpp"
+#include "pipeline.hpp"
+#include "thread_pool.hpp"
+
+// Intersection over union of two boxes
+double boxIoU(const cv::Rect &a, const cv::Rect &b);
+
+// Set one detection parameter by name (matches, inliers, bandwidth, max-distance,
+// ransac, ransac-method, padding, denoise); returns false for an unknown name or value
+bool setDetectionParam(DetectionParams &params, const std::string &name, const std::string &value);
+
+// A point of a parameter grid: parameter names and values applied to every object
+struct EvalConfig
+{
+    std::vector<std::pair<std::string, std::string>> values;
+
+    // "name=value ..." or "defaults"
+    std::string label() const;
+};
+
+// Cartesian product of per-parameter value lists,
+// e.g. "matches=6,8,10;ransac=2,3;denoise=bilateral,guided"
+class ParamGrid
+{
+public:
+    // Parse a grid specification; an empty string gives the single default config
+    static bool parse(const std::string &spec, ParamGrid &grid, std::string &error);
+
+    std::vector<EvalConfig> configs() const;
+
+private:
+    std::vector<std::pair<std::string, std::vector<std::string>>> axes_;
+};
+
+// Detection counts and box quality of one object
+struct ObjectScore
+{
+    std::string objectKey;
+    size_t truePositives = 0;  // detected with IoU >= threshold
+    size_t falsePositives = 0; // detected where the object is absent or the box misses
+    size_t falseNegatives = 0; // present but not (correctly) detected
+    double iouSum = 0.0;       // over true positives
+    size_t evaluated = 0;      // (image, object) pairs scored
+
+    double precision() const;
+    double recall() const;
+    double f1() const;
+    double meanIoU() const;
+    void add(const ObjectScore &other);
+};
+
+// Accuracy and latency of one configuration
+struct ConfigScore
+{
+    EvalConfig config;
+    std::vector<ObjectScore> objects; // one per object key
+    ObjectScore total;
+    double featureMs = 0.0; // mean preprocessing + feature extraction per image (timed alone)
+    double detectMs = 0.0;  // mean matching + localization per image (timed alone)
+
+    double latencyMs() const { return featureMs + detectMs; }
+};
+
+// Indices of the configurations no other configuration beats on both
+// latency and F1, fastest first
+std::vector<size_t> paretoFront(const std::vector<ConfigScore> &scores);
+
+// Scores detections against the labels/ ground truth for a set of configurations.
+// Test features and object models are computed once per denoise mode and shared
+// by all configurations. Accuracy is scored in parallel; latency is timed afterwards
+// with one configuration and one image at a time, so it reflects the configuration
+// and not the scheduling.
+class Evaluator
+{
+public:
+    using ParamsFn = std::function<DetectionParams(const std::string &objectKey)>;
+
+    Evaluator(const IDataLoader &loader,
+              const std::filesystem::path &root,
+              const FeatureExtractor &extractor,
+              const std::filesystem::path &cacheDir,
+              const GalleryParams &galleryParams,
+              ThreadPool &pool);
+
+    // Base parameters of each object before a configuration is applied
+    void setBaseParams(ParamsFn fn) { baseParams_ = std::move(fn); }
+
+    // Search every test image for every object instead of only its own
+    void setSceneMode(bool scene) { sceneMode_ = scene; }
+
+    void setIoUThreshold(double threshold) { iouThreshold_ = threshold; }
+
+    // Extract test features from a downscaled image and refine detections around the box
+    void setCoarseToFine(const CoarseToFineParams &params) { coarseToFine_ = params; }
+
+    std::vector<ConfigScore> run(const std::vector<EvalConfig> &configs);
+
+private:
+    struct Sample
+    {
+        size_t object; // object directory the image is in
+        TestImage image;
+        cv::Mat gray;
+        std::vector<GroundTruthBox> labels;
+    };
+
+    DetectionParams configParams(size_t object, const EvalConfig &config) const;
+
+    const IDataLoader &loader_;
+    std::filesystem::path root_;
+    const FeatureExtractor &extractor_;
+    std::filesystem::path cacheDir_;
+    GalleryParams galleryParams_;
+    ThreadPool &pool_;
+    ParamsFn baseParams_ = getObjectParams;
+    bool sceneMode_ = false;
+    double iouThreshold_ = 0.5;
+    CoarseToFineParams coarseToFine_;
+    std::vector<std::string> keys_;
+};
+
+#endif // EVALUATION_HPP
@@ -0,0 +1,343 @@
+#include "feature_cache.hpp"
+#include "mapped_file.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+namespace
+{
+    const char kMagic[4] = {'O', 'D', 'F', 'C'};
+
+    // Size, mtime and content hash of a single model file
+    struct FileFingerprint
+    {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t contentHash = 0;
+    };
+
+    // On-disk keypoint record (fixed layout)
+    struct KeyPointRecord
+    {
+        float x, y, size, angle, response;
+        int32_t octave, classId;
+    };
+
+    bool statFile(const std::filesystem::path &path, FileFingerprint &fp)
+    {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        if (ec)
+            return false;
+        auto mtime = std::filesystem::last_write_time(path, ec);
+        if (ec)
+            return false;
+        fp.size = static_cast<uint64_t>(size);
+        fp.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+        return true;
+    }
+
+    uint64_t hashFileContent(const std::filesystem::path &path)
+    {
+        MappedFile file(path);
+        if (!file.isOpen())
+            return 0;
+        return fnv1a64(file.data(), file.size());
+    }
+
+    // A file backing a model view
+    struct SourceFile
+    {
+        std::string name; // file name, the key of its fingerprint
+        std::filesystem::path path;
+        uint64_t contentHash; // from an archive (0 = stat and hash the file)
+    };
+
+    // All files backing the model views
+    std::vector<SourceFile> collectFiles(const std::vector<ModelViewFiles> &files)
+    {
+        std::vector<SourceFile> out;
+        out.reserve(files.size() * 2);
+        for (const auto &f : files)
+        {
+            out.push_back({f.colorPath.filename().string(), f.colorPath, f.colorHash});
+            if (f.maskHash || std::filesystem::exists(f.maskPath))
+                out.push_back({f.maskPath.filename().string(), f.maskPath, f.maskHash});
+        }
+        return out;
+    }
+
+    // Bounds-checked cursor over the mapped cache file
+    class Reader
+    {
+    public:
+        Reader(const uint8_t *data, size_t size) : p_(data), end_(data + size) {}
+
+        template <typename T>
+        T read()
+        {
+            T value{};
+            const uint8_t *src = take(sizeof(T));
+            if (src)
+                std::memcpy(&value, src, sizeof(T));
+            return value;
+        }
+
+        std::string readString()
+        {
+            uint32_t len = read<uint32_t>();
+            const uint8_t *src = take(len);
+            return src ? std::string(reinterpret_cast<const char *>(src), len) : std::string();
+        }
+
+        const uint8_t *take(size_t n)
+        {
+            if (!ok_ || static_cast<size_t>(end_ - p_) < n)
+            {
+                ok_ = false;
+                return nullptr;
+            }
+            const uint8_t *src = p_;
+            p_ += n;
+            return src;
+        }
+
+        bool ok() const { return ok_; }
+
+    private:
+        const uint8_t *p_;
+        const uint8_t *end_;
+        bool ok_ = true;
+    };
+
+    template <typename T>
+    void write(std::ofstream &out, const T &value)
+    {
+        out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    void writeString(std::ofstream &out, const std::string &s)
+    {
+        write(out, static_cast<uint32_t>(s.size()));
+        out.write(s.data(), s.size());
+    }
+}
+
+FeatureCache::FeatureCache(const std::filesystem::path &cacheDir)
+    : cacheDir_(cacheDir)
+{
+}
+
+uint64_t FeatureCache::extractorKey(const SiftParams &params, DenoiseMode denoise)
+{
+    uint64_t key = fnv1a64(&kFormatVersion, sizeof(kFormatVersion));
+    key = fnv1a64(&params.nFeatures, sizeof(params.nFeatures), key);
+    key = fnv1a64(&params.nOctaveLayers, sizeof(params.nOctaveLayers), key);
+    key = fnv1a64(&params.contrastThreshold, sizeof(params.contrastThreshold), key);
+    key = fnv1a64(&params.edgeThreshold, sizeof(params.edgeThreshold), key);
+    key = fnv1a64(&params.sigma, sizeof(params.sigma), key);
+    const int32_t mode = static_cast<int32_t>(denoise);
+    key = fnv1a64(&mode, sizeof(mode), key);
+    return key;
+}
+
+std::filesystem::path FeatureCache::cachePath(const std::string &objectKey) const
+{
+    return cacheDir_ / (objectKey + ".feat");
+}
+
+bool FeatureCache::load(const std::string &objectKey,
+                        const std::vector<ModelViewFiles> &files,
+                        uint64_t extractorKey,
+                        std::vector<ViewFeatures> &views) const
+{
+    MappedFile file(cachePath(objectKey));
+    if (!file.isOpen())
+        return false;
+
+    Reader in(file.data(), file.size());
+
+    // Header
+    const uint8_t *magic = in.take(sizeof(kMagic));
+    if (!magic || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0)
+        return false;
+    if (in.read<uint32_t>() != kFormatVersion)
+        return false;
+    if (in.read<uint64_t>() != extractorKey)
+        return false;
+
+    // File fingerprints
+    uint32_t fileCount = in.read<uint32_t>();
+    std::unordered_map<std::string, FileFingerprint> stored;
+    for (uint32_t i = 0; i < fileCount && in.ok(); ++i)
+    {
+        std::string name = in.readString();
+        FileFingerprint fp;
+        fp.size = in.read<uint64_t>();
+        fp.mtime = in.read<int64_t>();
+        fp.contentHash = in.read<uint64_t>();
+        stored[name] = fp;
+    }
+    if (!in.ok())
+        return false;
+
+    auto current = collectFiles(files);
+    if (current.size() != stored.size())
+        return false;
+
+    bool refreshStats = false;
+    for (const auto &file : current)
+    {
+        auto it = stored.find(file.name);
+        if (it == stored.end())
+            return false;
+
+        // Archived views carry the content hash of the file they were packed from
+        if (file.contentHash)
+        {
+            if (file.contentHash != it->second.contentHash)
+                return false;
+            continue;
+        }
+
+        const std::filesystem::path &path = file.path;
+        FileFingerprint fp;
+        if (!statFile(path, fp))
+            return false;
+        if (fp.size == it->second.size && fp.mtime == it->second.mtime)
+            continue;
+
+        // Stat changed (e.g. fresh checkout): fall back to the content hash
+        if (fp.size != it->second.size || hashFileContent(path) != it->second.contentHash)
+            return false;
+        refreshStats = true;
+    }
+
+    // View features
+    uint32_t viewCount = in.read<uint32_t>();
+    std::vector<ViewFeatures> loaded;
+    loaded.reserve(viewCount);
+    for (uint32_t v = 0; v < viewCount && in.ok(); ++v)
+    {
+        ViewFeatures vf;
+        vf.name = in.readString();
+        vf.maskSize.width = in.read<int32_t>();
+        vf.maskSize.height = in.read<int32_t>();
+
+        uint32_t kpCount = in.read<uint32_t>();
+        const uint8_t *kpData = in.take(static_cast<size_t>(kpCount) * sizeof(KeyPointRecord));
+        if (!kpData)
+            return false;
+        vf.keypoints.resize(kpCount);
+        for (uint32_t k = 0; k < kpCount; ++k)
+        {
+            KeyPointRecord r;
+            std::memcpy(&r, kpData + k * sizeof(KeyPointRecord), sizeof(r));
+            vf.keypoints[k] = cv::KeyPoint(cv::Point2f(r.x, r.y), r.size, r.angle, r.response, r.octave, r.classId);
+        }
+
+        int32_t rows = in.read<int32_t>();
+        int32_t cols = in.read<int32_t>();
+        int32_t type = in.read<int32_t>();
+        if (rows > 0 && cols > 0)
+        {
+            cv::Mat desc(rows, cols, type);
+            const uint8_t *descData = in.take(desc.total() * desc.elemSize());
+            if (!descData)
+                return false;
+            std::memcpy(desc.data, descData, desc.total() * desc.elemSize());
+            vf.descriptors = desc;
+        }
+        loaded.push_back(std::move(vf));
+    }
+    if (!in.ok())
+        return false;
+
+    views = std::move(loaded);
+
+    // Record the new stats so the next load skips hashing
+    if (refreshStats)
+        store(objectKey, files, extractorKey, views);
+
+    return true;
+}
+
+bool FeatureCache::store(const std::string &objectKey,
+                         const std::vector<ModelViewFiles> &files,
+                         uint64_t extractorKey,
+                         const std::vector<ViewFeatures> &views) const
+{
+    std::error_code ec;
+    std::filesystem::create_directories(cacheDir_, ec);
+
+    // Write to a temporary file and rename, so readers never see a partial cache
+    std::filesystem::path finalPath = cachePath(objectKey);
+    std::filesystem::path tmpPath = finalPath;
+    tmpPath += ".tmp";
+
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        std::cerr << "Failed to write feature cache: " << tmpPath << std::endl;
+        return false;
+    }
+
+    out.write(kMagic, sizeof(kMagic));
+    write(out, kFormatVersion);
+    write(out, extractorKey);
+
+    auto current = collectFiles(files);
+    write(out, static_cast<uint32_t>(current.size()));
+    for (const auto &file : current)
+    {
+        FileFingerprint fp;
+        if (file.contentHash)
+        {
+            fp.contentHash = file.contentHash;
+        }
+        else
+        {
+            if (!statFile(file.path, fp))
+            {
+                out.close();
+                std::filesystem::remove(tmpPath, ec);
+                return false;
+            }
+            fp.contentHash = hashFileContent(file.path);
+        }
+        writeString(out, file.name);
+        write(out, fp.size);
+        write(out, fp.mtime);
+        write(out, fp.contentHash);
+    }
+
+    write(out, static_cast<uint32_t>(views.size()));
+    for (const auto &vf : views)
+    {
+        writeString(out, vf.name);
+        write(out, static_cast<int32_t>(vf.maskSize.width));
+        write(out, static_cast<int32_t>(vf.maskSize.height));
+
+        write(out, static_cast<uint32_t>(vf.keypoints.size()));
+        for (const auto &kp : vf.keypoints)
+        {
+            KeyPointRecord r{kp.pt.x, kp.pt.y, kp.size, kp.angle, kp.response, kp.octave, kp.class_id};
+            write(out, r);
+        }
+
+        cv::Mat desc = vf.descriptors.isContinuous() ? vf.descriptors : vf.descriptors.clone();
+        write(out, static_cast<int32_t>(desc.rows));
+        write(out, static_cast<int32_t>(desc.cols));
+        write(out, static_cast<int32_t>(desc.type()));
+        if (!desc.empty())
+            out.write(reinterpret_cast<const char *>(desc.data), desc.total() * desc.elemSize());
+    }
+
+    out.close();
+    if (!out)
+        return false;
+
+    std::filesystem::rename(tmpPath, finalPath, ec);
+    return !ec;
+}
@@ -0,0 +1,47 @@
+#ifndef FEATURE_CACHE_HPP
+#define FEATURE_CACHE_HPP
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "dataloader.hpp"
+#include "detection.hpp"
+#include "preprocessing.hpp"
+
+// Persistent on-disk cache of model-view keypoints and descriptors.
+// One binary file per object, validated against the model files it was built
+// from (size + mtime, falling back to a content hash) and the extractor key.
+class FeatureCache
+{
+public:
+    // Bump whenever the file layout changes
+    static constexpr uint32_t kFormatVersion = 2;
+
+    explicit FeatureCache(const std::filesystem::path &cacheDir);
+
+    // Key identifying the feature extraction settings (SIFT parameters and
+    // the denoise mode applied to the model views)
+    static uint64_t extractorKey(const SiftParams &params, DenoiseMode denoise);
+
+    // Load cached features; returns false on a miss or if the cache is stale
+    bool load(const std::string &objectKey,
+              const std::vector<ModelViewFiles> &files,
+              uint64_t extractorKey,
+              std::vector<ViewFeatures> &views) const;
+
+    // Write features for an object, replacing any previous cache file
+    bool store(const std::string &objectKey,
+               const std::vector<ModelViewFiles> &files,
+               uint64_t extractorKey,
+               const std::vector<ViewFeatures> &views) const;
+
+    // Path of the cache file for an object
+    std::filesystem::path cachePath(const std::string &objectKey) const;
+
+private:
+    std::filesystem::path cacheDir_;
+};
+
+#endif // FEATURE_CACHE_HPP
@@ -0,0 +1,224 @@
+#include "gallery_index.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "simd_matcher.hpp"
+#include "trace.hpp"
+
+void GalleryIndex::build(const std::vector<ViewFeatures> &views, const GalleryParams &params)
+{
+    params_ = params;
+    viewCount_ = views.size();
+    descriptorCount_ = 0;
+    viewDescriptors_.clear();
+    searchRows_.release();
+    viewStart_.assign(1, 0);
+    shortlistRows_.release();
+    shortlistRowView_.clear();
+
+    for (const auto &vf : views)
+    {
+        viewDescriptors_.push_back(DescriptorQuantizer::convert(vf.descriptors, params_.format));
+        descriptorCount_ += vf.descriptors.rows;
+    }
+
+    // FLANN answers an image with one search over the rows of all views, stacked here
+    // once; view v owns rows [viewStart_[v], viewStart_[v + 1]). The KD-forest works on
+    // floats, so quantized rows are widened here once (exactly: the byte values and
+    // their distances are unchanged) rather than for every image.
+    if (params_.search == GallerySearch::Flann)
+    {
+        for (const auto &desc : viewDescriptors_)
+        {
+            if (!desc.empty())
+                searchRows_.push_back(desc);
+            viewStart_.push_back(searchRows_.rows);
+        }
+        if (!searchRows_.empty() && searchRows_.type() != CV_32F)
+            searchRows_.convertTo(searchRows_, CV_32F);
+    }
+
+    // Voting rows for the shortlist stage: the strongest keypoints of each view
+    if (shortlistEnabled())
+    {
+        for (size_t v = 0; v < views.size(); ++v)
+        {
+            const cv::Mat &desc = viewDescriptors_[v];
+            const auto &kps = views[v].keypoints;
+            if (desc.empty() || static_cast<int>(kps.size()) != desc.rows)
+                continue;
+
+            std::vector<int> order(desc.rows);
+            std::iota(order.begin(), order.end(), 0);
+            int keep = std::min(params_.shortlistViewRows, desc.rows);
+            std::partial_sort(order.begin(), order.begin() + keep, order.end(),
+                              [&](int a, int b)
+                              { return kps[a].response > kps[b].response; });
+            for (int i = 0; i < keep; ++i)
+            {
+                shortlistRows_.push_back(desc.row(order[i]));
+                shortlistRowView_.push_back(static_cast<int>(v));
+            }
+        }
+    }
+}
+
+size_t GalleryIndex::memoryBytes() const
+{
+    size_t bytes = shortlistRows_.total() * shortlistRows_.elemSize() + searchRows_.total() * searchRows_.elemSize();
+    for (const auto &desc : viewDescriptors_)
+        bytes += desc.total() * desc.elemSize();
+    return bytes;
+}
+
+bool GalleryIndex::shortlistEnabled() const
+{
+    return params_.shortlistK > 0 && static_cast<size_t>(params_.shortlistK) < viewCount_;
+}
+
+std::vector<ViewScore> GalleryIndex::rankViews(const cv::Mat &testDescriptors) const
+{
+    std::vector<ViewScore> scores(viewCount_);
+    for (size_t v = 0; v < viewCount_; ++v)
+        scores[v] = {static_cast<int>(v), 0};
+    if (testDescriptors.empty() || shortlistRows_.empty())
+        return scores;
+
+    // Evenly spaced test descriptors (SIFT orders them by scale, so this spans all octaves)
+    const int samples = std::min(params_.shortlistSamples, testDescriptors.rows);
+    const int stride = std::max(1, testDescriptors.rows / std::max(1, samples));
+    cv::Mat sample;
+    for (int r = 0; r < testDescriptors.rows && sample.rows < samples; r += stride)
+        sample.push_back(testDescriptors.row(r));
+    sample = DescriptorQuantizer::convert(sample, params_.format);
+
+    // Every sampled descriptor votes for the view of its nearest voting row
+    // (a ratio above 1 accepts every nearest neighbour)
+    std::vector<cv::DMatch> nearest;
+    SimdMatcher::matchRatio(sample, shortlistRows_, 2.0f, nearest);
+    for (const auto &m : nearest)
+        ++scores[shortlistRowView_[m.trainIdx]].votes;
+
+    std::stable_sort(scores.begin(), scores.end(), [](const ViewScore &a, const ViewScore &b)
+                     { return a.votes > b.votes; });
+    return scores;
+}
+
+std::vector<int> GalleryIndex::shortlist(const cv::Mat &testDescriptors) const
+{
+    std::vector<int> views;
+    std::vector<ViewScore> ranked = rankViews(testDescriptors);
+    if (ranked.empty())
+        return views;
+
+    const int best = ranked[0].votes;
+    views.push_back(ranked[0].view);
+
+    // Early exit: one view clearly dominates
+    if (ranked.size() > 1 && best > 0 && best >= params_.shortlistDominance * ranked[1].votes)
+        return views;
+
+    // Adaptive K: views close enough to the best one, at most shortlistK
+    for (size_t i = 1; i < ranked.size() && static_cast<int>(views.size()) < params_.shortlistK; ++i)
+    {
+        if (ranked[i].votes < params_.shortlistKeep * best)
+            break;
+        views.push_back(ranked[i].view);
+    }
+    return views;
+}
+
+std::vector<std::vector<cv::DMatch>> GalleryIndex::matchViews(
+    const cv::Mat &testDescriptors,
+    float nndrRatio,
+    const std::vector<int> *views) const
+{
+    std::vector<std::vector<cv::DMatch>> viewMatches(viewCount_);
+    if (testDescriptors.empty())
+        return viewMatches;
+
+    // Views to match
+    std::vector<char> wanted(viewCount_, views ? 0 : 1);
+    if (views)
+        for (int v : *views)
+            wanted[v] = 1;
+
+    // Test descriptors are converted to the gallery format
+    cv::Mat query = DescriptorQuantizer::convert(testDescriptors, params_.format);
+
+    // Exact searches match every view on its own, as the original brute-force matcher did
+    // (quantized galleries with the integer kernel)
+    if (params_.search != GallerySearch::Flann)
+    {
+        MatcherBackend backend = params_.search == GallerySearch::OpenCV ? MatcherBackend::OpenCV : MatcherBackend::Simd;
+        for (size_t v = 0; v < viewCount_; ++v)
+        {
+            if (!wanted[v])
+                continue;
+            TRACE_SCOPE("match_view");
+            if (!viewDescriptors_[v].empty())
+                viewMatches[v] = Matching::matchDescriptors(viewDescriptors_[v], query, nndrRatio, backend);
+        }
+        return viewMatches;
+    }
+
+    if (query.rows < 2)
+        return viewMatches;
+
+    // The ratio test compares the two nearest test descriptors of every model keypoint,
+    // as the exact matchers do, so the index is over the test descriptors and has to be
+    // built per image. All wanted model rows then query it in one search: the stacked
+    // gallery, or the rows of the listed views gathered into one block. The stacked rows
+    // are floats already; only the test rows are widened per image.
+    std::vector<std::pair<int, int>> segments; // (view, first row in modelRows)
+    cv::Mat modelRows;
+    for (size_t v = 0; v < viewCount_; ++v)
+    {
+        if (!wanted[v] || viewStart_[v + 1] == viewStart_[v])
+            continue;
+        if (views)
+        {
+            segments.emplace_back(static_cast<int>(v), modelRows.rows);
+            modelRows.push_back(searchRows_.rowRange(viewStart_[v], viewStart_[v + 1]));
+        }
+        else
+        {
+            segments.emplace_back(static_cast<int>(v), viewStart_[v]);
+        }
+    }
+    if (!views)
+        modelRows = searchRows_;
+    if (segments.empty())
+        return viewMatches;
+
+    cv::Mat testRows = query;
+    if (testRows.type() != CV_32F)
+        query.convertTo(testRows, CV_32F);
+    cv::flann::Index index;
+    {
+        TRACE_SCOPE("flann_build");
+        index.build(testRows, cv::flann::KDTreeIndexParams(params_.trees), cvflann::FLANN_DIST_L2);
+    }
+    cv::Mat indices, dists;
+    {
+        TRACE_SCOPE("flann_search");
+        index.knnSearch(modelRows, indices, dists, 2, cv::flann::SearchParams(params_.checks));
+    }
+
+    // Split the answers by view; FLANN returns squared L2 distances, so compare
+    // against the squared ratio
+    const float ratioSq = nndrRatio * nndrRatio;
+    for (const auto &segment : segments)
+    {
+        const int v = segment.first;
+        const int rows = viewStart_[v + 1] - viewStart_[v];
+        for (int r = 0; r < rows; ++r)
+        {
+            const int *idx = indices.ptr<int>(segment.second + r);
+            const float *dist = dists.ptr<float>(segment.second + r);
+            if (idx[0] >= 0 && idx[1] >= 0 && dist[0] < ratioSq * dist[1])
+                viewMatches[v].emplace_back(r, idx[0], std::sqrt(dist[0]));
+        }
+    }
+    return viewMatches;
+}
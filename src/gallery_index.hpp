@@ -0,0 +1,93 @@
+#ifndef GALLERY_INDEX_HPP
+#define GALLERY_INDEX_HPP
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "descriptor_format.hpp"
+#include "detection.hpp"
+#include "matching.hpp"
+
+// How the gallery is searched
+enum class GallerySearch
+{
+    Flann,  // approximate: the test descriptors are indexed per image, all view rows query it in one search
+    OpenCV, // exact brute force per view (cv::BFMatcher)
+    Simd    // exact brute force per view (fused SIMD kernel)
+};
+
+// Parameters of the approximate nearest-neighbour gallery index
+struct GalleryParams
+{
+    GallerySearch search = GallerySearch::Flann;
+    DescriptorFormat format = DescriptorFormat::Float32; // storage of the view descriptors
+    int trees = 4;   // randomized KD-trees in the forest
+    int checks = 64; // leaves visited per query (speed/accuracy trade-off)
+
+    // Two-stage retrieval: views are ranked by cheap nearest-neighbour votes and
+    // only the shortlisted views get full matching and RANSAC
+    int shortlistK = 0;              // maximum views kept (0 = match every view)
+    int shortlistSamples = 128;      // test descriptors that vote
+    int shortlistViewRows = 64;      // strongest descriptors per view used for voting
+    float shortlistKeep = 0.5f;      // keep views with at least this share of the best view's votes
+    float shortlistDominance = 2.0f; // keep only the best view if it has this many times the runner-up's votes
+};
+
+// Votes of one view in the shortlist stage
+struct ViewScore
+{
+    int view;
+    int votes;
+};
+
+// Descriptors of all model views of one object in the gallery format. Each test
+// image is matched with the NNDR test in the model -> test direction (every model
+// keypoint against its two nearest test descriptors). The exact searches brute-force
+// each view. The FLANN search indexes the test descriptors of each image and answers
+// all view rows, stacked once in build(), with one search; its cost still grows with
+// the number of model rows searched. The stacked rows are floats (4 bytes per value)
+// whatever the format, so with FLANN a quantized format saves no gallery memory.
+class GalleryIndex
+{
+public:
+    GalleryIndex() = default;
+
+    // Build the index over all model views
+    void build(const std::vector<ViewFeatures> &views, const GalleryParams &params = GalleryParams());
+
+    size_t viewCount() const { return viewCount_; }
+    bool empty() const { return descriptorCount_ == 0; }
+
+    // Bytes held by the view and shortlist descriptors
+    size_t memoryBytes() const;
+    const GalleryParams &params() const { return params_; }
+
+    // Match test descriptors against every view with the NNDR test.
+    // Returns one match list per view (queryIdx = model keypoint, trainIdx = test keypoint).
+    // With a view list only those views are matched (with FLANN, only their rows are
+    // gathered into the search), so the cost scales with the list; the others stay empty.
+    std::vector<std::vector<cv::DMatch>> matchViews(
+        const cv::Mat &testDescriptors,
+        float nndrRatio = 0.75f,
+        const std::vector<int> *views = nullptr) const;
+
+    // True if the shortlist stage is configured and would skip some views
+    bool shortlistEnabled() const;
+
+    // Rank all views by nearest-neighbour votes of a subsample of the test descriptors
+    std::vector<ViewScore> rankViews(const cv::Mat &testDescriptors) const;
+
+    // Views worth full matching: the top of rankViews, cut adaptively
+    std::vector<int> shortlist(const cv::Mat &testDescriptors) const;
+
+private:
+    GalleryParams params_;
+    size_t viewCount_ = 0;
+    size_t descriptorCount_ = 0;
+    std::vector<cv::Mat> viewDescriptors_; // per-view descriptors in the gallery format
+    cv::Mat searchRows_;                   // FLANN only: the rows of all views, stacked as CV_32F
+    std::vector<int> viewStart_;           // first row of each view in searchRows_ (plus the end)
+    cv::Mat shortlistRows_;                // strongest descriptors of every view, stacked
+    std::vector<int> shortlistRowView_;    // view index of each shortlist row
+};
+
+#endif // GALLERY_INDEX_HPP
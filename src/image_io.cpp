@@ -0,0 +1,60 @@
+#include "image_io.hpp"
+#include <cmath>
+#include "mapped_file.hpp"
+
+cv::Mat decodeImage(const uint8_t *data, size_t size, int flags)
+{
+    if (!data || size == 0)
+        return cv::Mat();
+    // imdecode only reads the buffer, so wrapping it without a copy is safe
+    cv::Mat bytes(1, static_cast<int>(size), CV_8U, const_cast<uint8_t *>(data));
+    return cv::imdecode(bytes, flags);
+}
+
+cv::Mat decodeGrayscale(const uint8_t *data, size_t size, double scale)
+{
+    // Largest reduced decode that is still at least as large as requested
+    static const struct
+    {
+        int factor;
+        int flags;
+    } modes[] = {{8, cv::IMREAD_REDUCED_GRAYSCALE_8},
+                 {4, cv::IMREAD_REDUCED_GRAYSCALE_4},
+                 {2, cv::IMREAD_REDUCED_GRAYSCALE_2},
+                 {1, cv::IMREAD_GRAYSCALE}};
+    int factor = 1;
+    int flags = cv::IMREAD_GRAYSCALE;
+    for (const auto &m : modes)
+    {
+        if (scale * m.factor <= 1.0 + 1e-9)
+        {
+            factor = m.factor;
+            flags = m.flags;
+            break;
+        }
+    }
+
+    cv::Mat gray = decodeImage(data, size, flags);
+    double rest = scale * factor;
+    if (gray.empty() || std::abs(rest - 1.0) < 1e-6)
+        return gray;
+    cv::Mat resized;
+    cv::resize(gray, resized, cv::Size(), rest, rest, cv::INTER_AREA);
+    return resized;
+}
+
+cv::Mat readImage(const std::filesystem::path &path, int flags)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return cv::Mat();
+    return decodeImage(file.data(), file.size(), flags);
+}
+
+cv::Mat readGrayscale(const std::filesystem::path &path, double scale)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return cv::Mat();
+    return decodeGrayscale(file.data(), file.size(), scale);
+}
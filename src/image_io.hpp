@@ -0,0 +1,24 @@
+#ifndef IMAGE_IO_HPP
+#define IMAGE_IO_HPP
+
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// Decode an image file (cv::IMREAD_* flags) from a read-only memory mapping, so the
+// encoded bytes reach cv::imdecode without a read copy. Empty on failure.
+cv::Mat readImage(const std::filesystem::path &path, int flags = cv::IMREAD_COLOR);
+
+// Decode an image file straight to grayscale at about `scale` of its size. Scales of
+// 1/2, 1/4 and 1/8 use the decoder's reduced modes (JPEG skips the high DCT
+// frequencies); other scales decode at the next larger reduced size and resize.
+cv::Mat readGrayscale(const std::filesystem::path &path, double scale = 1.0);
+
+// Decode encoded image bytes in memory (e.g. a mapped archive) without copying them
+cv::Mat decodeImage(const uint8_t *data, size_t size, int flags = cv::IMREAD_COLOR);
+
+// readGrayscale on encoded image bytes in memory
+cv::Mat decodeGrayscale(const uint8_t *data, size_t size, double scale = 1.0);
+
+#endif // IMAGE_IO_HPP
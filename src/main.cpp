@@ -1,298 +1,246 @@
 #include <opencv2/opencv.hpp>
+#include <chrono>
+#include <csignal>
 #include <filesystem>
 #include <fstream>
-#include "preprocessing.hpp"
-#include "detection.hpp"
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include "cli/dataset_runner.hpp"
+#include "cli/run_options.hpp"
+#include "cli/tool_modes.hpp"
 #include "dataloader.hpp"
-#include "matching.hpp"
-#include "object_localizer.hpp"
-
-namespace fs = std::__fs::filesystem;
-
-// Balanced parameters for all objects
-struct DetectionParams
+#include "dataset_pack.hpp"
+#include "detection.hpp"
+#include "detection_server.hpp"
+#include "detector.hpp"
+#include "feature_cache.hpp"
+#include "prefetching_loader.hpp"
+#include "result_renderer.hpp"
+#include "results_writer.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include "vocab_tree.hpp"
+
+namespace fs = std::filesystem;
+
+// Daemon of --serve, stopped by SIGINT/SIGTERM
+static DetectionServer *g_server = nullptr;
+
+static void stopServer(int)
 {
-    int matchesThreshold;
-    int minInliers;
-    double clusterBandwidth;
-    double maxDistanceFromCenter;
-    double ransacThreshold;
-};
+    if (g_server)
+        g_server->stop();
+}
 
-DetectionParams getObjectParams(const std::string &objectKey)
+// Create the results directory if it doesn't exist
+static bool prepareResultsDir(const fs::path &resultsPath)
 {
-    DetectionParams params;
-    // Base balanced parameters
-    params.matchesThreshold = 8;
-    params.minInliers = 5;
-    params.clusterBandwidth = 45.0;      // Intermediate value between 40 and 50
-    params.maxDistanceFromCenter = 60.0; // Intermediate value
-    params.ransacThreshold = 3.0;
+    std::error_code ec;
+    fs::create_directories(resultsPath, ec);
+    if (ec)
+    {
+        std::cerr << "Failed to create results directory " << resultsPath.string() << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    // Small adjustments per object type
-    if (objectKey.find("power_drill") != std::string::npos)
+// Load and index the model views of every object once. Only the modes that search
+// with the vocabulary tree pass vocab, so the others never load or train it.
+static std::unique_ptr<Detector> createDetector(const IDataLoader &loader,
+                                                const fs::path &rootPath,
+                                                const fs::path &cachePath,
+                                                const RunOptions &options,
+                                                bool vocab)
+{
+    DetectorConfig config;
+    config.loader = &loader;
+    config.dataPath = rootPath;
+    config.cachePath = cachePath;
+    config.gallery = options.gallery;
+    config.objectParams = [&options](const std::string &key)
+    { return objectParams(key, options); };
+    config.sceneDenoise = options.denoise;
+    config.coarseToFine = options.coarseToFine;
+    config.vocab = vocab;
+    config.vocabTrain = options.vocabTrain;
+    config.vocabCandidates = options.vocabCandidates;
+    config.threads = options.threads;
+    std::string error;
+    std::unique_ptr<Detector> detector = Detector::create(config, &error);
+    if (!detector)
     {
-        params.matchesThreshold = 6;
-        params.minInliers = 4;
-        params.clusterBandwidth = 50.0;      // Reduced from previous version
-        params.maxDistanceFromCenter = 70.0; // Reduced from previous version
+        std::cerr << "Failed to create detector: " << error << std::endl;
+        return nullptr;
     }
-    else if (objectKey.find("mustard") != std::string::npos)
+
+    // Images are processed in parallel by our pool, so keep OpenCV itself single-threaded
+    if (detector->pool().size() > 1)
+        cv::setNumThreads(1);
+
+    if (const VocabularyTree *tree = detector->vocabulary())
     {
-        params.clusterBandwidth = 48.0;
+        std::cout << "Vocabulary tree: " << tree->wordCount() << " words, " << tree->documentCount() << " views";
+        if (detector->vocabTrainSeconds() > 0.0)
+            std::cout << " (trained in " << std::fixed << std::setprecision(2) << detector->vocabTrainSeconds()
+                      << " s)" << std::defaultfloat << std::endl;
+        else
+            std::cout << " (loaded)" << std::endl;
     }
+    return detector;
+}
 
-    return params;
+// Modes that build their own object models for each configuration they compare
+static int runModelSweep(const IDataLoader &loader,
+                         const fs::path &rootPath,
+                         const fs::path &resultsPath,
+                         const fs::path &cachePath,
+                         const RunOptions &options)
+{
+    ThreadPool pool(options.threads);
+    if (pool.size() > 1)
+        cv::setNumThreads(1);
+    FeatureExtractor extractor;
+
+    if (options.quantParity)
+        return runQuantParity(loader, rootPath, extractor, FeatureCache(cachePath), options, pool);
+    if (options.denoiseBench)
+        return runDenoiseBench(loader, rootPath, extractor, cachePath, options, pool);
+    if (!prepareResultsDir(resultsPath))
+        return 1;
+    return runEvaluation(loader, rootPath, resultsPath, extractor, cachePath, options, pool);
 }
 
-int main()
+// Daemon mode; writes no results files or log
+static int runServer(const Detector &detector, const RunOptions &options)
 {
-    fs::path rootPath("../data/object_detection_dataset/");
-    fs::path resultsPath("../data/results/");
+    DetectionServer server(detector, options.server);
+    g_server = &server;
+    std::signal(SIGINT, stopServer);
+    std::signal(SIGTERM, stopServer);
+    std::cout << "Serving " << detector.objects().size() << " objects on " << options.server.socketPath << std::endl;
+    bool ok = server.run();
+    g_server = nullptr;
+    return ok ? 0 : 1;
+}
 
-    // Create results directory if it doesn't exist
-    if (!fs::exists(resultsPath))
-    {
-        fs::create_directories(resultsPath);
-    }
+int main(int argc, char **argv)
+{
+    RunOptions options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
 
-    // Open log file
-    std::ofstream logFile(resultsPath / "detection_results.txt");
-    if (!logFile.is_open())
+    fs::path rootPath(options.dataPath);
+    fs::path resultsPath(options.resultsPath);
+    fs::path cachePath(options.cachePath);
+
+    // The dataset is read from its files, or from a pack of them
+    FileSystemDataLoader files;
+    PackDataLoader pack;
+    if (!options.packPath.empty() && !pack.open(options.packPath))
     {
-        std::cerr << "Failed to open log file" << std::endl;
+        std::cerr << "Failed to open dataset pack: " << options.packPath << std::endl;
         return 1;
     }
-
-    FileSystemDataLoader loader;
-    auto code = loader.checkIntegrity(rootPath);
+    const IDataLoader &source = pack.isOpen() ? static_cast<const IDataLoader &>(pack) : files;
+    auto code = source.checkIntegrity(rootPath);
     if (code != IntegrityCode::OK)
     {
         std::cerr << "Dataset integrity error: " << static_cast<int>(code) << std::endl;
         return static_cast<int>(code);
     }
 
-    for (const auto &key : loader.listObjectKeys(rootPath))
-    {
-        std::cout << "Processing object: " << key << std::endl;
-        logFile << "Processing object: " << key << std::endl;
-
-        // Get specific parameters for this object
-        DetectionParams params = getObjectParams(key);
-
-        fs::path outDir = resultsPath / key;
-        if (!fs::exists(outDir))
-        {
-            fs::create_directories(outDir);
-        }
-
-        // Load model views
-        auto modelViews = loader.loadModelViews(rootPath, key);
-        std::vector<cv::Mat> modelDescriptors;
-        std::vector<std::string> modelNames;
-        std::vector<std::vector<cv::KeyPoint>> modelKeypoints;
-        std::vector<cv::Mat> modelMasks;
-
-        // Process each model view
-        for (const auto &mv : modelViews)
-        {
-            cv::Mat grayModel;
-            cv::cvtColor(mv.color, grayModel, cv::COLOR_BGR2GRAY);
-
-            // Preprocess model image
-            cv::Mat processedModel = Preprocessing::reduceNoise(grayModel);
-
-            // Detect keypoints using mask
-            auto kpModel = Detection::detectKeypoints(processedModel, mv.mask);
-
-            // Compute descriptors
-            auto descModel = Detection::computeDescriptors(processedModel, kpModel);
-
-            // Store model information
-            modelDescriptors.push_back(descModel);
-            modelNames.push_back(mv.name);
-            modelKeypoints.push_back(kpModel);
-            modelMasks.push_back(mv.mask);
-
-            std::cout << "  Model view '" << mv.name << "' keypoints: " << kpModel.size() << std::endl;
-            logFile << "  Model view '" << mv.name << "' keypoints: " << kpModel.size() << std::endl;
-        }
-
-        // Process test images
-        auto testImages = loader.listTestImages(rootPath, key);
-        for (const auto &ti : testImages)
-        {
-            std::cout << "  Processing test image: " << ti.name << std::endl;
-            logFile << "  Processing test image: " << ti.name << std::endl;
-
-            // Load test image
-            cv::Mat timg = cv::imread(ti.path.string());
-            if (timg.empty())
-            {
-                std::cerr << "  Failed to read image: " << ti.name << std::endl;
-                logFile << "  Failed to read image: " << ti.name << std::endl;
-                continue;
-            }
-
-            // Convert to grayscale and preprocess
-            cv::Mat grayTest;
-            cv::cvtColor(timg, grayTest, cv::COLOR_BGR2GRAY);
-            cv::Mat processedTestImage = Preprocessing::reduceNoise(grayTest);
+    if (!options.writePackPath.empty())
+        return runWritePack(source, rootPath, options);
 
-            // Detect features in test image
-            auto kpTest = Detection::detectKeypoints(processedTestImage);
-            auto descTest = Detection::computeDescriptors(processedTestImage, kpTest);
+    // Optionally decode model views in parallel and test images ahead of the detector
+    std::unique_ptr<PrefetchingDataLoader> prefetcher;
+    if (options.prefetch.lookahead > 0)
+        prefetcher.reset(new PrefetchingDataLoader(source, options.prefetch));
+    const IDataLoader &loader = prefetcher ? static_cast<const IDataLoader &>(*prefetcher) : source;
 
-            if (descTest.empty())
-            {
-                std::cerr << "  Warning: No descriptors found in test image: " << ti.name << std::endl;
-                logFile << "  Warning: No descriptors found in test image: " << ti.name << std::endl;
-                continue;
-            }
+    if (!options.verifyMatcher && (options.quantParity || options.denoiseBench || options.evaluate))
+        return runModelSweep(loader, rootPath, resultsPath, cachePath, options);
 
-            // Find the best matching model view
-            size_t bestModelIdx = 0;
-            int maxGoodMatches = 0;
-            std::vector<cv::DMatch> bestMatches;
-            std::vector<cv::DMatch> bestInliers;
-
-            for (size_t m = 0; m < modelDescriptors.size(); ++m)
-            {
-                // Match descriptors
-                auto goodMatches = Matching::matchDescriptors(modelDescriptors[m], descTest);
-
-                // Find RANSAC inliers
-                auto inlierMatches = Matching::findRansacInliers(
-                    modelKeypoints[m], kpTest, goodMatches, params.ransacThreshold);
-
-                std::cout << "    Model View: " << modelNames[m]
-                          << " - Good Matches: " << goodMatches.size()
-                          << " - Inliers: " << inlierMatches.size() << std::endl;
-                logFile << "    Model View: " << modelNames[m]
-                        << " - Good Matches: " << goodMatches.size()
-                        << " - Inliers: " << inlierMatches.size() << std::endl;
-
-                // Track the best model view
-                if ((int)goodMatches.size() > maxGoodMatches)
-                {
-                    maxGoodMatches = goodMatches.size();
-                    bestModelIdx = m;
-                    bestMatches = goodMatches;
-                    bestInliers = inlierMatches;
-                }
-            }
-
-            // If we have enough matches
-            if (maxGoodMatches >= params.matchesThreshold)
-            {
-                bool detectionSucceeded = false;
-                cv::Rect detectedBox;
-
-                // Try different strategies in order of preference
-
-                // 1. Try adaptive bounding box (works well for power_drill)
-                if (key.find("power_drill") != std::string::npos)
-                {
-                    detectedBox = ObjectLocalizer::adaptiveBoundingBox(
-                        kpTest, bestInliers.size() >= params.minInliers ? bestInliers : bestMatches, key);
-
-                    if (detectedBox.width > 0 && detectedBox.height > 0)
-                    {
-                        detectionSucceeded = true;
-                    }
-                }
-
-                // 2. Try homography (usually the best)
-                if (!detectionSucceeded && bestInliers.size() >= params.minInliers)
-                {
-                    cv::Size modelSize(modelMasks[bestModelIdx].cols, modelMasks[bestModelIdx].rows);
-                    detectedBox = ObjectLocalizer::getBoundingBoxFromHomography(
-                        modelKeypoints[bestModelIdx], kpTest, bestInliers, modelSize);
-
-                    if (detectedBox.width > 0 && detectedBox.height > 0 &&
-                        detectedBox.width < 600 && detectedBox.height < 600)
-                    {
-                        detectionSucceeded = true;
-                    }
-                }
-
-                // 3. Fallback to clustering
-                if (!detectionSucceeded)
-                {
-                    // Use matches with the strongest confidence
-                    std::vector<cv::DMatch> matchesToUse = bestInliers.size() >= 4 ? bestInliers : bestMatches;
-
-                    std::vector<cv::Point2f> testPoints = ObjectLocalizer::extractDetectedPoints(
-                        modelKeypoints[bestModelIdx], kpTest, matchesToUse);
-
-                    // Filter and cluster points
-                    auto filteredPoints = ObjectLocalizer::filterPointsByDistance(
-                        testPoints, params.maxDistanceFromCenter);
-                    auto clusteredPoints = ObjectLocalizer::clusterMeanShift(
-                        filteredPoints, params.clusterBandwidth);
-
-                    if (!clusteredPoints.empty())
-                    {
-                        // Create a separate image for rotated box
-                        cv::Mat boxedImg = timg.clone();
-                        ObjectLocalizer::drawBox(boxedImg, clusteredPoints, cv::Scalar(0, 255, 0), 2);
-
-                        // Also use regular bounding box for consistency
-                        detectedBox = cv::boundingRect(clusteredPoints);
-
-                        // Expand the bounding box with a balanced value
-                        int padding = std::max(5, std::min(detectedBox.width, detectedBox.height) / 6); // ~16%
-                        detectedBox.x = std::max(0, detectedBox.x - padding);
-                        detectedBox.y = std::max(0, detectedBox.y - padding);
-                        detectedBox.width = std::min(timg.cols - detectedBox.x, detectedBox.width + 2 * padding);
-                        detectedBox.height = std::min(timg.rows - detectedBox.y, detectedBox.height + 2 * padding);
-
-                        // Draw regular bounding box on the original image
-                        cv::rectangle(timg, detectedBox, cv::Scalar(0, 255, 0), 2);
+    // Matcher check and sequences run on the models alone, without the vocabulary tree
+    bool vocab = options.vocab && !options.verifyMatcher && options.sequencePath.empty();
+    std::unique_ptr<Detector> detector = createDetector(loader, rootPath, cachePath, options, vocab);
+    if (!detector)
+        return 1;
+    ThreadPool &pool = detector->pool();
+    const FeatureExtractor &extractor = detector->extractor();
+    const std::vector<ObjectModel> &objects = detector->objects();
 
-                        // Save both images
-                        fs::path resultPath = outDir / ("result_" + ti.name);
-                        fs::path boxedPath = outDir / ("rotated_" + ti.name);
-                        cv::imwrite(resultPath.string(), timg);
-                        cv::imwrite(boxedPath.string(), boxedImg);
+    if (options.verifyMatcher)
+        return runMatcherCheck(loader, rootPath, objects, extractor, pool);
+    if (options.serve)
+        return runServer(*detector, options);
 
-                        detectionSucceeded = true;
-                    }
-                }
+    // Text log and one structured record per test image, written in the background
+    if (!prepareResultsDir(resultsPath))
+        return 1;
+    std::ofstream logFile(resultsPath / "detection_results.txt");
+    if (!logFile.is_open())
+    {
+        std::cerr << "Failed to open log file" << std::endl;
+        return 1;
+    }
+    fs::path recordsPath = resultsPath / (std::string("detection_results.") + resultsFormatName(options.resultsFormat));
+    ResultsWriter writer(recordsPath.string(), options.resultsFormat);
+    if (!writer.isOpen())
+    {
+        std::cerr << "Failed to open results file: " << recordsPath.string() << std::endl;
+        return 1;
+    }
 
-                // If we succeeded with any of the strategies
-                if (detectionSucceeded)
-                {
-                    // Draw regular bounding box
-                    cv::rectangle(timg, detectedBox, cv::Scalar(0, 255, 0), 2);
+    if (!options.sequencePath.empty())
+    {
+        int code = runSequenceMode(objects, extractor, options, pool, logFile, writer);
+        writer.flush();
+        std::cout << "Wrote " << writer.written() << " frame records to " << recordsPath.string() << std::endl;
+        return code;
+    }
 
-                    // Save the result
-                    fs::path resultPath = outDir / ("result_" + ti.name);
-                    cv::imwrite(resultPath.string(), timg);
+    ResultRenderer renderer(options.render, &loader);
+    auto start = std::chrono::steady_clock::now();
+    if (options.sceneMode)
+        runSceneMode(loader, rootPath, resultsPath, *detector, options, logFile, writer, renderer);
+    else
+        runObjectMode(loader, rootPath, resultsPath, *detector, options, logFile, writer, renderer);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    writer.flush();
+    renderer.flush();
+    std::cout << "Wrote " << writer.written() << " image records to " << recordsPath.string()
+              << " in " << std::fixed << std::setprecision(2) << seconds << " s" << std::endl;
+    if (prefetcher)
+    {
+        PrefetchStats st = prefetcher->stats();
+        std::cout << "Prefetch: " << st.hits << " cached, " << st.waits << " in flight, " << st.misses
+                  << " decoded on demand, " << st.evictions << " evicted" << std::endl;
+    }
+    if (options.render.mode != RenderMode::Off)
+    {
+        std::cout << "Rendered " << renderer.written() << " results (" << renderModeName(options.render.mode)
+                  << ", " << renderer.renderMs() / 1000.0 << " s on " << options.render.threads
+                  << " threads)" << std::endl;
+        if (renderer.failed() > 0)
+            std::cerr << "Failed to render " << renderer.failed() << " results" << std::endl;
+    }
 
-                    // Log detection
-                    logFile << "  " << ti.name << ": Object detected at "
-                            << detectedBox.x << "," << detectedBox.y << " - "
-                            << detectedBox.x + detectedBox.width << ","
-                            << detectedBox.y + detectedBox.height
-                            << " (matches: " << maxGoodMatches
-                            << ", inliers: " << bestInliers.size() << ")" << std::endl;
-                }
-                else
-                {
-                    std::cout << "  No valid bounding box found for: " << ti.name << std::endl;
-                    logFile << "  " << ti.name << ": No valid bounding box found" << std::endl;
-                }
-            }
-            else
-            {
-                std::cout << "  Not enough matches for image: " << ti.name << std::endl;
-                logFile << "  " << ti.name << ": Not enough matches (best: " << maxGoodMatches
-                        << ", inliers: " << bestInliers.size() << ")" << std::endl;
-            }
-        }
+#ifdef OBJECT_DETECT_TRACE
+    if (!options.tracePath.empty())
+    {
+        if (!trace::writeChromeTrace(options.tracePath))
+            std::cerr << "Failed to write trace: " << options.tracePath << std::endl;
+        trace::writeSummary(std::cout);
+        trace::writeSummary(logFile);
     }
+#endif
 
     logFile.close();
     return 0;
-}
\ No newline at end of file
+}
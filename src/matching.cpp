@@ -1,4 +1,35 @@
 #include "matching.hpp"
+#include "simd_matcher.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+
+const char *ransacMethodName(RansacMethod method)
+{
+    return method == RansacMethod::Prosac ? "prosac" : "ransac";
+}
+
+bool parseRansacMethod(const std::string &name, RansacMethod &method)
+{
+    if (name == "ransac")
+        method = RansacMethod::Ransac;
+    else if (name == "prosac")
+        method = RansacMethod::Prosac;
+    else
+        return false;
+    return true;
+}
+
+bool prosacAvailable()
+{
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 5)
+    return true;
+#else
+    return false;
+#endif
+}
 
 std::vector<cv::DMatch> Matching::matchDescriptors(
     const cv::Mat &modelDescriptors,
@@ -33,6 +64,58 @@ std::vector<cv::DMatch> Matching::matchDescriptors(
     return goodMatches;
 }
 
+std::vector<cv::DMatch> Matching::matchDescriptors(
+    const cv::Mat &modelDescriptors,
+    const cv::Mat &testDescriptors,
+    float nndrRatio,
+    MatcherBackend backend)
+{
+    if (backend == MatcherBackend::OpenCV)
+        return matchDescriptors(modelDescriptors, testDescriptors, nndrRatio);
+
+    // The fused kernel works on float or uint8 rows of the same type
+    cv::Mat model = modelDescriptors, test = testDescriptors;
+    if (model.empty() || test.empty())
+        return {};
+    if (model.type() != test.type() || (model.type() != CV_32F && model.type() != CV_8U))
+    {
+        modelDescriptors.convertTo(model, CV_32F);
+        testDescriptors.convertTo(test, CV_32F);
+    }
+
+    std::vector<cv::DMatch> goodMatches;
+    SimdMatcher::matchRatio(model, test, nndrRatio, goodMatches);
+    return goodMatches;
+}
+
+MatcherComparison Matching::compareBackends(
+    const cv::Mat &modelDescriptors,
+    const cv::Mat &testDescriptors,
+    float nndrRatio)
+{
+    auto reference = matchDescriptors(modelDescriptors, testDescriptors, nndrRatio, MatcherBackend::OpenCV);
+    auto fused = matchDescriptors(modelDescriptors, testDescriptors, nndrRatio, MatcherBackend::Simd);
+
+    MatcherComparison cmp;
+    cmp.opencvMatches = reference.size();
+    cmp.simdMatches = fused.size();
+
+    // Both lists hold at most one match per query row
+    std::vector<const cv::DMatch *> byQuery(modelDescriptors.rows, nullptr);
+    for (const auto &m : reference)
+        byQuery[m.queryIdx] = &m;
+    for (const auto &m : fused)
+    {
+        const cv::DMatch *ref = byQuery[m.queryIdx];
+        if (ref && ref->trainIdx == m.trainIdx)
+        {
+            cmp.agreeing++;
+            cmp.maxDistanceDiff = std::max(cmp.maxDistanceDiff, std::abs(ref->distance - m.distance));
+        }
+    }
+    return cmp;
+}
+
 bool Matching::findObject(
     const std::vector<cv::Mat> &modelDescriptors,
     const std::vector<std::string> &modelNames,
@@ -88,40 +171,100 @@ std::vector<std::pair<int, std::vector<cv::DMatch>>> Matching::matchTopNModels(
     return allMatches;
 }
 
-std::vector<cv::DMatch> Matching::findRansacInliers(
+GeometricVerification Matching::verifyHomography(
     const std::vector<cv::KeyPoint> &keypointsModel,
     const std::vector<cv::KeyPoint> &keypointsTest,
     const std::vector<cv::DMatch> &matches,
-    double ransacThreshold)
+    double ransacThreshold,
+    RansacMethod method)
 {
+    GeometricVerification result;
+
     // Not enough matches for RANSAC
     if (matches.size() < 4)
-        return matches;
+    {
+        result.inliers = matches;
+        return result;
+    }
+
+    TRACE_SCOPE("ransac");
+
+    // PROSAC draws its samples from the front of the list, so put the most
+    // distinctive matches (smallest descriptor distance) first
+    std::vector<size_t> order(matches.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    if (method == RansacMethod::Prosac)
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                         { return matches[a].distance < matches[b].distance; });
 
     std::vector<cv::Point2f> ptsModel, ptsTest;
-    for (const auto &match : matches)
+    ptsModel.reserve(matches.size());
+    ptsTest.reserve(matches.size());
+    for (size_t i : order)
     {
-        ptsModel.push_back(keypointsModel[match.queryIdx].pt);
-        ptsTest.push_back(keypointsTest[match.trainIdx].pt);
+        ptsModel.push_back(keypointsModel[matches[i].queryIdx].pt);
+        ptsTest.push_back(keypointsTest[matches[i].trainIdx].pt);
     }
 
-    // Calculate homography with RANSAC
-    std::vector<uchar> inliersMask;
-    cv::Mat H = cv::findHomography(ptsModel, ptsTest, cv::RANSAC, ransacThreshold, inliersMask);
+    // Calculate homography; both estimators stop adaptively at 99.5% confidence
+    int estimator = cv::RANSAC;
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 5)
+    if (method == RansacMethod::Prosac)
+        estimator = cv::USAC_PROSAC;
+#else
+    if (method == RansacMethod::Prosac)
+    {
+        static std::once_flag warned;
+        std::call_once(warned, []
+                       { std::cerr << "PROSAC needs OpenCV 4.5 or newer; using RANSAC" << std::endl; });
+    }
+#endif
+    std::vector<uchar> sortedMask;
+    result.H = cv::findHomography(ptsModel, ptsTest, estimator, ransacThreshold, sortedMask, 2000, 0.995);
 
-    // If homography couldn't be computed, return all matches
-    if (H.empty())
-        return matches;
+    // If homography couldn't be computed, keep all matches
+    if (result.H.empty())
+    {
+        result.inliers = matches;
+        return result;
+    }
 
-    // Filter matches using inliers mask
-    std::vector<cv::DMatch> inlierMatches;
+    // Filter matches using the inlier mask, back in match order
+    result.inlierMask.assign(matches.size(), 0);
+    for (size_t k = 0; k < order.size(); ++k)
+        result.inlierMask[order[k]] = sortedMask[k];
     for (size_t i = 0; i < matches.size(); i++)
     {
-        if (inliersMask[i])
+        if (result.inlierMask[i])
         {
-            inlierMatches.push_back(matches[i]);
+            result.inliers.push_back(matches[i]);
         }
     }
+    result.score = static_cast<double>(result.inliers.size()) / matches.size();
+
+#ifdef OBJECT_DETECT_TRACE
+    // findHomography does not report its iteration count. This is not a measurement:
+    // it is the adaptive bound uniform sampling would stop at for the final inlier
+    // ratio (confidence 0.995, 2000 iterations at most). PROSAC usually stops well before it.
+    double bound = 2000.0;
+    if (result.score >= 1.0)
+        bound = 1.0;
+    else if (result.score > 0.0)
+        bound = std::min(2000.0, std::ceil(std::log(1.0 - 0.995) / std::log(1.0 - std::pow(result.score, 4))));
+    TRACE_COUNTER("ransac_iteration_bound", bound);
+    TRACE_COUNTER("inliers", result.inliers.size());
+#endif
+
+    return result;
+}
 
-    return inlierMatches;
-}
\ No newline at end of file
+std::vector<cv::DMatch> Matching::findRansacInliers(
+    const std::vector<cv::KeyPoint> &keypointsModel,
+    const std::vector<cv::KeyPoint> &keypointsTest,
+    const std::vector<cv::DMatch> &matches,
+    double ransacThreshold,
+    RansacMethod method)
+{
+    return verifyHomography(keypointsModel, keypointsTest, matches, ransacThreshold, method).inliers;
+}
@@ -2,8 +2,49 @@
 #define MATCHING_HPP
 
 #include <opencv2/opencv.hpp>
+#include <string>
 #include <vector>
 
+// Brute-force matcher implementation
+enum class MatcherBackend
+{
+    OpenCV, // cv::BFMatcher kNN + NNDR filter
+    Simd    // fused top-2 L2 kernel with inline NNDR test
+};
+
+// Robust estimator of the view homography
+enum class RansacMethod
+{
+    Ransac, // uniform sampling (cv::RANSAC)
+    Prosac  // samples drawn best ratio-test distance first, stopping early (cv::USAC_PROSAC)
+};
+
+const char *ransacMethodName(RansacMethod method);
+bool parseRansacMethod(const std::string &name, RansacMethod &method);
+
+// False before OpenCV 4.5, where Prosac runs as Ransac (with a warning on first use)
+bool prosacAvailable();
+
+// Result of verifying the matches of one view with a homography
+struct GeometricVerification
+{
+    cv::Mat H;                       // model -> test homography (empty if none was found)
+    std::vector<uchar> inlierMask;   // one entry per match, in match order
+    std::vector<cv::DMatch> inliers; // matches consistent with H (all matches if H is empty)
+    double score = 0.0;              // inlier ratio
+
+    bool hasHomography() const { return !H.empty(); }
+};
+
+// Agreement between the SIMD and OpenCV matchers on one descriptor pair
+struct MatcherComparison
+{
+    size_t opencvMatches = 0;
+    size_t simdMatches = 0;
+    size_t agreeing = 0;        // same query and train index in both
+    float maxDistanceDiff = 0;  // over agreeing matches
+};
+
 class Matching
 {
 public:
@@ -13,6 +54,19 @@ public:
         const cv::Mat &testDescriptors,
         float nndrRatio = 0.75f);
 
+    // Match descriptors with NNDR test using the selected backend
+    static std::vector<cv::DMatch> matchDescriptors(
+        const cv::Mat &modelDescriptors,
+        const cv::Mat &testDescriptors,
+        float nndrRatio,
+        MatcherBackend backend);
+
+    // Run both backends on the same descriptors and compare their matches
+    static MatcherComparison compareBackends(
+        const cv::Mat &modelDescriptors,
+        const cv::Mat &testDescriptors,
+        float nndrRatio = 0.75f);
+
     // Find object in test image
     static bool findObject(
         const std::vector<cv::Mat> &modelDescriptors,
@@ -28,12 +82,21 @@ public:
         const cv::Mat &testDescriptors,
         int N);
 
+    // Estimate the homography of a view and its inliers in a single pass
+    static GeometricVerification verifyHomography(
+        const std::vector<cv::KeyPoint> &keypointsModel,
+        const std::vector<cv::KeyPoint> &keypointsTest,
+        const std::vector<cv::DMatch> &matches,
+        double ransacThreshold = 3.0,
+        RansacMethod method = RansacMethod::Ransac);
+
     // Find geometric inliers using RANSAC
     static std::vector<cv::DMatch> findRansacInliers(
         const std::vector<cv::KeyPoint> &keypointsModel,
         const std::vector<cv::KeyPoint> &keypointsTest,
         const std::vector<cv::DMatch> &matches,
-        double ransacThreshold = 3.0);
+        double ransacThreshold = 3.0,
+        RansacMethod method = RansacMethod::Ransac);
 };
 
 #endif // MATCHING_HPP
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "object_localizer.hpp"
+#include <algorithm>
 #include <iostream>
 
 std::vector<cv::Point2f> ObjectLocalizer::extractDetectedPoints(
@@ -43,60 +44,207 @@ std::vector<cv::Point2f> ObjectLocalizer::filterPointsByDistance(
     return filtered;
 }
 
-std::vector<cv::Point2f> ObjectLocalizer::clusterMeanShift(
+namespace
+{
+    // Cells of a PointGrid: at least this many are always allowed, beyond that
+    // at most kCellsPerPoint per point
+    const double kMinGridCells = 4096;
+    const double kCellsPerPoint = 4;
+
+    // Uniform grid over the points with cell size >= bandwidth, stored as CSR:
+    // the points of cell c are order[cellStart[c] .. cellStart[c + 1]).
+    // A radius-bandwidth query only has to look at the 3x3 neighbouring cells.
+    // A small bandwidth over a wide spread grows the cells instead of the grid.
+    struct PointGrid
+    {
+        float originX = 0, originY = 0, cellSize = 1;
+        int cols = 0, rows = 0;
+        std::vector<int> cellStart;
+        std::vector<int> order;
+
+        PointGrid(const std::vector<cv::Point2f> &points, float bandwidth)
+        {
+            float maxX = points[0].x, maxY = points[0].y;
+            originX = points[0].x;
+            originY = points[0].y;
+            for (const auto &p : points)
+            {
+                originX = std::min(originX, p.x);
+                originY = std::min(originY, p.y);
+                maxX = std::max(maxX, p.x);
+                maxY = std::max(maxY, p.y);
+            }
+            const double maxCells = std::max(kMinGridCells, kCellsPerPoint * points.size());
+            const double width = maxX - originX, height = maxY - originY;
+            cellSize = bandwidth;
+            while ((width / cellSize + 1.0) * (height / cellSize + 1.0) > maxCells)
+                cellSize *= 2.0f;
+            cols = static_cast<int>((maxX - originX) / cellSize) + 1;
+            rows = static_cast<int>((maxY - originY) / cellSize) + 1;
+
+            // Counting sort of the points by cell
+            std::vector<int> cellOf(points.size());
+            cellStart.assign(static_cast<size_t>(cols) * rows + 1, 0);
+            for (size_t i = 0; i < points.size(); ++i)
+            {
+                cellOf[i] = cellIndex(cellX(points[i].x), cellY(points[i].y));
+                cellStart[cellOf[i] + 1]++;
+            }
+            for (size_t c = 1; c < cellStart.size(); ++c)
+                cellStart[c] += cellStart[c - 1];
+            order.resize(points.size());
+            std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+            for (size_t i = 0; i < points.size(); ++i)
+                order[fill[cellOf[i]]++] = static_cast<int>(i);
+        }
+
+        int cellX(float x) const { return std::clamp(static_cast<int>((x - originX) / cellSize), 0, cols - 1); }
+        int cellY(float y) const { return std::clamp(static_cast<int>((y - originY) / cellSize), 0, rows - 1); }
+        int cellIndex(int cx, int cy) const { return cy * cols + cx; }
+    };
+}
+
+std::vector<MeanShiftMode> ObjectLocalizer::findModes(
     const std::vector<cv::Point2f> &points,
     double bandwidth)
 {
-    if (points.empty())
+    if (points.empty() || bandwidth <= 0)
         return {};
 
-    // Mean Shift clustering
-    std::vector<cv::Point2f> shiftedPoints = points;
+    const int maxIterations = 100;
+    const float eps = 1e-3f;
+    const float bw = static_cast<float>(bandwidth);
+    const float bwSq = bw * bw;
 
-    bool converged = false;
-    int maxIterations = 100;
-    double eps = 1e-3;
+    PointGrid grid(points, bw);
 
-    for (int iter = 0; iter < maxIterations && !converged; ++iter)
+    // Every point is a seed shifted towards the mean of the original points
+    // within the bandwidth. Seeds only read the (fixed) input points and each
+    // seed stops on its own.
+    std::vector<cv::Point2f> seeds(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
     {
-        converged = true;
-
-        for (size_t i = 0; i < shiftedPoints.size(); ++i)
+        cv::Point2f seed = points[i];
+        for (int iter = 0; iter < maxIterations; ++iter)
         {
-            cv::Point2f mean(0, 0);
+            float sumX = 0, sumY = 0;
             int count = 0;
 
-            for (const auto &p : shiftedPoints)
+            int cx = grid.cellX(seed.x), cy = grid.cellY(seed.y);
+            for (int gy = std::max(0, cy - 1); gy <= std::min(grid.rows - 1, cy + 1); ++gy)
             {
-                if (cv::norm(p - shiftedPoints[i]) < bandwidth)
+                for (int gx = std::max(0, cx - 1); gx <= std::min(grid.cols - 1, cx + 1); ++gx)
                 {
-                    mean += p;
-                    count++;
+                    int c = grid.cellIndex(gx, gy);
+                    for (int k = grid.cellStart[c]; k < grid.cellStart[c + 1]; ++k)
+                    {
+                        const cv::Point2f &p = points[grid.order[k]];
+                        float dx = p.x - seed.x, dy = p.y - seed.y;
+                        if (dx * dx + dy * dy < bwSq)
+                        {
+                            sumX += p.x;
+                            sumY += p.y;
+                            count++;
+                        }
+                    }
                 }
             }
 
-            if (count > 0)
+            if (count == 0)
+                break;
+
+            cv::Point2f mean(sumX / count, sumY / count);
+            float sx = mean.x - seed.x, sy = mean.y - seed.y;
+            seed = mean;
+            if (sx * sx + sy * sy <= eps * eps)
+                break;
+        }
+        seeds[i] = seed;
+    }
+
+    // Merge converged seeds that are closer than half the bandwidth to the running
+    // mean of a mode, into the first such mode. Seeds are merged in sorted order, so
+    // the modes do not depend on the order of the input points. The modes are kept in
+    // the cells of the grid by their mean; the cells are at least a bandwidth wide, so
+    // the merge candidates of a seed lie in the 3x3 cells around it.
+    std::sort(seeds.begin(), seeds.end(), [](const cv::Point2f &a, const cv::Point2f &b)
+              { return a.x != b.x ? a.x < b.x : a.y < b.y; });
+    const float mergeSq = bwSq * 0.25f;
+    std::vector<MeanShiftMode> modes;
+    std::vector<cv::Point2f> sums;
+    std::vector<int> modeCell;
+    std::vector<std::vector<int>> cellModes(grid.cellStart.size() - 1);
+    for (const auto &seed : seeds)
+    {
+        int m = -1;
+        int cx = grid.cellX(seed.x), cy = grid.cellY(seed.y);
+        for (int gy = std::max(0, cy - 1); gy <= std::min(grid.rows - 1, cy + 1); ++gy)
+        {
+            for (int gx = std::max(0, cx - 1); gx <= std::min(grid.cols - 1, cx + 1); ++gx)
             {
-                mean *= (1.0f / count);
-                if (cv::norm(mean - shiftedPoints[i]) > eps)
+                for (int candidate : cellModes[grid.cellIndex(gx, gy)])
                 {
-                    shiftedPoints[i] = mean;
-                    converged = false;
+                    if (m >= 0 && candidate > m)
+                        continue;
+                    float dx = modes[candidate].center.x - seed.x, dy = modes[candidate].center.y - seed.y;
+                    if (dx * dx + dy * dy < mergeSq)
+                        m = candidate;
                 }
             }
         }
+        if (m < 0)
+        {
+            m = static_cast<int>(modes.size());
+            modes.push_back({seed, 0});
+            sums.push_back(cv::Point2f(0, 0));
+            modeCell.push_back(grid.cellIndex(cx, cy));
+            cellModes[modeCell.back()].push_back(m);
+        }
+        modes[m].support++;
+        sums[m] += seed;
+
+        // The running mean may move the mode to another cell
+        modes[m].center = sums[m] * (1.0f / modes[m].support);
+        int cell = grid.cellIndex(grid.cellX(modes[m].center.x), grid.cellY(modes[m].center.y));
+        if (cell != modeCell[m])
+        {
+            auto &old = cellModes[modeCell[m]];
+            old.erase(std::find(old.begin(), old.end(), m));
+            cellModes[cell].push_back(m);
+            modeCell[m] = cell;
+        }
     }
 
+    // Strongest first; ties broken by position for a stable order
+    std::sort(modes.begin(), modes.end(), [](const MeanShiftMode &a, const MeanShiftMode &b)
+              {
+                  if (a.support != b.support)
+                      return a.support > b.support;
+                  return a.center.x != b.center.x ? a.center.x < b.center.x : a.center.y < b.center.y;
+              });
+    return modes;
+}
+
+std::vector<cv::Point2f> ObjectLocalizer::clusterMeanShift(
+    const std::vector<cv::Point2f> &points,
+    double bandwidth)
+{
+    if (points.empty())
+        return {};
+
+    auto modes = findModes(points, bandwidth);
+    if (modes.empty())
+        return {};
+
     // Take points close to the densest mode
-    cv::Point2f finalCenter(0, 0);
-    for (const auto &p : shiftedPoints)
-        finalCenter += p;
-    finalCenter *= (1.0f / shiftedPoints.size());
+    const cv::Point2f &finalCenter = modes.front().center;
+    const double radiusSq = (bandwidth * 1.1) * (bandwidth * 1.1); // Slightly increased factor
 
     std::vector<cv::Point2f> clusteredPoints;
     for (const auto &p : points)
     {
-        if (cv::norm(p - finalCenter) < bandwidth * 1.1) // Slightly increased factor
+        cv::Point2f d = p - finalCenter;
+        if (d.x * d.x + d.y * d.y < radiusSq)
             clusteredPoints.push_back(p);
     }
 
@@ -148,7 +296,13 @@ cv::Rect ObjectLocalizer::getBoundingBoxFromHomography(
 
     // Find homography
     cv::Mat H = cv::findHomography(srcPoints, dstPoints, cv::RANSAC, 3.0);
+    return getBoundingBoxFromHomography(H, modelSize);
+}
 
+cv::Rect ObjectLocalizer::getBoundingBoxFromHomography(
+    const cv::Mat &H,
+    const cv::Size &modelSize)
+{
     if (H.empty())
         return cv::Rect();
 
@@ -192,19 +346,11 @@ cv::Rect ObjectLocalizer::adaptiveBoundingBox(
     const std::vector<cv::DMatch> &matches,
     const std::string &objectType)
 {
-    // Extract test points from matches
-    std::vector<cv::Point2f> testPoints;
-    for (const auto &match : matches)
-    {
-        testPoints.push_back(keypointsTest[match.trainIdx].pt);
-    }
-
-    if (testPoints.empty())
-        return cv::Rect();
-
-    // Calculate bounding box
-    cv::Rect bbox = cv::boundingRect(testPoints);
+    return adaptiveBoundingBox(keypointsTest, matches, adaptivePadding(objectType));
+}
 
+double ObjectLocalizer::adaptivePadding(const std::string &objectType)
+{
     // Balanced padding factor for all objects
     double paddingFactor = 0.18; // 18% as a balanced value
 
@@ -218,6 +364,26 @@ cv::Rect ObjectLocalizer::adaptiveBoundingBox(
     {
         paddingFactor = 0.16; // Slightly lower for bottles and boxes
     }
+    return paddingFactor;
+}
+
+cv::Rect ObjectLocalizer::adaptiveBoundingBox(
+    const std::vector<cv::KeyPoint> &keypointsTest,
+    const std::vector<cv::DMatch> &matches,
+    double paddingFactor)
+{
+    // Extract test points from matches
+    std::vector<cv::Point2f> testPoints;
+    for (const auto &match : matches)
+    {
+        testPoints.push_back(keypointsTest[match.trainIdx].pt);
+    }
+
+    if (testPoints.empty())
+        return cv::Rect();
+
+    // Calculate bounding box
+    cv::Rect bbox = cv::boundingRect(testPoints);
 
     // Apply padding
     int padX = static_cast<int>(bbox.width * paddingFactor);
@@ -4,6 +4,13 @@
 #include <opencv2/opencv.hpp>
 #include <vector>
 
+// A density mode found by mean shift
+struct MeanShiftMode
+{
+    cv::Point2f center;
+    int support = 0; // number of points that converged to this mode
+};
+
 class ObjectLocalizer
 {
 public:
@@ -18,7 +25,12 @@ public:
         const std::vector<cv::Point2f> &points,
         double maxDistance);
 
-    // Perform MeanShift clustering on points
+    // Find all mean-shift modes (flat kernel), strongest first
+    static std::vector<MeanShiftMode> findModes(
+        const std::vector<cv::Point2f> &points,
+        double bandwidth);
+
+    // Perform MeanShift clustering on points; returns the points around the strongest mode
     static std::vector<cv::Point2f> clusterMeanShift(
         const std::vector<cv::Point2f> &points,
         double bandwidth);
@@ -30,18 +42,32 @@ public:
         const cv::Scalar &color = cv::Scalar(0, 255, 0),
         int thickness = 2);
 
-    // Get bounding box using homography
+    // Get bounding box using homography (estimated from the matches)
     static cv::Rect getBoundingBoxFromHomography(
         const std::vector<cv::KeyPoint> &keypointsModel,
         const std::vector<cv::KeyPoint> &keypointsTest,
         const std::vector<cv::DMatch> &matches,
         const cv::Size &modelSize);
 
+    // Get bounding box by projecting the model corners with an already verified homography
+    static cv::Rect getBoundingBoxFromHomography(
+        const cv::Mat &H,
+        const cv::Size &modelSize);
+
     // Get adaptive bounding box with type-specific padding
     static cv::Rect adaptiveBoundingBox(
         const std::vector<cv::KeyPoint> &keypointsTest,
         const std::vector<cv::DMatch> &matches,
         const std::string &objectType);
+
+    // Get adaptive bounding box with the given padding (fraction of the box size)
+    static cv::Rect adaptiveBoundingBox(
+        const std::vector<cv::KeyPoint> &keypointsTest,
+        const std::vector<cv::DMatch> &matches,
+        double paddingFactor);
+
+    // Type-specific padding used by adaptiveBoundingBox
+    static double adaptivePadding(const std::string &objectType);
 };
 
 #endif // OBJECT_LOCALIZER_HPP
\ No newline at end of file
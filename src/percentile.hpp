@@ -0,0 +1,17 @@
+#ifndef PERCENTILE_HPP
+#define PERCENTILE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Percentile p in [0, 1] of an ascending sample (nearest rank); 0 for an empty sample
+inline double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    size_t rank = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+#endif // PERCENTILE_HPP
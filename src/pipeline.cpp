@@ -0,0 +1,362 @@
+#include "pipeline.hpp"
+#include "matching.hpp"
+#include "object_localizer.hpp"
+#include "preprocessing.hpp"
+#include "trace.hpp"
+
+DetectionParams getObjectParams(const std::string &objectKey)
+{
+    DetectionParams params;
+    // Base balanced parameters
+    params.matchesThreshold = 8;
+    params.minInliers = 5;
+    params.clusterBandwidth = 45.0;      // Intermediate value between 40 and 50
+    params.maxDistanceFromCenter = 60.0; // Intermediate value
+    params.ransacThreshold = 3.0;
+    params.ransacMethod = RansacMethod::Ransac;
+    params.boxPadding = ObjectLocalizer::adaptivePadding(objectKey);
+    params.denoise = DenoiseMode::Bilateral;
+
+    // Small adjustments per object type
+    if (objectKey.find("power_drill") != std::string::npos)
+    {
+        params.matchesThreshold = 6;
+        params.minInliers = 4;
+        params.clusterBandwidth = 50.0;      // Reduced from previous version
+        params.maxDistanceFromCenter = 70.0; // Reduced from previous version
+    }
+    else if (objectKey.find("mustard") != std::string::npos)
+    {
+        params.clusterBandwidth = 48.0;
+    }
+
+    return params;
+}
+
+const char *strategyName(LocalizationStrategy strategy)
+{
+    switch (strategy)
+    {
+    case LocalizationStrategy::Adaptive:
+        return "adaptive";
+    case LocalizationStrategy::Homography:
+        return "homography";
+    case LocalizationStrategy::Clustering:
+        return "clustering";
+    case LocalizationStrategy::Tracked:
+        return "tracked";
+    default:
+        return "none";
+    }
+}
+
+ObjectModel loadObjectModel(const IDataLoader &loader,
+                            const std::filesystem::path &root,
+                            const std::string &objectKey,
+                            const DetectionParams &params,
+                            const FeatureExtractor &extractor,
+                            const FeatureCache &cache,
+                            const GalleryParams &galleryParams)
+{
+    ObjectModel model;
+    model.key = objectKey;
+    model.params = params;
+
+    // Load model view features, from the cache when it is up to date
+    const uint64_t extractorKey = FeatureCache::extractorKey(extractor.params(), params.denoise);
+    auto viewFiles = loader.listModelViewFiles(root, objectKey);
+    model.fromCache = cache.load(objectKey, viewFiles, extractorKey, model.views);
+
+    if (!model.fromCache)
+    {
+        // Process each model view
+        for (const auto &mv : loader.loadModelViews(root, objectKey))
+        {
+            // Preprocess model image
+            cv::Mat processedModel = Preprocessing::reduceNoise(mv.gray, params.denoise);
+
+            // Detect keypoints using mask and compute descriptors
+            ImageFeatures features = extractor.extract(processedModel, mv.mask);
+
+            ViewFeatures vf;
+            vf.name = mv.name;
+            vf.keypoints = std::move(features.keypoints);
+            vf.descriptors = features.descriptors;
+            vf.maskSize = mv.mask.empty() ? mv.gray.size() : mv.mask.size();
+
+            model.views.push_back(vf);
+        }
+        cache.store(objectKey, viewFiles, extractorKey, model.views);
+    }
+
+    // Convert to the gallery format first, so views and gallery share one copy
+    // and quantized formats drop the float rows (FLANN stacks a float copy on top)
+    for (auto &vf : model.views)
+        vf.descriptors = DescriptorQuantizer::convert(vf.descriptors, galleryParams.format);
+
+    // Stack the view descriptors once; each test image is answered with one search
+    model.gallery.build(model.views, galleryParams);
+    return model;
+}
+
+ImageFeatures extractTestFeatures(const FeatureExtractor &extractor, const cv::Mat &gray,
+                                  DenoiseMode denoise)
+{
+    cv::Mat processedTestImage = Preprocessing::reduceNoise(gray, denoise);
+    return extractor.extract(processedTestImage);
+}
+
+ObjectMatches matchObject(const ObjectModel &model,
+                          const ImageFeatures &testFeatures,
+                          ThreadPool *pool)
+{
+    return matchObject(model, model.params, testFeatures, pool);
+}
+
+ObjectMatches matchObject(const ObjectModel &model,
+                          const DetectionParams &params,
+                          const ImageFeatures &testFeatures,
+                          ThreadPool *pool,
+                          const std::vector<int> *candidateViews)
+{
+    ObjectMatches matches;
+    if (testFeatures.descriptors.empty() || model.views.empty())
+        return matches;
+
+    // Cheap first stage: shortlist the views worth full matching
+    std::vector<int> views;
+    if (candidateViews)
+    {
+        views = *candidateViews;
+    }
+    else if (model.gallery.shortlistEnabled())
+    {
+        TRACE_SCOPE("shortlist");
+        views = model.gallery.shortlist(testFeatures.descriptors);
+        TRACE_COUNTER("shortlist_views", views.size());
+    }
+    else
+    {
+        views.resize(model.views.size());
+        for (size_t m = 0; m < views.size(); ++m)
+            views[m] = static_cast<int>(m);
+    }
+
+    // Match descriptors against the selected views at once
+    {
+        TRACE_SCOPE("match");
+        matches.viewMatches = model.gallery.matchViews(testFeatures.descriptors, 0.75f, &views);
+    }
+    for (int m : views)
+        TRACE_COUNTER("view_matches", matches.viewMatches[m].size());
+
+    // Estimate the homography and its inliers for every selected view
+    matches.viewVerification.resize(matches.viewMatches.size());
+    TRACE_CAPTURE_IMAGE(traceImage);
+    auto verifyView = [&](size_t i)
+    {
+        TRACE_IMAGE(traceImage); // the view may run on another pool thread
+        const int m = views[i];
+        matches.viewVerification[m] = Matching::verifyHomography(
+            model.views[m].keypoints, testFeatures.keypoints, matches.viewMatches[m],
+            params.ransacThreshold, params.ransacMethod);
+    };
+    if (pool)
+        pool->parallelFor(0, views.size(), verifyView);
+    else
+        for (size_t i = 0; i < views.size(); ++i)
+            verifyView(i);
+
+    return matches;
+}
+
+DetectionResult localizeObject(const ObjectModel &model,
+                               const ImageFeatures &testFeatures,
+                               const ObjectMatches &matches,
+                               const cv::Size &imageSize)
+{
+    return localizeObject(model, model.params, testFeatures, matches, imageSize);
+}
+
+DetectionResult localizeObject(const ObjectModel &model,
+                               const DetectionParams &params,
+                               const ImageFeatures &testFeatures,
+                               const ObjectMatches &matches,
+                               const cv::Size &imageSize)
+{
+    TRACE_SCOPE("localize");
+    const auto &kpTest = testFeatures.keypoints;
+
+    DetectionResult result;
+    result.objectKey = model.key;
+    if (matches.viewMatches.empty())
+        return result;
+
+    // Find the best matching model view
+    size_t bestModelIdx = 0;
+    int maxGoodMatches = 0;
+
+    for (size_t m = 0; m < matches.viewMatches.size(); ++m)
+    {
+        const auto &goodMatches = matches.viewMatches[m];
+        const auto &inlierMatches = matches.viewVerification[m].inliers;
+
+        result.viewStats.push_back({model.views[m].name, goodMatches.size(), inlierMatches.size()});
+
+        // Track the best model view
+        if ((int)goodMatches.size() > maxGoodMatches)
+        {
+            maxGoodMatches = goodMatches.size();
+            bestModelIdx = m;
+        }
+    }
+
+    const std::vector<cv::DMatch> &bestMatches = matches.viewMatches[bestModelIdx];
+    const GeometricVerification &bestVerification = matches.viewVerification[bestModelIdx];
+    const std::vector<cv::DMatch> &bestInliers = bestVerification.inliers;
+
+    result.bestView = static_cast<int>(bestModelIdx);
+    result.matches = maxGoodMatches;
+    result.inliers = bestInliers.size();
+
+    // Not enough matches
+    if (maxGoodMatches < params.matchesThreshold)
+        return result;
+
+    const ViewFeatures &bestView = model.views[bestModelIdx];
+    cv::Rect detectedBox;
+
+    // Try different strategies in order of preference
+
+    // 1. Try adaptive bounding box (works well for power_drill)
+    if (model.key.find("power_drill") != std::string::npos)
+    {
+        detectedBox = ObjectLocalizer::adaptiveBoundingBox(
+            kpTest, (int)bestInliers.size() >= params.minInliers ? bestInliers : bestMatches, params.boxPadding);
+
+        if (detectedBox.width > 0 && detectedBox.height > 0)
+        {
+            result.strategy = LocalizationStrategy::Adaptive;
+        }
+    }
+
+    // 2. Try homography (usually the best); reuses the estimate of the verification step
+    if (result.strategy == LocalizationStrategy::None && (int)bestInliers.size() >= params.minInliers)
+    {
+        detectedBox = ObjectLocalizer::getBoundingBoxFromHomography(bestVerification.H, bestView.maskSize);
+
+        if (detectedBox.width > 0 && detectedBox.height > 0 &&
+            detectedBox.width < 600 && detectedBox.height < 600)
+        {
+            result.strategy = LocalizationStrategy::Homography;
+        }
+    }
+
+    // 3. Fallback to clustering
+    if (result.strategy == LocalizationStrategy::None)
+    {
+        // Use matches with the strongest confidence
+        const std::vector<cv::DMatch> &matchesToUse = bestInliers.size() >= 4 ? bestInliers : bestMatches;
+
+        std::vector<cv::Point2f> testPoints = ObjectLocalizer::extractDetectedPoints(
+            bestView.keypoints, kpTest, matchesToUse);
+
+        // Filter and cluster points
+        auto filteredPoints = ObjectLocalizer::filterPointsByDistance(
+            testPoints, params.maxDistanceFromCenter);
+        auto clusteredPoints = ObjectLocalizer::clusterMeanShift(
+            filteredPoints, params.clusterBandwidth);
+
+        if (!clusteredPoints.empty())
+        {
+            detectedBox = cv::boundingRect(clusteredPoints);
+
+            // Expand the bounding box with a balanced value
+            int padding = std::max(5, std::min(detectedBox.width, detectedBox.height) / 6); // ~16%
+            detectedBox.x = std::max(0, detectedBox.x - padding);
+            detectedBox.y = std::max(0, detectedBox.y - padding);
+            detectedBox.width = std::min(imageSize.width - detectedBox.x, detectedBox.width + 2 * padding);
+            detectedBox.height = std::min(imageSize.height - detectedBox.y, detectedBox.height + 2 * padding);
+
+            result.strategy = LocalizationStrategy::Clustering;
+            result.clusterPoints = std::move(clusteredPoints);
+        }
+    }
+
+    TRACE_LABEL("strategy", strategyName(result.strategy));
+    result.detected = result.strategy != LocalizationStrategy::None;
+    if (result.detected)
+        result.box = detectedBox;
+    return result;
+}
+
+cv::Mat coarseImage(const cv::Mat &gray, double scale)
+{
+    cv::Mat small;
+    cv::resize(gray, small, cv::Size(), scale, scale, cv::INTER_AREA);
+    return small;
+}
+
+DetectionResult refineDetection(const ObjectModel &model,
+                                const DetectionParams &params,
+                                const FeatureExtractor &extractor,
+                                const cv::Mat &gray,
+                                const DetectionResult &coarse,
+                                const CoarseToFineParams &coarseToFine,
+                                ThreadPool *pool,
+                                size_t *finePixels)
+{
+    TRACE_SCOPE("refine");
+    if (finePixels)
+        *finePixels = 0;
+
+    // Map the coarse result to full-resolution coordinates
+    DetectionResult scaled = coarse;
+    const double inv = 1.0 / coarseToFine.scale;
+    scaled.box = cv::Rect(cvRound(coarse.box.x * inv), cvRound(coarse.box.y * inv),
+                          cvRound(coarse.box.width * inv), cvRound(coarse.box.height * inv));
+    for (auto &pt : scaled.clusterPoints)
+        pt *= static_cast<float>(inv);
+    if (!coarse.detected)
+        return scaled;
+
+    // Region of interest: the coarse box plus a margin, inside the image
+    int mx = cvRound(scaled.box.width * coarseToFine.roiMargin);
+    int my = cvRound(scaled.box.height * coarseToFine.roiMargin);
+    cv::Rect roi(scaled.box.x - mx, scaled.box.y - my, scaled.box.width + 2 * mx, scaled.box.height + 2 * my);
+    roi &= cv::Rect(0, 0, gray.cols, gray.rows);
+    if (roi.width < 16 || roi.height < 16)
+        return scaled;
+    if (finePixels)
+        *finePixels = static_cast<size_t>(roi.area());
+
+    // Only the ROI is filtered and described; a mask on the full image would still build
+    // the whole SIFT pyramid. Keypoints are moved back to image coordinates.
+    ImageFeatures fine = extractTestFeatures(extractor, gray(roi), params.denoise);
+    for (auto &kp : fine.keypoints)
+    {
+        kp.pt.x += roi.x;
+        kp.pt.y += roi.y;
+    }
+    TRACE_COUNTER("refine_keypoints", fine.keypoints.size());
+    if (fine.descriptors.empty())
+        return scaled;
+
+    // Match only the views with at least half the coarse matches of the best one
+    std::vector<int> views;
+    for (size_t m = 0; m < coarse.viewStats.size(); ++m)
+        if (2 * static_cast<int>(coarse.viewStats[m].goodMatches) >= coarse.matches)
+            views.push_back(static_cast<int>(m));
+    ObjectMatches matches = matchObject(model, params, fine, pool, views.empty() ? nullptr : &views);
+    DetectionResult refined = localizeObject(model, params, fine, matches, gray.size());
+    return refined.detected ? refined : scaled;
+}
+
+DetectionResult detectObject(const ObjectModel &model,
+                             const ImageFeatures &testFeatures,
+                             const cv::Size &imageSize,
+                             ThreadPool *pool)
+{
+    ObjectMatches matches = matchObject(model, testFeatures, pool);
+    return localizeObject(model, testFeatures, matches, imageSize);
+}
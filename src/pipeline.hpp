@@ -0,0 +1,156 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <opencv2/opencv.hpp>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "dataloader.hpp"
+#include "detection.hpp"
+#include "feature_cache.hpp"
+#include "gallery_index.hpp"
+#include "matching.hpp"
+#include "preprocessing.hpp"
+#include "thread_pool.hpp"
+
+// Balanced parameters for all objects
+struct DetectionParams
+{
+    int matchesThreshold;
+    int minInliers;
+    double clusterBandwidth;
+    double maxDistanceFromCenter;
+    double ransacThreshold;
+    RansacMethod ransacMethod; // estimator of the view homographies
+    double boxPadding;   // padding of the adaptive box, as a fraction of its size
+    DenoiseMode denoise; // preprocessing applied to model views and test images
+};
+
+// Get the detection parameters for an object
+DetectionParams getObjectParams(const std::string &objectKey);
+
+// A registered object: its parameters, model-view features and gallery index
+struct ObjectModel
+{
+    std::string key;
+    DetectionParams params;
+    std::vector<ViewFeatures> views;
+    GalleryIndex gallery;
+    bool fromCache = false; // features were loaded from the feature cache
+};
+
+// Strategy that produced the bounding box
+enum class LocalizationStrategy
+{
+    None,
+    Adaptive,
+    Homography,
+    Clustering,
+    Tracked // followed from the last keyframe by optical flow (sequence mode)
+};
+
+const char *strategyName(LocalizationStrategy strategy);
+
+// Match statistics of a single model view
+struct ViewMatchStats
+{
+    std::string name;
+    size_t goodMatches = 0;
+    size_t inliers = 0;
+};
+
+// Result of searching one object in one test image
+struct DetectionResult
+{
+    std::string objectKey;
+    bool detected = false;
+    cv::Rect box;
+    LocalizationStrategy strategy = LocalizationStrategy::None;
+    int bestView = -1;
+    int matches = 0;                         // good matches of the best view
+    size_t inliers = 0;                      // RANSAC inliers of the best view
+    std::vector<ViewMatchStats> viewStats;   // per-view statistics
+    std::vector<cv::Point2f> clusterPoints;  // points used by the clustering fallback
+};
+
+// Matches of a test image against every view of one object
+struct ObjectMatches
+{
+    std::vector<std::vector<cv::DMatch>> viewMatches; // ratio-test matches per view
+    std::vector<GeometricVerification> viewVerification; // homography and inliers per view
+};
+
+// Coarse-to-fine search: detect on a downscaled test image, then extract
+// full-resolution features only around the coarse box to refine it
+struct CoarseToFineParams
+{
+    bool enabled = false;
+    double scale = 0.5;     // size of the coarse image relative to the test image
+    double roiMargin = 0.25; // margin added around the coarse box, as a fraction of its size
+};
+
+// Load (or extract and cache) the model-view features of an object and index them
+ObjectModel loadObjectModel(const IDataLoader &loader,
+                            const std::filesystem::path &root,
+                            const std::string &objectKey,
+                            const DetectionParams &params,
+                            const FeatureExtractor &extractor,
+                            const FeatureCache &cache,
+                            const GalleryParams &galleryParams = GalleryParams());
+
+// Preprocess a grayscale test image and extract its features
+ImageFeatures extractTestFeatures(const FeatureExtractor &extractor, const cv::Mat &gray,
+                                  DenoiseMode denoise = DenoiseMode::Bilateral);
+
+// Downscale a grayscale test image for the coarse pass
+cv::Mat coarseImage(const cv::Mat &gray, double scale);
+
+// Refine a detection made on the coarse image: extract full-resolution features in the
+// coarse box grown by roiMargin, then match and localize again. Returns the coarse
+// result mapped to full resolution if it was not detected or the refinement fails.
+// finePixels (optional) receives the number of full-resolution pixels processed.
+DetectionResult refineDetection(const ObjectModel &model,
+                                const DetectionParams &params,
+                                const FeatureExtractor &extractor,
+                                const cv::Mat &gray,
+                                const DetectionResult &coarse,
+                                const CoarseToFineParams &coarseToFine,
+                                ThreadPool *pool = nullptr,
+                                size_t *finePixels = nullptr);
+
+// Match a test image against all views of an object and verify each view with RANSAC.
+// With a pool, the per-view RANSAC runs in parallel.
+ObjectMatches matchObject(const ObjectModel &model,
+                          const ImageFeatures &testFeatures,
+                          ThreadPool *pool = nullptr);
+
+// matchObject with parameters other than the model's own (e.g. for parameter sweeps).
+// An explicit list of view indices (e.g. from the vocabulary tree) replaces the shortlist.
+ObjectMatches matchObject(const ObjectModel &model,
+                          const DetectionParams &params,
+                          const ImageFeatures &testFeatures,
+                          ThreadPool *pool = nullptr,
+                          const std::vector<int> *candidateViews = nullptr);
+
+// Pick the best view and localize the object with the fallback strategies
+DetectionResult localizeObject(const ObjectModel &model,
+                               const ImageFeatures &testFeatures,
+                               const ObjectMatches &matches,
+                               const cv::Size &imageSize);
+
+// localizeObject with parameters other than the model's own
+DetectionResult localizeObject(const ObjectModel &model,
+                               const DetectionParams &params,
+                               const ImageFeatures &testFeatures,
+                               const ObjectMatches &matches,
+                               const cv::Size &imageSize);
+
+// Search one object in a test image whose features were already extracted
+// (matchObject followed by localizeObject).
+// With a pool, the per-view RANSAC runs in parallel.
+DetectionResult detectObject(const ObjectModel &model,
+                             const ImageFeatures &testFeatures,
+                             const cv::Size &imageSize,
+                             ThreadPool *pool = nullptr);
+
+#endif // PIPELINE_HPP
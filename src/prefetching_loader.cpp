@@ -0,0 +1,175 @@
+#include "prefetching_loader.hpp"
+#include <algorithm>
+#include <cstdio>
+
+PrefetchingDataLoader::PrefetchingDataLoader(const IDataLoader &base, const PrefetchParams &params)
+    : base_(base), params_(params), pool_(std::max<size_t>(1, params.threads))
+{
+}
+
+PrefetchingDataLoader::~PrefetchingDataLoader()
+{
+    // Queued decodes that have not started yet are skipped
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+}
+
+IntegrityCode PrefetchingDataLoader::checkIntegrity(const std::filesystem::path &root) const
+{
+    return base_.checkIntegrity(root);
+}
+
+std::vector<std::string> PrefetchingDataLoader::listObjectKeys(const std::filesystem::path &root) const
+{
+    return base_.listObjectKeys(root);
+}
+
+std::vector<ModelViewFiles>
+PrefetchingDataLoader::listModelViewFiles(const std::filesystem::path &root, const std::string &objectKey) const
+{
+    return base_.listModelViewFiles(root, objectKey);
+}
+
+// Decode the views of the object in parallel on the I/O pool
+std::vector<ModelView>
+PrefetchingDataLoader::loadModelViews(const std::filesystem::path &root, const std::string &objectKey) const
+{
+    std::vector<ModelViewFiles> files = base_.listModelViewFiles(root, objectKey);
+    std::vector<ModelView> views(files.size());
+    pool_.parallelFor(0, files.size(), [&](size_t i)
+                      { views[i] = base_.loadModelView(files[i]); });
+    views.erase(std::remove_if(views.begin(), views.end(), [](const ModelView &mv)
+                               { return mv.gray.empty(); }),
+                views.end());
+    return views;
+}
+
+ModelView PrefetchingDataLoader::loadModelView(const ModelViewFiles &files) const
+{
+    return base_.loadModelView(files);
+}
+
+std::vector<TestImage>
+PrefetchingDataLoader::listTestImages(const std::filesystem::path &root, const std::string &objectKey) const
+{
+    return base_.listTestImages(root, objectKey);
+}
+
+std::vector<GroundTruthBox>
+PrefetchingDataLoader::loadLabels(const std::filesystem::path &root, const std::string &objectKey,
+                                  const TestImage &image) const
+{
+    return base_.loadLabels(root, objectKey, image);
+}
+
+std::string PrefetchingDataLoader::cacheKey(const TestImage &image, double scale)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "@%.4f", scale);
+    return image.path.string() + buf;
+}
+
+void PrefetchingDataLoader::prefetch(const std::vector<TestImage> &order, double scale) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    order_ = order;
+    orderIndex_.clear();
+    for (size_t i = 0; i < order_.size(); ++i)
+        orderIndex_.emplace(cacheKey(order_[i], scale), i);
+    orderScale_ = scale;
+    scheduled_ = 0;
+    scheduleLocked(params_.lookahead);
+}
+
+cv::Mat PrefetchingDataLoader::loadTestImage(const TestImage &image, double scale) const
+{
+    const std::string key = cacheKey(image, scale);
+    std::shared_future<cv::Mat> decoding;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // Keep the I/O threads `lookahead` images ahead of this one
+        auto at = orderIndex_.find(key);
+        if (at != orderIndex_.end())
+            scheduleLocked(at->second + 1 + params_.lookahead);
+
+        auto it = cache_.find(key);
+        if (it != cache_.end())
+        {
+            ++stats_.hits;
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return it->second->image;
+        }
+        auto pending = pending_.find(key);
+        if (pending != pending_.end())
+        {
+            ++stats_.waits;
+            decoding = pending->second;
+        }
+        else
+        {
+            ++stats_.misses;
+        }
+    }
+    if (decoding.valid())
+        return decoding.get();
+
+    cv::Mat decoded = base_.loadTestImage(image, scale);
+    std::lock_guard<std::mutex> lock(mutex_);
+    insertLocked(key, decoded);
+    return decoded;
+}
+
+void PrefetchingDataLoader::scheduleLocked(size_t upTo) const
+{
+    const double scale = orderScale_;
+    for (upTo = std::min(upTo, order_.size()); scheduled_ < upTo; ++scheduled_)
+    {
+        const TestImage image = order_[scheduled_];
+        const std::string key = cacheKey(image, scale);
+        if (cache_.count(key) || pending_.count(key))
+            continue;
+        // The task takes the lock only after this function has registered it
+        pending_[key] = pool_.submit([this, image, key, scale]
+                                     {
+                                         {
+                                             std::lock_guard<std::mutex> lock(mutex_);
+                                             if (stopping_)
+                                             {
+                                                 pending_.erase(key);
+                                                 return cv::Mat();
+                                             }
+                                         }
+                                         cv::Mat decoded = base_.loadTestImage(image, scale);
+                                         std::lock_guard<std::mutex> lock(mutex_);
+                                         insertLocked(key, decoded);
+                                         pending_.erase(key);
+                                         return decoded;
+                                     })
+                            .share();
+    }
+}
+
+void PrefetchingDataLoader::insertLocked(const std::string &key, const cv::Mat &image) const
+{
+    const size_t bytes = image.total() * image.elemSize();
+    if (image.empty() || bytes > params_.cacheBytes || cache_.count(key))
+        return;
+    lru_.push_front({key, image});
+    cache_[key] = lru_.begin();
+    stats_.cachedBytes += bytes;
+    while (stats_.cachedBytes > params_.cacheBytes)
+    {
+        const CacheEntry &old = lru_.back();
+        stats_.cachedBytes -= old.image.total() * old.image.elemSize();
+        cache_.erase(old.key);
+        lru_.pop_back();
+        ++stats_.evictions;
+    }
+}
+
+PrefetchStats PrefetchingDataLoader::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
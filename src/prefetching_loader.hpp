@@ -0,0 +1,90 @@
+#ifndef PREFETCHING_LOADER_HPP
+#define PREFETCHING_LOADER_HPP
+
+#include <opencv2/opencv.hpp>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "dataloader.hpp"
+#include "thread_pool.hpp"
+
+// Settings of the prefetching loader
+struct PrefetchParams
+{
+    size_t threads = 4;             // I/O threads decoding ahead of the consumer
+    size_t lookahead = 8;           // test images decoded ahead of the last one loaded
+    size_t cacheBytes = 512u << 20; // decoded test images kept (LRU)
+};
+
+// Counters of the prefetching loader
+struct PrefetchStats
+{
+    size_t hits = 0;      // image was decoded and cached
+    size_t waits = 0;     // image was being decoded; the consumer waited for it
+    size_t misses = 0;    // image was decoded on the consumer thread
+    size_t evictions = 0; // images dropped from the cache
+    size_t cachedBytes = 0;
+};
+
+// Wraps another loader: decodes the model views of an object in parallel, decodes test
+// images `lookahead` ahead of the consumer (in the order given to prefetch()) on an I/O
+// pool, and keeps decoded test images in a size-bounded LRU cache, so repeated passes
+// over a dataset do not decode again. Listings and labels come from the wrapped loader.
+class PrefetchingDataLoader : public IDataLoader
+{
+public:
+    explicit PrefetchingDataLoader(const IDataLoader &base, const PrefetchParams &params = PrefetchParams());
+    ~PrefetchingDataLoader() override;
+
+    PrefetchingDataLoader(const PrefetchingDataLoader &) = delete;
+    PrefetchingDataLoader &operator=(const PrefetchingDataLoader &) = delete;
+
+    IntegrityCode checkIntegrity(const std::filesystem::path &root) const override;
+    std::vector<std::string> listObjectKeys(const std::filesystem::path &root) const override;
+    std::vector<ModelViewFiles>
+    listModelViewFiles(const std::filesystem::path &root, const std::string &objectKey) const override;
+    std::vector<ModelView>
+    loadModelViews(const std::filesystem::path &root, const std::string &objectKey) const override;
+    ModelView loadModelView(const ModelViewFiles &files) const override;
+    std::vector<TestImage>
+    listTestImages(const std::filesystem::path &root, const std::string &objectKey) const override;
+    cv::Mat loadTestImage(const TestImage &image, double scale = 1.0) const override;
+    void prefetch(const std::vector<TestImage> &order, double scale = 1.0) const override;
+    std::vector<GroundTruthBox>
+    loadLabels(const std::filesystem::path &root, const std::string &objectKey, const TestImage &image) const override;
+
+    PrefetchStats stats() const;
+
+private:
+    struct CacheEntry
+    {
+        std::string key;
+        cv::Mat image;
+    };
+
+    static std::string cacheKey(const TestImage &image, double scale);
+    void scheduleLocked(size_t upTo) const; // schedule order_ up to index upTo
+    void insertLocked(const std::string &key, const cv::Mat &image) const;
+
+    const IDataLoader &base_;
+    PrefetchParams params_;
+
+    mutable std::mutex mutex_;
+    mutable std::list<CacheEntry> lru_; // most recently used first
+    mutable std::unordered_map<std::string, std::list<CacheEntry>::iterator> cache_;
+    mutable std::unordered_map<std::string, std::shared_future<cv::Mat>> pending_;
+    mutable std::vector<TestImage> order_; // prefetch order
+    mutable std::unordered_map<std::string, size_t> orderIndex_;
+    mutable double orderScale_ = 1.0;
+    mutable size_t scheduled_ = 0;         // images of order_ scheduled so far
+    mutable PrefetchStats stats_;
+    mutable bool stopping_ = false;
+
+    // Last member: destroyed first, so queued decodes finish while the cache exists
+    mutable ThreadPool pool_;
+};
+
+#endif // PREFETCHING_LOADER_HPP
@@ -1,7 +1,40 @@
 #include "preprocessing.hpp"
 #include <opencv2/opencv.hpp>
+#include <cmath>
 #include <iostream>
 
+const char *denoiseModeName(DenoiseMode mode)
+{
+    switch (mode)
+    {
+    case DenoiseMode::BilateralDownscaled:
+        return "bilateral-half";
+    case DenoiseMode::Guided:
+        return "guided";
+    case DenoiseMode::Recursive:
+        return "recursive";
+    case DenoiseMode::None:
+        return "none";
+    default:
+        return "bilateral";
+    }
+}
+
+bool parseDenoiseMode(const std::string &name, DenoiseMode &mode)
+{
+    const DenoiseMode modes[] = {DenoiseMode::Bilateral, DenoiseMode::BilateralDownscaled,
+                                 DenoiseMode::Guided, DenoiseMode::Recursive, DenoiseMode::None};
+    for (DenoiseMode m : modes)
+    {
+        if (name == denoiseModeName(m))
+        {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
+
 Preprocessing::Preprocessing() {}
 
 Preprocessing::~Preprocessing() {}
@@ -38,4 +71,132 @@ cv::Mat Preprocessing::reduceNoise(const cv::Mat &img)
     // Apply a bilateral filter to reduce noise while preserving edges
     cv::bilateralFilter(img, result, 9, 75, 75);
     return result;
-}
\ No newline at end of file
+}
+
+// Reduce noise with the selected mode
+cv::Mat Preprocessing::reduceNoise(const cv::Mat &img, DenoiseMode mode)
+{
+    switch (mode)
+    {
+    case DenoiseMode::BilateralDownscaled:
+        return bilateralDownscaled(img);
+    case DenoiseMode::Guided:
+        return guidedFilter(img, 4, 0.01 * 255 * 255);
+    case DenoiseMode::Recursive:
+        return recursiveFilter(img, 9.0, 75.0, 2);
+    case DenoiseMode::None:
+        return img;
+    default:
+        return reduceNoise(img);
+    }
+}
+
+// Bilateral filter at half resolution (a quarter of the pixels), then upsampled
+cv::Mat Preprocessing::bilateralDownscaled(const cv::Mat &img)
+{
+    cv::Mat small, filtered, result;
+    cv::resize(img, small, cv::Size(), 0.5, 0.5, cv::INTER_AREA);
+    // Spatial extent halves together with the image
+    cv::bilateralFilter(small, filtered, 5, 75, 37.5);
+    cv::resize(filtered, result, img.size(), 0, 0, cv::INTER_LINEAR);
+    return result;
+}
+
+// Self-guided filter (He et al.): local linear model q = a * I + b fitted in
+// (2r+1)^2 windows; eps sets how strong an edge must be to be preserved
+cv::Mat Preprocessing::guidedFilter(const cv::Mat &img, int radius, double eps)
+{
+    cv::Mat I;
+    img.convertTo(I, CV_32F);
+    cv::Size window(2 * radius + 1, 2 * radius + 1);
+
+    cv::Mat meanI, meanII;
+    cv::boxFilter(I, meanI, CV_32F, window);
+    cv::boxFilter(I.mul(I), meanII, CV_32F, window);
+    cv::Mat varI = meanII - meanI.mul(meanI);
+
+    cv::Mat a = varI / (varI + eps);
+    cv::Mat b = meanI - a.mul(meanI);
+
+    cv::Mat meanA, meanB;
+    cv::boxFilter(a, meanA, CV_32F, window);
+    cv::boxFilter(b, meanB, CV_32F, window);
+
+    cv::Mat q = meanA.mul(I) + meanB;
+    cv::Mat result;
+    q.convertTo(result, img.type());
+    return result;
+}
+
+// Domain-transform recursive filter (Gastal and Oliveira): horizontal and
+// vertical first-order recursive passes whose feedback weight drops across
+// edges; sigmaSpace/sigmaRange play the same role as in the bilateral filter
+cv::Mat Preprocessing::recursiveFilter(const cv::Mat &img, double sigmaSpace, double sigmaRange, int iterations)
+{
+    CV_Assert(img.channels() == 1);
+    cv::Mat J;
+    img.convertTo(J, CV_32F);
+    const int rows = J.rows, cols = J.cols;
+
+    // Domain-transform derivative: 1 + sigmaSpace / sigmaRange * |dI|, from the input image
+    const float ratio = static_cast<float>(sigmaSpace / sigmaRange);
+    cv::Mat dH(rows, cols, CV_32F), dV(rows, cols, CV_32F);
+    for (int y = 0; y < rows; ++y)
+    {
+        const float *row = J.ptr<float>(y);
+        const float *next = J.ptr<float>(std::min(y + 1, rows - 1));
+        float *h = dH.ptr<float>(y);
+        float *v = dV.ptr<float>(y);
+        for (int x = 0; x < cols; ++x)
+        {
+            h[x] = 1.0f + ratio * std::abs(row[std::min(x + 1, cols - 1)] - row[x]);
+            v[x] = 1.0f + ratio * std::abs(next[x] - row[x]);
+        }
+    }
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        // Per-iteration spatial sigma so the iterations add up to sigmaSpace
+        double sigmaH = sigmaSpace * std::sqrt(3.0) * std::pow(2.0, iterations - (i + 1)) /
+                        std::sqrt(std::pow(4.0, iterations) - 1);
+        const double logA = -std::sqrt(2.0) / sigmaH;
+
+        // Feedback weights a^d, evaluated for the whole image in one vectorised call
+        cv::Mat wH, wV;
+        cv::exp(dH * logA, wH);
+        cv::exp(dV * logA, wV);
+
+        // Horizontal passes
+        for (int y = 0; y < rows; ++y)
+        {
+            float *row = J.ptr<float>(y);
+            const float *w = wH.ptr<float>(y);
+            for (int x = 1; x < cols; ++x)
+                row[x] += w[x - 1] * (row[x - 1] - row[x]);
+            for (int x = cols - 2; x >= 0; --x)
+                row[x] += w[x] * (row[x + 1] - row[x]);
+        }
+
+        // Vertical passes, row by row to stay cache friendly
+        for (int y = 1; y < rows; ++y)
+        {
+            float *row = J.ptr<float>(y);
+            const float *prev = J.ptr<float>(y - 1);
+            const float *w = wV.ptr<float>(y - 1);
+            for (int x = 0; x < cols; ++x)
+                row[x] += w[x] * (prev[x] - row[x]);
+        }
+        for (int y = rows - 2; y >= 0; --y)
+        {
+            float *row = J.ptr<float>(y);
+            const float *next = J.ptr<float>(y + 1);
+            const float *w = wV.ptr<float>(y);
+            for (int x = 0; x < cols; ++x)
+                row[x] += w[x] * (next[x] - row[x]);
+        }
+    }
+
+    cv::Mat result;
+    J.convertTo(result, img.type());
+    return result;
+}
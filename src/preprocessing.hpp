@@ -4,6 +4,21 @@
 #include <opencv2/opencv.hpp>
 #include <string>
 
+// Edge-preserving denoise applied before feature extraction
+enum class DenoiseMode
+{
+    Bilateral,           // full-resolution bilateral filter (d = 9)
+    BilateralDownscaled, // bilateral filter at half resolution, then upsampled
+    Guided,              // self-guided filter (box filters, O(1) per pixel)
+    Recursive,           // domain-transform recursive filter (separable passes)
+    None                 // no filtering
+};
+
+const char *denoiseModeName(DenoiseMode mode);
+
+// Parse a mode name as printed by denoiseModeName; returns false for unknown names
+bool parseDenoiseMode(const std::string &name, DenoiseMode &mode);
+
 class Preprocessing
 {
 public:
@@ -18,6 +33,14 @@ public:
 
     // Reduce noise using bilateral filter
     static cv::Mat reduceNoise(const cv::Mat &img);
+
+    // Reduce noise with the selected mode
+    static cv::Mat reduceNoise(const cv::Mat &img, DenoiseMode mode);
+
+private:
+    static cv::Mat bilateralDownscaled(const cv::Mat &img);
+    static cv::Mat guidedFilter(const cv::Mat &img, int radius, double eps);
+    static cv::Mat recursiveFilter(const cv::Mat &img, double sigmaSpace, double sigmaRange, int iterations);
 };
 
-#endif // PREPROCESSING_HPP
\ No newline at end of file
+#endif // PREPROCESSING_HPP
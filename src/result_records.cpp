@@ -0,0 +1,27 @@
+#include "result_records.hpp"
+
+ObjectRecord makeObjectRecord(const DetectionResult &result)
+{
+    ObjectRecord o;
+    o.objectKey = result.objectKey;
+    o.detected = result.detected;
+    o.box = result.box;
+    o.matches = result.matches;
+    o.inliers = result.inliers;
+    o.strategy = strategyName(result.strategy);
+    if (result.bestView >= 0 && result.bestView < (int)result.viewStats.size())
+        o.bestView = result.viewStats[result.bestView].name;
+    return o;
+}
+
+ImageRecord makeImageRecord(const std::string &image, const ImageDetections &detections)
+{
+    ImageRecord record;
+    record.image = image;
+    record.error = detections.error;
+    record.keypoints = detections.keypoints;
+    record.timings = detections.timings;
+    for (const auto &result : detections.objects)
+        record.objects.push_back(makeObjectRecord(result));
+    return record;
+}
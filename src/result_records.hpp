@@ -0,0 +1,14 @@
+#ifndef RESULT_RECORDS_HPP
+#define RESULT_RECORDS_HPP
+
+#include <string>
+#include "detector.hpp"
+#include "results_writer.hpp"
+
+// Structured record of a detection result
+ObjectRecord makeObjectRecord(const DetectionResult &result);
+
+// Structured record of the detections of one image
+ImageRecord makeImageRecord(const std::string &image, const ImageDetections &detections);
+
+#endif // RESULT_RECORDS_HPP
@@ -0,0 +1,195 @@
+#include "result_renderer.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include "image_io.hpp"
+#include "object_localizer.hpp"
+#include "result_records.hpp"
+#include "trace.hpp"
+
+const char *renderModeName(RenderMode mode)
+{
+    switch (mode)
+    {
+    case RenderMode::Off:
+        return "off";
+    case RenderMode::Json:
+        return "json";
+    default:
+        return "annotated";
+    }
+}
+
+bool parseRenderMode(const std::string &name, RenderMode &mode)
+{
+    if (name == "off")
+        mode = RenderMode::Off;
+    else if (name == "json")
+        mode = RenderMode::Json;
+    else if (name == "annotated")
+        mode = RenderMode::Annotated;
+    else
+        return false;
+    return true;
+}
+
+ResultRenderer::ResultRenderer(const RenderOptions &options, const IDataLoader *loader)
+    : options_(options), loader_(loader)
+{
+    if (options_.mode == RenderMode::Off)
+        return;
+    options_.queueDepth = std::max<size_t>(1, options_.queueDepth);
+    for (size_t i = 0; i < std::max<size_t>(1, options_.threads); ++i)
+        threads_.emplace_back([this]
+                              { run(); });
+}
+
+ResultRenderer::~ResultRenderer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &thread : threads_)
+        thread.join();
+}
+
+void ResultRenderer::submit(RenderTask &&task)
+{
+    if (options_.mode == RenderMode::Off || task.results.empty())
+        return;
+    {
+        // Backpressure: detection waits rather than piling up decoded images
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_.wait(lock, [this]
+                    { return queue_.size() < options_.queueDepth; });
+        queue_.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+void ResultRenderer::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    drained_.wait(lock, [this]
+                  { return queue_.empty() && busy_ == 0; });
+}
+
+size_t ResultRenderer::written() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_;
+}
+
+size_t ResultRenderer::failed() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_;
+}
+
+double ResultRenderer::renderMs() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return renderMs_;
+}
+
+void ResultRenderer::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        wake_.wait(lock, [this]
+                   { return stop_ || !queue_.empty(); });
+        if (queue_.empty() && stop_)
+            break;
+
+        RenderTask task = std::move(queue_.front());
+        queue_.pop_front();
+        ++busy_;
+        lock.unlock();
+        space_.notify_one();
+
+        // A failed task is reported and counted; it must not end the thread or the
+        // queue would never drain
+        auto start = std::chrono::steady_clock::now();
+        bool ok = false;
+        try
+        {
+            ok = render(task);
+            if (!ok)
+                std::cerr << "Failed to render result of " << task.source.string() << std::endl;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Failed to render result of " << task.source.string() << ": " << e.what() << std::endl;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        lock.lock();
+        --busy_;
+        if (ok)
+            ++written_;
+        else
+            ++failed_;
+        renderMs_ += ms;
+        if (queue_.empty() && busy_ == 0)
+            drained_.notify_all();
+    }
+}
+
+bool ResultRenderer::render(const RenderTask &task) const
+{
+    TRACE_SCOPE("render");
+    const std::string stem = "result_" + task.source.stem().string();
+
+    if (options_.mode == RenderMode::Json)
+    {
+        ImageRecord record;
+        record.image = task.source.filename().string();
+        for (const auto &result : task.results)
+            record.objects.push_back(makeObjectRecord(result));
+        std::string line;
+        appendRecord(record, ResultsFormat::Jsonl, line);
+        std::ofstream out(task.outDir / (stem + ".json"), std::ios::binary);
+        out << line;
+        return static_cast<bool>(out);
+    }
+
+    cv::Mat image = readImage(task.source);
+    if (image.empty() && loader_)
+    {
+        // No colour file: draw on the plane the detector saw
+        cv::Mat gray = loader_->loadTestImage(TestImage{task.source, task.source.filename().string()});
+        if (!gray.empty())
+            cv::cvtColor(gray, image, cv::COLOR_GRAY2BGR);
+    }
+    if (image.empty())
+        return false;
+    for (const auto &result : task.results)
+    {
+        // The clustering fallback also shows the rotated box around the clustered points
+        if (result.strategy == LocalizationStrategy::Clustering)
+            ObjectLocalizer::drawBox(image, result.clusterPoints, cv::Scalar(255, 128, 0), 2);
+
+        const cv::Rect &box = result.box;
+        cv::rectangle(image, box, cv::Scalar(0, 255, 0), 2);
+        if (task.labels)
+            cv::putText(image, result.objectKey, cv::Point(box.x, std::max(0, box.y - 5)),
+                        cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 0), 1);
+    }
+
+    const std::string ext = options_.format.empty() ? task.source.extension().string() : "." + options_.format;
+    std::string codec = ext;
+    std::transform(codec.begin(), codec.end(), codec.begin(), ::tolower);
+    std::vector<int> params;
+    if (codec == ".jpg" || codec == ".jpeg")
+        params = {cv::IMWRITE_JPEG_QUALITY, options_.quality};
+    else if (codec == ".webp")
+        params = {cv::IMWRITE_WEBP_QUALITY, std::max(1, options_.quality)};
+    else if (codec == ".png")
+        params = {cv::IMWRITE_PNG_COMPRESSION, std::min(9, std::max(0, (100 - options_.quality) / 10))};
+    return cv::imwrite((task.outDir / (stem + ext)).string(), image, params);
+}
@@ -0,0 +1,93 @@
+#ifndef RESULT_RENDERER_HPP
+#define RESULT_RENDERER_HPP
+
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dataloader.hpp"
+#include "pipeline.hpp"
+
+// What the renderer writes for each image with detections
+enum class RenderMode
+{
+    Off,      // nothing (headless runs)
+    Json,     // result_<name>.json with the boxes, no image decode or encode
+    Annotated // result_<name> image with the boxes drawn
+};
+
+const char *renderModeName(RenderMode mode);
+bool parseRenderMode(const std::string &name, RenderMode &mode);
+
+// Settings of the result renderer
+struct RenderOptions
+{
+    RenderMode mode = RenderMode::Annotated;
+    std::string format;   // image extension without the dot (empty = that of the test image)
+    int quality = 95;     // JPEG/WebP quality; PNG maps it to a compression level
+    size_t threads = 2;   // encoder threads
+    size_t queueDepth = 32; // images waiting to be rendered before submit() blocks
+};
+
+// One image to render
+struct RenderTask
+{
+    std::filesystem::path source; // test image, decoded in colour by the renderer (see ResultRenderer)
+    std::filesystem::path outDir;
+    std::vector<DetectionResult> results; // detected objects
+    bool labels = false;                  // draw the object key above each box
+};
+
+// Draws and encodes result images on background threads. submit() only queues the
+// task (blocking while the queue is full); the test image is decoded in colour, drawn
+// on and encoded once, off the detection threads. If the file cannot be read (e.g. the
+// dataset is read from a pack), the grayscale image of the loader is drawn on instead.
+class ResultRenderer
+{
+public:
+    // loader must outlive the renderer (nullptr = files only)
+    explicit ResultRenderer(const RenderOptions &options, const IDataLoader *loader = nullptr);
+    ~ResultRenderer();
+
+    ResultRenderer(const ResultRenderer &) = delete;
+    ResultRenderer &operator=(const ResultRenderer &) = delete;
+
+    const RenderOptions &options() const { return options_; }
+
+    // Queue an image; does nothing in Off mode or without detections
+    void submit(RenderTask &&task);
+
+    // Wait until everything queued so far is written
+    void flush();
+
+    // Files written, tasks that failed (unreadable image, failed write or exception)
+    // and the time spent rendering them [ms], summed over the threads
+    size_t written() const;
+    size_t failed() const;
+    double renderMs() const;
+
+private:
+    void run();
+    bool render(const RenderTask &task) const; // false if nothing was written
+
+    RenderOptions options_;
+    const IDataLoader *loader_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;    // a task was queued or stop was requested
+    std::condition_variable space_;   // a task was taken
+    std::condition_variable drained_; // the queue is empty and no task is being rendered
+    std::deque<RenderTask> queue_;
+    size_t busy_ = 0;
+    bool stop_ = false;
+    size_t written_ = 0;
+    size_t failed_ = 0;
+    double renderMs_ = 0.0;
+    std::vector<std::thread> threads_;
+};
+
+#endif // RESULT_RENDERER_HPP
@@ -0,0 +1,233 @@
+#include "results_writer.hpp"
+#include <cstdio>
+#include "text_escape.hpp"
+
+const char *resultsFormatName(ResultsFormat format)
+{
+    return format == ResultsFormat::Csv ? "csv" : "jsonl";
+}
+
+bool parseResultsFormat(const std::string &name, ResultsFormat &format)
+{
+    if (name == "jsonl")
+        format = ResultsFormat::Jsonl;
+    else if (name == "csv")
+        format = ResultsFormat::Csv;
+    else
+        return false;
+    return true;
+}
+
+const char *verbosityName(Verbosity verbosity)
+{
+    switch (verbosity)
+    {
+    case Verbosity::Summary:
+        return "summary";
+    case Verbosity::Detail:
+        return "detail";
+    default:
+        return "quiet";
+    }
+}
+
+bool parseVerbosity(const std::string &name, Verbosity &verbosity)
+{
+    const Verbosity levels[] = {Verbosity::Quiet, Verbosity::Summary, Verbosity::Detail};
+    for (Verbosity v : levels)
+    {
+        if (name == verbosityName(v))
+        {
+            verbosity = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace
+{
+    void appendNumber(std::string &out, double value)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.3f", value);
+        out += buf;
+    }
+
+    const char *kCsvHeader = "image,error,keypoints,object,detected,xmin,ymin,xmax,ymax,matches,inliers,"
+                             "strategy,best_view,decode_ms,preprocess_ms,features_ms,match_ms,localize_ms,"
+                             "encode_ms,total_ms\n";
+}
+
+ResultsWriter::ResultsWriter(const std::string &path, ResultsFormat format)
+    : out_(path, std::ios::binary), format_(format)
+{
+    if (!out_.is_open())
+        return;
+    if (format_ == ResultsFormat::Csv)
+        out_ << csvHeader();
+    thread_ = std::thread([this]
+                          { run(); });
+}
+
+ResultsWriter::~ResultsWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void ResultsWriter::submit(ImageRecord &&record)
+{
+    if (!out_.is_open())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(record));
+    }
+    wake_.notify_one();
+}
+
+void ResultsWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    drained_.wait(lock, [this]
+                  { return queue_.empty() && !busy_; });
+    out_.flush();
+}
+
+size_t ResultsWriter::written() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_;
+}
+
+void ResultsWriter::run()
+{
+    std::string buffer;
+    std::deque<ImageRecord> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        wake_.wait(lock, [this]
+                   { return stop_ || !queue_.empty(); });
+        if (queue_.empty() && stop_)
+            break;
+
+        // Take everything queued and format it outside the lock
+        batch.swap(queue_);
+        busy_ = true;
+        lock.unlock();
+
+        buffer.clear();
+        for (const auto &record : batch)
+            appendRecord(record, format_, buffer);
+        out_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+
+        lock.lock();
+        written_ += batch.size();
+        batch.clear();
+        busy_ = false;
+        drained_.notify_all();
+    }
+    out_.flush();
+}
+
+const char *csvHeader()
+{
+    return kCsvHeader;
+}
+
+void appendRecord(const ImageRecord &record, ResultsFormat format, std::string &out)
+{
+    const StageTimings &t = record.timings;
+    if (format == ResultsFormat::Jsonl)
+    {
+        out += "{\"image\":";
+        appendJsonString(out, record.image);
+        if (!record.error.empty())
+        {
+            out += ",\"error\":";
+            appendJsonString(out, record.error);
+        }
+        out += ",\"keypoints\":" + std::to_string(record.keypoints);
+        out += ",\"objects\":[";
+        for (size_t i = 0; i < record.objects.size(); ++i)
+        {
+            const ObjectRecord &o = record.objects[i];
+            out += i ? ",{\"object\":" : "{\"object\":";
+            appendJsonString(out, o.objectKey);
+            out += o.detected ? ",\"detected\":true" : ",\"detected\":false";
+            if (o.detected)
+            {
+                out += ",\"box\":[" + std::to_string(o.box.x) + "," + std::to_string(o.box.y) + "," +
+                       std::to_string(o.box.x + o.box.width) + "," + std::to_string(o.box.y + o.box.height) + "]";
+            }
+            out += ",\"matches\":" + std::to_string(o.matches);
+            out += ",\"inliers\":" + std::to_string(o.inliers);
+            out += ",\"strategy\":";
+            appendJsonString(out, o.strategy);
+            out += ",\"best_view\":";
+            appendJsonString(out, o.bestView);
+            out += "}";
+        }
+        out += "],\"timings_ms\":{\"decode\":";
+        appendNumber(out, t.decodeMs);
+        out += ",\"preprocess\":";
+        appendNumber(out, t.preprocessMs);
+        out += ",\"features\":";
+        appendNumber(out, t.featuresMs);
+        out += ",\"match\":";
+        appendNumber(out, t.matchMs);
+        out += ",\"localize\":";
+        appendNumber(out, t.localizeMs);
+        out += ",\"encode\":";
+        appendNumber(out, t.encodeMs);
+        out += ",\"total\":";
+        appendNumber(out, t.totalMs());
+        out += "}}\n";
+        return;
+    }
+
+    // CSV: one row per object, or a single row without object columns
+    auto row = [&](const ObjectRecord *o)
+    {
+        appendCsvField(out, record.image);
+        out += ',';
+        appendCsvField(out, record.error);
+        out += ',' + std::to_string(record.keypoints) + ',';
+        if (o)
+        {
+            appendCsvField(out, o->objectKey);
+            out += o->detected ? ",1," : ",0,";
+            if (o->detected)
+                out += std::to_string(o->box.x) + ',' + std::to_string(o->box.y) + ',' +
+                       std::to_string(o->box.x + o->box.width) + ',' + std::to_string(o->box.y + o->box.height);
+            else
+                out += ",,,";
+            out += ',' + std::to_string(o->matches) + ',' + std::to_string(o->inliers) + ',';
+            appendCsvField(out, o->strategy);
+            out += ',';
+            appendCsvField(out, o->bestView);
+        }
+        else
+        {
+            out += ",,,,,,,,,";
+        }
+        const double ms[] = {t.decodeMs, t.preprocessMs, t.featuresMs, t.matchMs, t.localizeMs, t.encodeMs, t.totalMs()};
+        for (double v : ms)
+        {
+            out += ',';
+            appendNumber(out, v);
+        }
+        out += '\n';
+    };
+    if (record.objects.empty())
+        row(nullptr);
+    for (const auto &o : record.objects)
+        row(&o);
+}
@@ -0,0 +1,102 @@
+#ifndef RESULTS_WRITER_HPP
+#define RESULTS_WRITER_HPP
+
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "stage_timings.hpp"
+
+// Output file format of the results writer
+enum class ResultsFormat
+{
+    Jsonl, // one JSON object per line
+    Csv    // one row per (image, object)
+};
+
+const char *resultsFormatName(ResultsFormat format);
+bool parseResultsFormat(const std::string &name, ResultsFormat &format);
+
+// How much text goes to the console and the text log
+enum class Verbosity
+{
+    Quiet,   // errors and run summaries only
+    Summary, // plus one line per image
+    Detail   // plus per-view match statistics (the former default output)
+};
+
+const char *verbosityName(Verbosity verbosity);
+bool parseVerbosity(const std::string &name, Verbosity &verbosity);
+
+// Search result of one object in an image
+struct ObjectRecord
+{
+    std::string objectKey;
+    bool detected = false;
+    cv::Rect box;
+    int matches = 0;
+    size_t inliers = 0;
+    std::string strategy;
+    std::string bestView;
+};
+
+// Everything recorded for one test image
+struct ImageRecord
+{
+    std::string image;
+    std::string error; // empty unless the image could not be processed
+    size_t keypoints = 0;
+    StageTimings timings;
+    std::vector<ObjectRecord> objects;
+};
+
+// Append one record as a JSON line or as CSV rows (one per object)
+void appendRecord(const ImageRecord &record, ResultsFormat format, std::string &out);
+
+// Header line of the CSV format
+const char *csvHeader();
+
+// Writes image records to a JSONL or CSV file from a background thread.
+// submit() only queues the record; the writer thread formats whole batches
+// and writes each batch with a single call.
+class ResultsWriter
+{
+public:
+    ResultsWriter(const std::string &path, ResultsFormat format);
+    ~ResultsWriter();
+
+    ResultsWriter(const ResultsWriter &) = delete;
+    ResultsWriter &operator=(const ResultsWriter &) = delete;
+
+    bool isOpen() const { return out_.is_open(); }
+
+    // Queue a record for writing
+    void submit(ImageRecord &&record);
+
+    // Write everything queued so far and flush the file
+    void flush();
+
+    // Records written so far
+    size_t written() const;
+
+private:
+    void run();
+
+    std::ofstream out_;
+    ResultsFormat format_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable drained_;
+    std::deque<ImageRecord> queue_;
+    bool busy_ = false;
+    bool stop_ = false;
+    size_t written_ = 0;
+    std::thread thread_;
+};
+
+#endif // RESULTS_WRITER_HPP
@@ -0,0 +1,445 @@
+#include "simd_matcher.hpp"
+#include <cmath>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_MATCHER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Rows of the query matrix processed together, sharing each train row load
+    constexpr int kQueryBlock = 4;
+
+    // Running best and second-best squared distance of one query row
+    struct Top2
+    {
+        float best = std::numeric_limits<float>::infinity();
+        float second = std::numeric_limits<float>::infinity();
+        int bestIdx = -1;
+
+        inline void update(float d, int idx)
+        {
+            if (d < best)
+            {
+                second = best;
+                best = d;
+                bestIdx = idx;
+            }
+            else if (d < second)
+            {
+                second = d;
+            }
+        }
+    };
+
+    inline void emit(const Top2 &t, int queryIdx, float ratioSq, std::vector<cv::DMatch> &out)
+    {
+        // Distances are squared, so the ratio is squared too
+        if (t.bestIdx >= 0 && t.best < ratioSq * t.second)
+            out.emplace_back(queryIdx, t.bestIdx, std::sqrt(t.best));
+    }
+
+    void matchScalar(const cv::Mat &query, const cv::Mat &train, float ratioSq, std::vector<cv::DMatch> &out)
+    {
+        const int dims = query.cols;
+        for (int q = 0; q < query.rows; ++q)
+        {
+            const float *qp = query.ptr<float>(q);
+            Top2 top;
+            for (int t = 0; t < train.rows; ++t)
+            {
+                const float *tp = train.ptr<float>(t);
+                float d = 0.0f;
+                for (int k = 0; k < dims; ++k)
+                {
+                    float diff = qp[k] - tp[k];
+                    d += diff * diff;
+                }
+                top.update(d, t);
+            }
+            emit(top, q, ratioSq, out);
+        }
+    }
+
+    void matchScalarU8(const cv::Mat &query, const cv::Mat &train, float ratioSq, std::vector<cv::DMatch> &out)
+    {
+        const int dims = query.cols;
+        for (int q = 0; q < query.rows; ++q)
+        {
+            const uchar *qp = query.ptr<uchar>(q);
+            Top2 top;
+            for (int t = 0; t < train.rows; ++t)
+            {
+                const uchar *tp = train.ptr<uchar>(t);
+                uint32_t d = 0;
+                for (int k = 0; k < dims; ++k)
+                {
+                    int diff = int(qp[k]) - int(tp[k]);
+                    d += uint32_t(diff * diff);
+                }
+                // Integer distances stay exact in float (128 * 255^2 < 2^24)
+                top.update(static_cast<float>(d), t);
+            }
+            emit(top, q, ratioSq, out);
+        }
+    }
+
+#ifdef SIMD_MATCHER_X86
+    __attribute__((target("avx2,fma"))) inline float hsum256(__m256 v)
+    {
+        __m128 lo = _mm256_castps256_ps128(v);
+        __m128 hi = _mm256_extractf128_ps(v, 1);
+        lo = _mm_add_ps(lo, hi);
+        lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+        lo = _mm_add_ss(lo, _mm_movehdup_ps(lo));
+        return _mm_cvtss_f32(lo);
+    }
+
+    // Blocks of kQueryBlock query rows against every train row; dims % 8 == 0
+    __attribute__((target("avx2,fma"))) void matchAvx2(const cv::Mat &query, const cv::Mat &train,
+                                                       float ratioSq, std::vector<cv::DMatch> &out)
+    {
+        const int dims = query.cols;
+        int q = 0;
+        for (; q + kQueryBlock <= query.rows; q += kQueryBlock)
+        {
+            const float *q0 = query.ptr<float>(q);
+            const float *q1 = query.ptr<float>(q + 1);
+            const float *q2 = query.ptr<float>(q + 2);
+            const float *q3 = query.ptr<float>(q + 3);
+            Top2 top[kQueryBlock];
+
+            for (int t = 0; t < train.rows; ++t)
+            {
+                const float *tp = train.ptr<float>(t);
+                __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+                __m256 a2 = _mm256_setzero_ps(), a3 = _mm256_setzero_ps();
+                for (int k = 0; k < dims; k += 8)
+                {
+                    __m256 tv = _mm256_loadu_ps(tp + k);
+                    __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(q0 + k), tv);
+                    __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(q1 + k), tv);
+                    __m256 d2 = _mm256_sub_ps(_mm256_loadu_ps(q2 + k), tv);
+                    __m256 d3 = _mm256_sub_ps(_mm256_loadu_ps(q3 + k), tv);
+                    a0 = _mm256_fmadd_ps(d0, d0, a0);
+                    a1 = _mm256_fmadd_ps(d1, d1, a1);
+                    a2 = _mm256_fmadd_ps(d2, d2, a2);
+                    a3 = _mm256_fmadd_ps(d3, d3, a3);
+                }
+                top[0].update(hsum256(a0), t);
+                top[1].update(hsum256(a1), t);
+                top[2].update(hsum256(a2), t);
+                top[3].update(hsum256(a3), t);
+            }
+            for (int b = 0; b < kQueryBlock; ++b)
+                emit(top[b], q + b, ratioSq, out);
+        }
+
+        // Remaining rows one at a time
+        for (; q < query.rows; ++q)
+        {
+            const float *qp = query.ptr<float>(q);
+            Top2 top;
+            for (int t = 0; t < train.rows; ++t)
+            {
+                const float *tp = train.ptr<float>(t);
+                __m256 acc = _mm256_setzero_ps();
+                for (int k = 0; k < dims; k += 8)
+                {
+                    __m256 d = _mm256_sub_ps(_mm256_loadu_ps(qp + k), _mm256_loadu_ps(tp + k));
+                    acc = _mm256_fmadd_ps(d, d, acc);
+                }
+                top.update(hsum256(acc), t);
+            }
+            emit(top, q, ratioSq, out);
+        }
+    }
+
+    __attribute__((target("avx2"))) inline uint32_t hsum256i(__m256i v)
+    {
+        __m128i lo = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+        lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(lo));
+    }
+
+    // acc += sum((a - b)^2) over 32 unsigned bytes
+    __attribute__((target("avx2"))) inline __m256i sqdiffU8(__m256i a, __m256i b, __m256i acc)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i d = _mm256_sub_epi8(_mm256_max_epu8(a, b), _mm256_min_epu8(a, b));
+        __m256i lo = _mm256_unpacklo_epi8(d, zero);
+        __m256i hi = _mm256_unpackhi_epi8(d, zero);
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(lo, lo));
+        return _mm256_add_epi32(acc, _mm256_madd_epi16(hi, hi));
+    }
+
+    // Integer squared L2 on uint8 rows, kQueryBlock query rows per train row; dims % 32 == 0
+    __attribute__((target("avx2"))) void matchAvx2U8(const cv::Mat &query, const cv::Mat &train,
+                                                     float ratioSq, std::vector<cv::DMatch> &out)
+    {
+        const int dims = query.cols;
+        int q = 0;
+        for (; q + kQueryBlock <= query.rows; q += kQueryBlock)
+        {
+            const uchar *q0 = query.ptr<uchar>(q);
+            const uchar *q1 = query.ptr<uchar>(q + 1);
+            const uchar *q2 = query.ptr<uchar>(q + 2);
+            const uchar *q3 = query.ptr<uchar>(q + 3);
+            Top2 top[kQueryBlock];
+
+            for (int t = 0; t < train.rows; ++t)
+            {
+                const uchar *tp = train.ptr<uchar>(t);
+                __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+                __m256i a2 = _mm256_setzero_si256(), a3 = _mm256_setzero_si256();
+                for (int k = 0; k < dims; k += 32)
+                {
+                    __m256i tv = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tp + k));
+                    a0 = sqdiffU8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(q0 + k)), tv, a0);
+                    a1 = sqdiffU8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(q1 + k)), tv, a1);
+                    a2 = sqdiffU8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(q2 + k)), tv, a2);
+                    a3 = sqdiffU8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(q3 + k)), tv, a3);
+                }
+                top[0].update(static_cast<float>(hsum256i(a0)), t);
+                top[1].update(static_cast<float>(hsum256i(a1)), t);
+                top[2].update(static_cast<float>(hsum256i(a2)), t);
+                top[3].update(static_cast<float>(hsum256i(a3)), t);
+            }
+            for (int b = 0; b < kQueryBlock; ++b)
+                emit(top[b], q + b, ratioSq, out);
+        }
+
+        for (; q < query.rows; ++q)
+        {
+            const uchar *qp = query.ptr<uchar>(q);
+            Top2 top;
+            for (int t = 0; t < train.rows; ++t)
+            {
+                const uchar *tp = train.ptr<uchar>(t);
+                __m256i acc = _mm256_setzero_si256();
+                for (int k = 0; k < dims; k += 32)
+                    acc = sqdiffU8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(qp + k)),
+                                   _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tp + k)), acc);
+                top.update(static_cast<float>(hsum256i(acc)), t);
+            }
+            emit(top, q, ratioSq, out);
+        }
+    }
+
+    // acc += sum((a - b)^2) over 64 unsigned bytes
+    __attribute__((target("avx512f,avx512bw"))) inline __m512i sqdiffU8x64(__m512i a, __m512i b, __m512i acc)
+    {
+        const __m512i zero = _mm512_setzero_si512();
+        __m512i d = _mm512_sub_epi8(_mm512_max_epu8(a, b), _mm512_min_epu8(a, b));
+        __m512i lo = _mm512_unpacklo_epi8(d, zero);
+        __m512i hi = _mm512_unpackhi_epi8(d, zero);
+        acc = _mm512_add_epi32(acc, _mm512_madd_epi16(lo, lo));
+        return _mm512_add_epi32(acc, _mm512_madd_epi16(hi, hi));
+    }
+
+    // Integer squared L2 with 512-bit registers; dims % 64 == 0
+    __attribute__((target("avx512f,avx512bw"))) void matchAvx512U8(const cv::Mat &query, const cv::Mat &train,
+                                                                   float ratioSq, std::vector<cv::DMatch> &out)
+    {
+        const int dims = query.cols;
+        int q = 0;
+        for (; q + kQueryBlock <= query.rows; q += kQueryBlock)
+        {
+            const uchar *q0 = query.ptr<uchar>(q);
+            const uchar *q1 = query.ptr<uchar>(q + 1);
+            const uchar *q2 = query.ptr<uchar>(q + 2);
+            const uchar *q3 = query.ptr<uchar>(q + 3);
+            Top2 top[kQueryBlock];
+
+            for (int t = 0; t < train.rows; ++t)
+            {
+                const uchar *tp = train.ptr<uchar>(t);
+                __m512i a0 = _mm512_setzero_si512(), a1 = _mm512_setzero_si512();
+                __m512i a2 = _mm512_setzero_si512(), a3 = _mm512_setzero_si512();
+                for (int k = 0; k < dims; k += 64)
+                {
+                    __m512i tv = _mm512_loadu_si512(tp + k);
+                    a0 = sqdiffU8x64(_mm512_loadu_si512(q0 + k), tv, a0);
+                    a1 = sqdiffU8x64(_mm512_loadu_si512(q1 + k), tv, a1);
+                    a2 = sqdiffU8x64(_mm512_loadu_si512(q2 + k), tv, a2);
+                    a3 = sqdiffU8x64(_mm512_loadu_si512(q3 + k), tv, a3);
+                }
+                top[0].update(static_cast<float>(_mm512_reduce_add_epi32(a0)), t);
+                top[1].update(static_cast<float>(_mm512_reduce_add_epi32(a1)), t);
+                top[2].update(static_cast<float>(_mm512_reduce_add_epi32(a2)), t);
+                top[3].update(static_cast<float>(_mm512_reduce_add_epi32(a3)), t);
+            }
+            for (int b = 0; b < kQueryBlock; ++b)
+                emit(top[b], q + b, ratioSq, out);
+        }
+
+        for (; q < query.rows; ++q)
+        {
+            const uchar *qp = query.ptr<uchar>(q);
+            Top2 top;
+            for (int t = 0; t < train.rows; ++t)
+            {
+                const uchar *tp = train.ptr<uchar>(t);
+                __m512i acc = _mm512_setzero_si512();
+                for (int k = 0; k < dims; k += 64)
+                    acc = sqdiffU8x64(_mm512_loadu_si512(qp + k), _mm512_loadu_si512(tp + k), acc);
+                top.update(static_cast<float>(_mm512_reduce_add_epi32(acc)), t);
+            }
+            emit(top, q, ratioSq, out);
+        }
+    }
+
+    // Same blocking with 512-bit registers; dims % 16 == 0
+    __attribute__((target("avx512f"))) void matchAvx512(const cv::Mat &query, const cv::Mat &train,
+                                                        float ratioSq, std::vector<cv::DMatch> &out)
+    {
+        const int dims = query.cols;
+        int q = 0;
+        for (; q + kQueryBlock <= query.rows; q += kQueryBlock)
+        {
+            const float *q0 = query.ptr<float>(q);
+            const float *q1 = query.ptr<float>(q + 1);
+            const float *q2 = query.ptr<float>(q + 2);
+            const float *q3 = query.ptr<float>(q + 3);
+            Top2 top[kQueryBlock];
+
+            for (int t = 0; t < train.rows; ++t)
+            {
+                const float *tp = train.ptr<float>(t);
+                __m512 a0 = _mm512_setzero_ps(), a1 = _mm512_setzero_ps();
+                __m512 a2 = _mm512_setzero_ps(), a3 = _mm512_setzero_ps();
+                for (int k = 0; k < dims; k += 16)
+                {
+                    __m512 tv = _mm512_loadu_ps(tp + k);
+                    __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(q0 + k), tv);
+                    __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(q1 + k), tv);
+                    __m512 d2 = _mm512_sub_ps(_mm512_loadu_ps(q2 + k), tv);
+                    __m512 d3 = _mm512_sub_ps(_mm512_loadu_ps(q3 + k), tv);
+                    a0 = _mm512_fmadd_ps(d0, d0, a0);
+                    a1 = _mm512_fmadd_ps(d1, d1, a1);
+                    a2 = _mm512_fmadd_ps(d2, d2, a2);
+                    a3 = _mm512_fmadd_ps(d3, d3, a3);
+                }
+                top[0].update(_mm512_reduce_add_ps(a0), t);
+                top[1].update(_mm512_reduce_add_ps(a1), t);
+                top[2].update(_mm512_reduce_add_ps(a2), t);
+                top[3].update(_mm512_reduce_add_ps(a3), t);
+            }
+            for (int b = 0; b < kQueryBlock; ++b)
+                emit(top[b], q + b, ratioSq, out);
+        }
+
+        for (; q < query.rows; ++q)
+        {
+            const float *qp = query.ptr<float>(q);
+            Top2 top;
+            for (int t = 0; t < train.rows; ++t)
+            {
+                const float *tp = train.ptr<float>(t);
+                __m512 acc = _mm512_setzero_ps();
+                for (int k = 0; k < dims; k += 16)
+                {
+                    __m512 d = _mm512_sub_ps(_mm512_loadu_ps(qp + k), _mm512_loadu_ps(tp + k));
+                    acc = _mm512_fmadd_ps(d, d, acc);
+                }
+                top.update(_mm512_reduce_add_ps(acc), t);
+            }
+            emit(top, q, ratioSq, out);
+        }
+    }
+#endif
+}
+
+SimdMatcher::Isa SimdMatcher::detectIsa()
+{
+#ifdef SIMD_MATCHER_X86
+    static const Isa isa = []
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+            return Isa::Avx512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return Isa::Avx2;
+        return Isa::Scalar;
+    }();
+    return isa;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+const char *SimdMatcher::isaName(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::Avx512:
+        return "avx512";
+    case Isa::Avx2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+void SimdMatcher::matchRatio(const cv::Mat &query,
+                             const cv::Mat &train,
+                             float nndrRatio,
+                             std::vector<cv::DMatch> &out)
+{
+    matchRatio(query, train, nndrRatio, out, detectIsa());
+}
+
+void SimdMatcher::matchRatio(const cv::Mat &query,
+                             const cv::Mat &train,
+                             float nndrRatio,
+                             std::vector<cv::DMatch> &out,
+                             Isa isa)
+{
+    out.clear();
+    // The ratio test needs two neighbours
+    if (query.empty() || train.rows < 2)
+        return;
+    CV_Assert(query.type() == train.type() && query.cols == train.cols);
+    CV_Assert(query.type() == CV_32F || query.type() == CV_8U);
+
+    const float ratioSq = nndrRatio * nndrRatio;
+
+    // Unsupported or unaligned widths use the scalar kernel
+    if (isa > detectIsa())
+        isa = detectIsa();
+
+    if (query.type() == CV_8U)
+    {
+#ifdef SIMD_MATCHER_X86
+        if (isa == Isa::Avx512 && query.cols % 64 == 0)
+        {
+            matchAvx512U8(query, train, ratioSq, out);
+            return;
+        }
+        if (isa >= Isa::Avx2 && query.cols % 32 == 0)
+        {
+            matchAvx2U8(query, train, ratioSq, out);
+            return;
+        }
+#endif
+        matchScalarU8(query, train, ratioSq, out);
+        return;
+    }
+
+#ifdef SIMD_MATCHER_X86
+    if (isa == Isa::Avx512 && query.cols % 16 == 0)
+    {
+        matchAvx512(query, train, ratioSq, out);
+        return;
+    }
+    if (isa >= Isa::Avx2 && query.cols % 8 == 0)
+    {
+        matchAvx2(query, train, ratioSq, out);
+        return;
+    }
+#endif
+    matchScalar(query, train, ratioSq, out);
+}
@@ -0,0 +1,41 @@
+#ifndef SIMD_MATCHER_HPP
+#define SIMD_MATCHER_HPP
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Fused brute-force top-2 L2 matcher with the NNDR test applied inline, for
+// float descriptors and for uint8 descriptors (exact integer distances). Only the two best distances per query row are kept, and
+// surviving matches are written straight to the output (no kNN lists).
+// The kernel is picked at runtime: AVX-512, AVX2+FMA or portable scalar code.
+class SimdMatcher
+{
+public:
+    enum class Isa
+    {
+        Scalar,
+        Avx2,
+        Avx512
+    };
+
+    // Best instruction set supported by this CPU
+    static Isa detectIsa();
+    static const char *isaName(Isa isa);
+
+    // For every query row find its two nearest train rows and keep the match
+    // if best < nndrRatio * secondBest. Both matrices must have the same type
+    // (CV_32F or CV_8U) and width; queryIdx/trainIdx index their rows.
+    static void matchRatio(const cv::Mat &query,
+                           const cv::Mat &train,
+                           float nndrRatio,
+                           std::vector<cv::DMatch> &out);
+
+    // Same, forcing a specific kernel (falls back to scalar if unsupported)
+    static void matchRatio(const cv::Mat &query,
+                           const cv::Mat &train,
+                           float nndrRatio,
+                           std::vector<cv::DMatch> &out,
+                           Isa isa);
+};
+
+#endif // SIMD_MATCHER_HPP
@@ -0,0 +1,320 @@
+#ifndef STAGE_PIPELINE_HPP
+#define STAGE_PIPELINE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Bounded multi-producer/multi-consumer lock-free queue (Vyukov ring buffer).
+// Capacity is rounded up to a power of two.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        mask_ = size - 1;
+        cells_ = std::make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; ++i)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Approximate number of queued items
+    size_t size() const
+    {
+        size_t tail = enqueuePos_.load(std::memory_order_relaxed);
+        size_t head = dequeuePos_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool tryPush(T &value)
+    {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell &cell = cells_[pos & mask_];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false; // full
+            else
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPop(T &value)
+    {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell &cell = cells_[pos & mask_];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = std::move(cell.value);
+                    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false; // empty
+            else
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> enqueuePos_{0};
+    alignas(64) std::atomic<size_t> dequeuePos_{0};
+};
+
+// Runtime statistics of one pipeline stage and its input queue
+struct StageStats
+{
+    std::string name;
+    size_t workers = 0;
+    size_t queueCapacity = 0;
+    size_t processed = 0;        // items handled by the stage
+    size_t failures = 0;         // items whose stage function threw
+    double meanOccupancy = 0.0;  // mean input queue depth seen by producers
+    size_t maxOccupancy = 0;     // deepest input queue observed
+    size_t producerWaits = 0;    // pushes that hit a full queue (backpressure)
+    size_t consumerWaits = 0;    // pops that found the queue empty (starvation)
+    double busySeconds = 0.0;    // total time spent in the stage function
+};
+
+// Linear pipeline of stages joined by bounded lock-free queues. Each stage has
+// its own worker threads and input queue; a full queue blocks its producers.
+// Items are passed as unique_ptr, so moving through a queue is cheap.
+// An exception thrown by a stage is caught per item: the error handler is called
+// and the item moves on, so later stages and the shutdown still run.
+template <typename T>
+class StagePipeline
+{
+public:
+    using Item = std::unique_ptr<T>;
+    using StageFn = std::function<void(T &)>;
+    using ErrorFn = std::function<void(T &, const std::string &stage, const std::string &error)>;
+
+    // Called on the worker thread when a stage throws, typically to mark the item failed
+    void setErrorHandler(ErrorFn fn) { onError_ = std::move(fn); }
+
+    // Add a stage; stages run in the order they are added
+    void addStage(const std::string &name, size_t workers, size_t queueCapacity, StageFn fn)
+    {
+        auto stage = std::make_unique<Stage>(queueCapacity);
+        stage->name = name;
+        stage->workers = std::max<size_t>(1, workers);
+        stage->fn = std::move(fn);
+        stages_.push_back(std::move(stage));
+    }
+
+    // Feed items from source until it returns an empty pointer and run every stage to completion
+    void run(const std::function<Item()> &source)
+    {
+        if (stages_.empty())
+            return;
+
+        std::vector<std::thread> threads;
+        for (size_t s = 0; s < stages_.size(); ++s)
+            stages_[s]->activeWorkers = stages_[s]->workers;
+        for (size_t s = 0; s < stages_.size(); ++s)
+        {
+            for (size_t w = 0; w < stages_[s]->workers; ++w)
+                threads.emplace_back(&StagePipeline::worker, this, s);
+        }
+
+        // The calling thread is the source
+        while (Item item = source())
+            push(*stages_[0], std::move(item));
+        finish(0);
+
+        for (auto &t : threads)
+            t.join();
+    }
+
+    // Snapshot of the per-stage statistics
+    std::vector<StageStats> stats() const
+    {
+        std::vector<StageStats> out;
+        for (const auto &stage : stages_)
+        {
+            StageStats st;
+            st.name = stage->name;
+            st.workers = stage->workers;
+            st.queueCapacity = stage->queue.capacity();
+            st.processed = stage->processed.load();
+            st.failures = stage->failures.load();
+            size_t pushes = stage->pushes.load();
+            st.meanOccupancy = pushes ? static_cast<double>(stage->occupancySum.load()) / pushes : 0.0;
+            st.maxOccupancy = stage->maxOccupancy.load();
+            st.producerWaits = stage->producerWaits.load();
+            st.consumerWaits = stage->consumerWaits.load();
+            st.busySeconds = stage->busyNanos.load() * 1e-9;
+            out.push_back(st);
+        }
+        return out;
+    }
+
+private:
+    struct Stage
+    {
+        explicit Stage(size_t capacity) : queue(capacity) {}
+
+        std::string name;
+        size_t workers = 1;
+        StageFn fn;
+        BoundedQueue<Item> queue;
+        std::atomic<bool> inputClosed{false};   // no more items will be pushed
+        std::atomic<size_t> activeWorkers{0};
+
+        std::atomic<size_t> processed{0};
+        std::atomic<size_t> failures{0};
+        std::atomic<size_t> pushes{0};
+        std::atomic<size_t> occupancySum{0};
+        std::atomic<size_t> maxOccupancy{0};
+        std::atomic<size_t> producerWaits{0};
+        std::atomic<size_t> consumerWaits{0};
+        std::atomic<long long> busyNanos{0};
+    };
+
+    static void backoff(unsigned &spins)
+    {
+        if (++spins < 64)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    void push(Stage &stage, Item item)
+    {
+        size_t depth = stage.queue.size();
+        stage.pushes++;
+        stage.occupancySum += depth;
+        size_t prevMax = stage.maxOccupancy.load();
+        while (depth > prevMax && !stage.maxOccupancy.compare_exchange_weak(prevMax, depth))
+        {
+        }
+
+        unsigned spins = 0;
+        bool waited = false;
+        while (!stage.queue.tryPush(item))
+        {
+            waited = true;
+            backoff(spins);
+        }
+        if (waited)
+            stage.producerWaits++;
+    }
+
+    // Run the stage function on one item; an exception is reported, never propagated
+    void process(Stage &stage, T &item)
+    {
+        std::string error;
+        try
+        {
+            stage.fn(item);
+            return;
+        }
+        catch (const std::exception &e)
+        {
+            error = e.what();
+        }
+        catch (...)
+        {
+            error = "unknown exception";
+        }
+        stage.failures++;
+        if (!onError_)
+            return;
+        try
+        {
+            onError_(item, stage.name, error);
+        }
+        catch (...)
+        {
+        }
+    }
+
+    // Called once all producers of stage s are done
+    void finish(size_t s)
+    {
+        stages_[s]->inputClosed.store(true, std::memory_order_release);
+    }
+
+    void worker(size_t s)
+    {
+        Stage &stage = *stages_[s];
+
+        Item item;
+        unsigned spins = 0;
+        for (;;)
+        {
+            if (stage.queue.tryPop(item))
+            {
+                spins = 0;
+                auto start = std::chrono::steady_clock::now();
+                process(stage, *item);
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                stage.busyNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+                stage.processed++;
+
+                if (s + 1 < stages_.size())
+                    push(*stages_[s + 1], std::move(item));
+                else
+                    item.reset();
+                continue;
+            }
+
+            // Closed and drained: this worker is done
+            if (stage.inputClosed.load(std::memory_order_acquire) && stage.queue.size() == 0)
+                break;
+
+            if (spins == 0)
+                stage.consumerWaits++;
+            backoff(spins);
+        }
+
+        // The last worker to leave closes the next stage's input
+        if (--stage.activeWorkers == 0 && s + 1 < stages_.size())
+            finish(s + 1);
+    }
+
+    std::vector<std::unique_ptr<Stage>> stages_;
+    ErrorFn onError_;
+};
+
+#endif // STAGE_PIPELINE_HPP
@@ -0,0 +1,20 @@
+#ifndef STAGE_TIMINGS_HPP
+#define STAGE_TIMINGS_HPP
+
+// Wall time of each step of one image [ms]
+struct StageTimings
+{
+    double decodeMs = 0.0;
+    double preprocessMs = 0.0;
+    double featuresMs = 0.0;
+    double matchMs = 0.0;
+    double localizeMs = 0.0;
+    double encodeMs = 0.0;
+
+    double totalMs() const
+    {
+        return decodeMs + preprocessMs + featuresMs + matchMs + localizeMs + encodeMs;
+    }
+};
+
+#endif // STAGE_TIMINGS_HPP
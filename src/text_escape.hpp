@@ -0,0 +1,75 @@
+#ifndef TEXT_ESCAPE_HPP
+#define TEXT_ESCAPE_HPP
+
+#include <cstdio>
+#include <string>
+
+// Contents of a JSON string literal (without the quotes): quotes and backslashes are
+// escaped, and so are all control characters, which JSON does not allow raw
+inline std::string jsonEscape(const std::string &s)
+{
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s)
+    {
+        switch (c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned char>(c));
+                out += buf;
+            }
+            else
+            {
+                out += c;
+            }
+        }
+    }
+    return out;
+}
+
+// Append s as a quoted JSON string
+inline void appendJsonString(std::string &out, const std::string &s)
+{
+    out += '"';
+    out += jsonEscape(s);
+    out += '"';
+}
+
+// Append s as a CSV field, quoted (with doubled quotes) if it holds a separator,
+// a quote or a line break
+inline void appendCsvField(std::string &out, const std::string &s)
+{
+    if (s.find_first_of(",\"\r\n") == std::string::npos)
+    {
+        out += s;
+        return;
+    }
+    out += '"';
+    for (char c : s)
+    {
+        if (c == '"')
+            out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+#endif // TEXT_ESCAPE_HPP
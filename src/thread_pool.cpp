@@ -0,0 +1,190 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    // Pool and queue index of the current worker thread (none for external threads)
+    thread_local const ThreadPool *tlsPool = nullptr;
+    thread_local size_t tlsIndex = 0;
+
+    // Rounds a waiter spins looking for work before it sleeps, and how long it sleeps
+    // before looking again (tasks pushed later do not wake it)
+    const int kSpinRounds = 64;
+    const auto kIdleWait = std::chrono::milliseconds(1);
+}
+
+ThreadPool::ThreadPool(size_t threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t i = 0; i < threads; ++i)
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    for (size_t i = 0; i < threads; ++i)
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_)
+        worker.join();
+}
+
+void ThreadPool::push(std::function<void()> task)
+{
+    // Workers push to their own deque, external threads spread tasks round-robin
+    size_t index = (tlsPool == this) ? tlsIndex : nextQueue_++ % queues_.size();
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        ++pending_;
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::popTask(std::function<void()> &task)
+{
+    const size_t count = queues_.size();
+    const size_t self = (tlsPool == this) ? tlsIndex : nextQueue_.load() % count;
+
+    // Own deque first (LIFO, cache-warm), then steal from the others (FIFO)
+    {
+        WorkerQueue &q = *queues_[self];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty())
+        {
+            task = std::move(q.tasks.back());
+            q.tasks.pop_back();
+            --pending_;
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < count; ++offset)
+    {
+        WorkerQueue &q = *queues_[(self + offset) % count];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty())
+        {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            --pending_;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runPendingTask()
+{
+    std::function<void()> task;
+    if (!popTask(task))
+        return false;
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+    tlsPool = this;
+    tlsIndex = index;
+
+    while (true)
+    {
+        if (runPendingTask())
+            continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wake_.wait(lock, [this]
+                   { return stop_ || pending_ > 0; });
+        if (stop_ && pending_ == 0)
+            return;
+    }
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, const std::function<void(size_t)> &body)
+{
+    if (begin >= end)
+        return;
+
+    // Shared so that helper tasks starting after completion never touch freed state
+    struct State
+    {
+        std::atomic<size_t> next;
+        std::atomic<size_t> done{0};
+        size_t end;
+        size_t total;
+        std::function<void(size_t)> body;
+        std::mutex errorMutex;
+        std::exception_ptr error;
+        std::mutex doneMutex;
+        std::condition_variable doneCv; // signalled when the last index finishes
+    };
+    auto state = std::make_shared<State>();
+    state->next = begin;
+    state->end = end;
+    state->total = end - begin;
+    state->body = body;
+
+    auto drain = [state]()
+    {
+        size_t i;
+        while ((i = state->next++) < state->end)
+        {
+            try
+            {
+                state->body(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(state->errorMutex);
+                if (!state->error)
+                    state->error = std::current_exception();
+            }
+            if (++state->done == state->total)
+            {
+                std::lock_guard<std::mutex> lock(state->doneMutex);
+                state->doneCv.notify_all();
+            }
+        }
+    };
+
+    // One helper per worker (at most one per index); the caller drains too
+    const size_t total = state->total;
+    const size_t helpers = std::min(workers_.size(), total - 1);
+    for (size_t h = 0; h < helpers; ++h)
+        push(drain);
+
+    // Help with pending tasks while the last indices finish elsewhere; once there is
+    // nothing to run, sleep instead of spinning through a long tail
+    drain();
+    int idle = 0;
+    while (state->done < total)
+    {
+        if (runPendingTask())
+        {
+            idle = 0;
+        }
+        else if (++idle < kSpinRounds)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::unique_lock<std::mutex> lock(state->doneMutex);
+            state->doneCv.wait_for(lock, kIdleWait, [&]
+                                   { return state->done >= total; });
+        }
+    }
+
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
@@ -0,0 +1,82 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every worker owns a deque: it pops its own tasks
+// from the back and steals from the front of the other deques when idle.
+// Threads waiting on pool work (parallelFor, wait) execute pending tasks
+// instead of blocking, so nested parallelism does not deadlock.
+class ThreadPool
+{
+public:
+    // threads == 0 uses the number of hardware threads
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    // Queue a task and return its future
+    template <typename F>
+    auto submit(F &&task) -> std::future<decltype(task())>
+    {
+        using R = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+        std::future<R> future = packaged->get_future();
+        push([packaged]()
+             { (*packaged)(); });
+        return future;
+    }
+
+    // Wait for a future, running pending tasks meanwhile; blocks briefly on the
+    // future when there is nothing to run
+    template <typename T>
+    T wait(std::future<T> &future)
+    {
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            if (!runPendingTask())
+                future.wait_for(std::chrono::milliseconds(1));
+        }
+        return future.get();
+    }
+
+    // Run body(i) for every i in [begin, end); the caller takes part in the work.
+    // The first exception thrown by body is rethrown once all indices are done.
+    void parallelFor(size_t begin, size_t end, const std::function<void(size_t)> &body);
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void push(std::function<void()> task);
+    bool popTask(std::function<void()> &task);
+    bool runPendingTask();
+    void workerLoop(size_t index);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> pending_{0};
+    std::atomic<size_t> nextQueue_{0};
+    std::atomic<bool> stop_{false};
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+};
+
+#endif // THREAD_POOL_HPP
@@ -0,0 +1,296 @@
+#include "trace.hpp"
+
+#ifdef OBJECT_DETECT_TRACE
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "percentile.hpp"
+#include "text_escape.hpp"
+
+namespace trace
+{
+    namespace
+    {
+        enum class EventKind : uint8_t
+        {
+            Scope,
+            Counter,
+            Label
+        };
+
+        struct Event
+        {
+            EventKind kind;
+            const char *name;
+            const char *label; // Label events
+            int64_t value;     // Counter value, or duration of Scope events [ns]
+            uint64_t startNs;
+            int image;
+        };
+
+        // Events of one thread; only that thread appends, exports read after the run
+        struct ThreadBuffer
+        {
+            uint32_t tid;
+            std::vector<Event> events;
+        };
+
+        struct Registry
+        {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+            std::vector<std::string> imageNames;
+            std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        };
+
+        Registry &registry()
+        {
+            static Registry r;
+            return r;
+        }
+
+        thread_local ThreadBuffer *tlsBuffer = nullptr;
+        thread_local int tlsImage = kNoImage;
+
+        ThreadBuffer &threadBuffer()
+        {
+            if (!tlsBuffer)
+            {
+                Registry &r = registry();
+                std::lock_guard<std::mutex> lock(r.mutex);
+                r.buffers.push_back(std::make_unique<ThreadBuffer>());
+                tlsBuffer = r.buffers.back().get();
+                tlsBuffer->tid = static_cast<uint32_t>(r.buffers.size());
+                tlsBuffer->events.reserve(4096);
+            }
+            return *tlsBuffer;
+        }
+
+        void push(EventKind kind, const char *name, const char *label, int64_t value, uint64_t startNs)
+        {
+            threadBuffer().events.push_back({kind, name, label, value, startNs, tlsImage});
+        }
+    }
+
+    uint64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - registry().epoch)
+            .count();
+    }
+
+    int registerImage(const std::string &name)
+    {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.imageNames.push_back(name);
+        return static_cast<int>(r.imageNames.size() - 1);
+    }
+
+    int currentImage()
+    {
+        return tlsImage;
+    }
+
+    void recordScope(const char *name, uint64_t startNs, uint64_t durationNs)
+    {
+        push(EventKind::Scope, name, nullptr, static_cast<int64_t>(durationNs), startNs);
+    }
+
+    void recordCounter(const char *name, int64_t value)
+    {
+        push(EventKind::Counter, name, nullptr, value, nowNs());
+    }
+
+    void recordLabel(const char *name, const char *value)
+    {
+        push(EventKind::Label, name, value, 0, nowNs());
+    }
+
+    ImageScope::ImageScope(int image) : previous_(tlsImage)
+    {
+        tlsImage = image;
+    }
+
+    ImageScope::~ImageScope()
+    {
+        tlsImage = previous_;
+    }
+
+    bool writeChromeTrace(const std::string &path)
+    {
+        std::ofstream out(path);
+        if (!out.is_open())
+            return false;
+
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        auto imageName = [&](int image)
+        { return image >= 0 && image < (int)r.imageNames.size() ? r.imageNames[image] : std::string(); };
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        out << std::fixed << std::setprecision(3);
+        for (const auto &buffer : r.buffers)
+        {
+            for (const Event &e : buffer->events)
+            {
+                out << (first ? "" : ",\n");
+                first = false;
+                out << "{\"name\":\"" << jsonEscape(e.name) << "\",\"pid\":1,\"tid\":" << buffer->tid
+                    << ",\"ts\":" << e.startNs / 1000.0;
+                switch (e.kind)
+                {
+                case EventKind::Scope:
+                    out << ",\"ph\":\"X\",\"dur\":" << e.value / 1000.0
+                        << ",\"args\":{\"image\":\"" << jsonEscape(imageName(e.image)) << "\"}}";
+                    break;
+                case EventKind::Counter:
+                    // Instant event with the value; counter tracks would merge all images
+                    out << ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"value\":" << e.value
+                        << ",\"image\":\"" << jsonEscape(imageName(e.image)) << "\"}}";
+                    break;
+                case EventKind::Label:
+                    out << ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"value\":\"" << jsonEscape(e.label)
+                        << "\",\"image\":\"" << jsonEscape(imageName(e.image)) << "\"}}";
+                    break;
+                }
+            }
+        }
+        for (const auto &buffer : r.buffers)
+        {
+            out << (first ? "" : ",\n");
+            first = false;
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"args\":{\"name\":\"worker " << buffer->tid << "\"}}";
+        }
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+
+    void writeSummary(std::ostream &out)
+    {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+
+        // Keyed by name text; names are literals but may repeat across translation units
+        std::map<std::string, std::vector<double>> scopes;     // durations [ms]
+        std::map<std::string, std::vector<double>> counters;   // values
+        std::map<std::string, std::map<std::string, size_t>> labels;
+        std::vector<std::string> stageOrder;
+        std::map<int, std::map<std::string, double>> perImage; // image -> scope -> total ms
+
+        for (const auto &buffer : r.buffers)
+        {
+            for (const Event &e : buffer->events)
+            {
+                switch (e.kind)
+                {
+                case EventKind::Scope:
+                {
+                    double ms = e.value / 1e6;
+                    auto &durations = scopes[e.name];
+                    if (durations.empty())
+                        stageOrder.push_back(e.name);
+                    durations.push_back(ms);
+                    if (e.image != kNoImage)
+                        perImage[e.image][e.name] += ms;
+                    break;
+                }
+                case EventKind::Counter:
+                    counters[e.name].push_back(static_cast<double>(e.value));
+                    break;
+                case EventKind::Label:
+                    ++labels[e.name][e.label];
+                    break;
+                }
+            }
+        }
+
+        out << std::fixed << std::setprecision(3);
+        out << "Trace summary\n";
+        out << "  scope                 count    total[ms]   mean[ms]    p50[ms]    p99[ms]    max[ms]\n";
+        for (auto &entry : scopes)
+        {
+            auto &d = entry.second;
+            std::sort(d.begin(), d.end());
+            double total = 0.0;
+            for (double v : d)
+                total += v;
+            out << "  " << std::left << std::setw(20) << entry.first << std::right
+                << std::setw(7) << d.size()
+                << std::setw(13) << total
+                << std::setw(11) << total / d.size()
+                << std::setw(11) << percentile(d, 0.5)
+                << std::setw(11) << percentile(d, 0.99)
+                << std::setw(11) << d.back() << "\n";
+        }
+
+        if (!counters.empty())
+        {
+            out << "  counter               count          sum       mean        max\n";
+            for (const auto &entry : counters)
+            {
+                const auto &v = entry.second;
+                double sum = 0.0, max = v.front();
+                for (double x : v)
+                {
+                    sum += x;
+                    max = std::max(max, x);
+                }
+                out << "  " << std::left << std::setw(20) << entry.first << std::right
+                    << std::setw(7) << v.size()
+                    << std::setw(13) << std::setprecision(0) << sum
+                    << std::setw(11) << std::setprecision(1) << sum / v.size()
+                    << std::setw(11) << std::setprecision(0) << max << "\n";
+            }
+            out << std::setprecision(3);
+        }
+
+        for (const auto &entry : labels)
+        {
+            out << "  " << entry.first << ":";
+            for (const auto &value : entry.second)
+                out << " " << value.first << "=" << value.second;
+            out << "\n";
+        }
+
+        // Per-image stage times, slowest images first
+        if (!perImage.empty())
+        {
+            std::vector<std::pair<double, int>> order;
+            for (const auto &entry : perImage)
+            {
+                double total = 0.0;
+                for (const auto &stage : entry.second)
+                    total += stage.second;
+                order.emplace_back(total, entry.first);
+            }
+            std::sort(order.rbegin(), order.rend());
+
+            out << "  image                         ";
+            for (const auto &stage : stageOrder)
+                out << std::setw(std::max<int>(10, stage.size() + 2)) << stage;
+            out << "\n";
+            for (const auto &o : order)
+            {
+                const std::string name = o.second < (int)r.imageNames.size() ? r.imageNames[o.second] : "?";
+                out << "  " << std::left << std::setw(30) << name << std::right;
+                const auto &stages = perImage[o.second];
+                for (const auto &stage : stageOrder)
+                {
+                    auto it = stages.find(stage);
+                    out << std::setw(std::max<int>(10, stage.size() + 2)) << (it == stages.end() ? 0.0 : it->second);
+                }
+                out << "\n";
+            }
+        }
+    }
+}
+
+#endif // OBJECT_DETECT_TRACE
@@ -0,0 +1,91 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+// Hot-path tracing: scoped timers, counters and labels recorded into
+// per-thread buffers, tagged with the test image being processed.
+// Exported as a Chrome/Perfetto trace and an aggregate summary.
+//
+// Built only with OBJECT_DETECT_TRACE (CMake option OBJECT_DETECT_TRACING);
+// otherwise every TRACE_* macro expands to nothing.
+
+#ifdef OBJECT_DETECT_TRACE
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace trace
+{
+    // Image id of events recorded outside any image
+    constexpr int kNoImage = -1;
+
+    // Nanoseconds since the first call
+    uint64_t nowNs();
+
+    // Register a test image; returns its id
+    int registerImage(const std::string &name);
+
+    // Image the calling thread is working on
+    int currentImage();
+
+    // Record events (names and labels must be string literals)
+    void recordScope(const char *name, uint64_t startNs, uint64_t durationNs);
+    void recordCounter(const char *name, int64_t value);
+    void recordLabel(const char *name, const char *value);
+
+    // Export everything recorded so far; call once the traced work has finished
+    bool writeChromeTrace(const std::string &path);
+    void writeSummary(std::ostream &out);
+
+    // Times the enclosing scope
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(const char *name) : name_(name), start_(nowNs()) {}
+        ~ScopedTimer() { recordScope(name_, start_, nowNs() - start_); }
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    private:
+        const char *name_;
+        uint64_t start_;
+    };
+
+    // Tags events of the calling thread with an image for the enclosing scope
+    class ImageScope
+    {
+    public:
+        explicit ImageScope(int image);
+        ~ImageScope();
+        ImageScope(const ImageScope &) = delete;
+        ImageScope &operator=(const ImageScope &) = delete;
+
+    private:
+        int previous_;
+    };
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#define TRACE_SCOPE(name) ::trace::ScopedTimer TRACE_CONCAT(traceScope_, __LINE__)(name)
+#define TRACE_COUNTER(name, value) ::trace::recordCounter(name, static_cast<int64_t>(value))
+#define TRACE_LABEL(name, value) ::trace::recordLabel(name, value)
+#define TRACE_IMAGE(id) ::trace::ImageScope TRACE_CONCAT(traceImage_, __LINE__)(id)
+// Capture the current image into a variable, to re-enter it on another thread
+#define TRACE_CAPTURE_IMAGE(var) const int var = ::trace::currentImage()
+#define TRACE_REGISTER_IMAGE(var, name) var = ::trace::registerImage(name)
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+#define TRACE_LABEL(name, value) ((void)0)
+#define TRACE_IMAGE(id) ((void)0)
+#define TRACE_CAPTURE_IMAGE(var) ((void)0)
+#define TRACE_REGISTER_IMAGE(var, name) ((void)0)
+
+#endif // OBJECT_DETECT_TRACE
+
+#endif // TRACE_HPP
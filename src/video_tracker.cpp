@@ -0,0 +1,247 @@
+#include "video_tracker.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstdio>
+#include "image_io.hpp"
+#include "preprocessing.hpp"
+#include "trace.hpp"
+
+bool FrameSource::open(const std::filesystem::path &path)
+{
+    files_.clear();
+    next_ = 0;
+    if (std::filesystem::is_directory(path))
+    {
+        const std::string extensions[] = {".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff"};
+        for (const auto &entry : std::filesystem::directory_iterator(path))
+        {
+            std::string ext = entry.path().extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            if (entry.is_regular_file() &&
+                std::find(std::begin(extensions), std::end(extensions), ext) != std::end(extensions))
+                files_.push_back(entry.path());
+        }
+        std::sort(files_.begin(), files_.end());
+        return !files_.empty();
+    }
+    return capture_.open(path.string());
+}
+
+bool FrameSource::read(cv::Mat &gray)
+{
+    if (!files_.empty())
+    {
+        // Skip unreadable files instead of ending the sequence
+        while (next_ < files_.size())
+        {
+            const auto &file = files_[next_++];
+            gray = readImage(file, cv::IMREAD_GRAYSCALE);
+            if (!gray.empty())
+            {
+                name_ = file.filename().string();
+                return true;
+            }
+        }
+        return false;
+    }
+    cv::Mat frame;
+    if (!capture_.isOpened() || !capture_.read(frame) || frame.empty())
+        return false;
+    cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "frame_%06zu", next_++);
+    name_ = buf;
+    return true;
+}
+
+const char *keyframeReasonName(KeyframeReason reason)
+{
+    switch (reason)
+    {
+    case KeyframeReason::First:
+        return "first";
+    case KeyframeReason::Interval:
+        return "interval";
+    case KeyframeReason::Lost:
+        return "lost";
+    default:
+        return "none";
+    }
+}
+
+SequenceTracker::SequenceTracker(std::vector<const ObjectModel *> targets,
+                                 const FeatureExtractor &extractor,
+                                 const TrackingParams &params,
+                                 DenoiseMode denoise,
+                                 ThreadPool *pool)
+    : targets_(std::move(targets)), extractor_(extractor), params_(params), denoise_(denoise), pool_(pool)
+{
+}
+
+FrameResult SequenceTracker::process(const cv::Mat &gray)
+{
+    using Clock = std::chrono::steady_clock;
+    FrameResult frame;
+    frame.index = frameIndex_++;
+
+    if (frame.index == 0)
+        frame.keyframe = KeyframeReason::First;
+    else if (sinceKeyframe_ >= static_cast<size_t>(params_.keyframeInterval))
+        frame.keyframe = KeyframeReason::Interval;
+    else
+    {
+        auto start = Clock::now();
+        if (!track(gray))
+            frame.keyframe = KeyframeReason::Lost;
+        frame.localizeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    if (frame.keyframe != KeyframeReason::None)
+    {
+        detect(gray, frame);
+        sinceKeyframe_ = 0;
+    }
+    ++sinceKeyframe_;
+
+    for (const auto &t : tracks_)
+    {
+        frame.objects.push_back(t.result);
+        frame.trackedPoints.push_back(t.points.size());
+    }
+    return frame;
+}
+
+void SequenceTracker::detect(const cv::Mat &gray, FrameResult &frame)
+{
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::time_point since)
+    { return std::chrono::duration<double, std::milli>(Clock::now() - since).count(); };
+    TRACE_SCOPE("keyframe");
+
+    auto start = Clock::now();
+    cv::Mat processed = Preprocessing::reduceNoise(gray, denoise_);
+    frame.preprocessMs = ms(start);
+    start = Clock::now();
+    ImageFeatures features = extractor_.extract(processed);
+    frame.featuresMs = ms(start);
+
+    tracks_.assign(targets_.size(), Track());
+    for (size_t t = 0; t < targets_.size(); ++t)
+    {
+        const ObjectModel &model = *targets_[t];
+        Track &track = tracks_[t];
+        if (features.descriptors.empty())
+        {
+            track.result.objectKey = model.key;
+            continue;
+        }
+        start = Clock::now();
+        ObjectMatches matches = matchObject(model, features, pool_);
+        frame.matchMs += ms(start);
+        start = Clock::now();
+        track.result = localizeObject(model, features, matches, gray.size());
+        if (!track.result.detected)
+        {
+            frame.localizeMs += ms(start);
+            continue;
+        }
+
+        // Follow the RANSAC inliers of the best view that lie inside the box
+        const cv::Rect &box = track.result.box;
+        for (const auto &m : matches.viewVerification[track.result.bestView].inliers)
+        {
+            const cv::Point2f &pt = features.keypoints[m.trainIdx].pt;
+            if (box.contains(cv::Point(cvRound(pt.x), cvRound(pt.y))))
+                track.points.push_back(pt);
+        }
+
+        // Too few inliers to survive a few frames: add corners of the box region
+        if (track.points.size() < static_cast<size_t>(2 * params_.minTrackedPoints))
+        {
+            cv::Rect roi = box & cv::Rect(0, 0, gray.cols, gray.rows);
+            cv::Mat mask = cv::Mat::zeros(gray.size(), CV_8U);
+            mask(roi).setTo(cv::Scalar(255));
+            std::vector<cv::Point2f> corners;
+            cv::goodFeaturesToTrack(gray, corners, 100, 0.01, 5.0, mask);
+            track.points.insert(track.points.end(), corners.begin(), corners.end());
+        }
+        frame.localizeMs += ms(start);
+    }
+
+    prevPyramid_.clear();
+    cv::buildOpticalFlowPyramid(gray, prevPyramid_, cv::Size(params_.windowSize, params_.windowSize),
+                                params_.pyramidLevels);
+}
+
+bool SequenceTracker::track(const cv::Mat &gray)
+{
+    TRACE_SCOPE("track");
+    const cv::Size window(params_.windowSize, params_.windowSize);
+    std::vector<cv::Mat> pyramid;
+    cv::buildOpticalFlowPyramid(gray, pyramid, window, params_.pyramidLevels);
+
+    for (auto &track : tracks_)
+    {
+        if (!track.result.detected)
+            continue;
+        if (track.points.size() < static_cast<size_t>(params_.minTrackedPoints))
+            return false;
+
+        // Forward flow, then backward flow to reject points that do not track consistently
+        std::vector<cv::Point2f> next, back;
+        std::vector<uchar> status, backStatus;
+        std::vector<float> err;
+        cv::calcOpticalFlowPyrLK(prevPyramid_, pyramid, track.points, next, status, err, window,
+                                 params_.pyramidLevels);
+        cv::calcOpticalFlowPyrLK(pyramid, prevPyramid_, next, back, backStatus, err, window,
+                                 params_.pyramidLevels);
+
+        std::vector<cv::Point2f> from, to;
+        for (size_t i = 0; i < track.points.size(); ++i)
+        {
+            if (!status[i] || !backStatus[i])
+                continue;
+            cv::Point2f d = back[i] - track.points[i];
+            if (d.dot(d) > params_.maxFlowError * params_.maxFlowError)
+                continue;
+            from.push_back(track.points[i]);
+            to.push_back(next[i]);
+        }
+        TRACE_COUNTER("tracked_points", to.size());
+        if (from.size() < static_cast<size_t>(params_.minTrackedPoints))
+            return false;
+
+        // Similarity motion of the box (translation, rotation, uniform scale)
+        std::vector<uchar> inliers;
+        cv::Mat motion = cv::estimateAffinePartial2D(from, to, inliers, cv::RANSAC, 3.0);
+        if (motion.empty())
+            return false;
+
+        const cv::Rect &box = track.result.box;
+        std::vector<cv::Point2f> corners = {
+            cv::Point2f(box.x, box.y), cv::Point2f(box.x + box.width, box.y),
+            cv::Point2f(box.x + box.width, box.y + box.height), cv::Point2f(box.x, box.y + box.height)};
+        std::vector<cv::Point2f> moved;
+        cv::transform(corners, moved, motion);
+        cv::Rect newBox = cv::boundingRect(moved) & cv::Rect(0, 0, gray.cols, gray.rows);
+        if (newBox.width <= 0 || newBox.height <= 0)
+            return false;
+
+        track.result.box = newBox;
+        track.result.strategy = LocalizationStrategy::Tracked;
+        track.result.inliers = 0;
+        track.points.clear();
+        for (size_t i = 0; i < to.size(); ++i)
+        {
+            if (inliers[i])
+            {
+                track.points.push_back(to[i]);
+                ++track.result.inliers;
+            }
+        }
+    }
+
+    prevPyramid_ = std::move(pyramid);
+    return true;
+}
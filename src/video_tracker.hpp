@@ -0,0 +1,103 @@
+#ifndef VIDEO_TRACKER_HPP
+#define VIDEO_TRACKER_HPP
+
+#include <opencv2/opencv.hpp>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "detection.hpp"
+#include "pipeline.hpp"
+#include "thread_pool.hpp"
+
+// Frames of a video file or of an image sequence (a directory, in file name order)
+class FrameSource
+{
+public:
+    // Open a video file or a directory of images; returns false if nothing can be read
+    bool open(const std::filesystem::path &path);
+
+    // Read the next frame as grayscale; returns false at the end of the sequence
+    bool read(cv::Mat &gray);
+
+    // Name of the last frame read (file name, or frame_<index> for videos)
+    const std::string &frameName() const { return name_; }
+
+private:
+    cv::VideoCapture capture_;
+    std::vector<std::filesystem::path> files_;
+    size_t next_ = 0;
+    std::string name_;
+};
+
+// When keyframes are detected and how boxes are followed between them
+struct TrackingParams
+{
+    int keyframeInterval = 30;   // run the full detector at least every N frames
+    int minTrackedPoints = 8;    // re-detect when fewer points of a track survive
+    double maxFlowError = 1.0;   // forward-backward error (pixels) above which a point is dropped
+    int windowSize = 21;         // Lucas-Kanade window
+    int pyramidLevels = 3;       // Lucas-Kanade pyramid levels above the full resolution
+};
+
+// Why a frame ran the full detector
+enum class KeyframeReason
+{
+    None,     // tracked frame
+    First,    // first frame of the sequence
+    Interval, // keyframeInterval frames since the last keyframe
+    Lost,     // a track could not be followed (too few points or no motion estimate)
+};
+
+const char *keyframeReasonName(KeyframeReason reason);
+
+// Result of one frame
+struct FrameResult
+{
+    size_t index = 0;
+    KeyframeReason keyframe = KeyframeReason::None;
+    std::vector<DetectionResult> objects; // one per target; boxes between keyframes have the Tracked strategy
+    std::vector<size_t> trackedPoints;    // points following each target after this frame
+    double preprocessMs = 0.0;            // keyframes only
+    double featuresMs = 0.0;              // keyframes only
+    double matchMs = 0.0;                 // keyframes only
+    double localizeMs = 0.0;              // localization on keyframes, optical flow and box update otherwise
+};
+
+// Runs the full detector on keyframes and follows the detected boxes between them
+// with pyramidal Lucas-Kanade tracking of the RANSAC inlier points.
+// A track that loses too many points or whose motion cannot be estimated triggers
+// a re-detection on the same frame.
+class SequenceTracker
+{
+public:
+    SequenceTracker(std::vector<const ObjectModel *> targets,
+                    const FeatureExtractor &extractor,
+                    const TrackingParams &params,
+                    DenoiseMode denoise,
+                    ThreadPool *pool = nullptr);
+
+    // Process the next grayscale frame of the sequence
+    FrameResult process(const cv::Mat &gray);
+
+private:
+    struct Track
+    {
+        DetectionResult result;
+        std::vector<cv::Point2f> points; // tracked points in the previous frame
+    };
+
+    void detect(const cv::Mat &gray, FrameResult &frame);
+    bool track(const cv::Mat &gray);
+
+    std::vector<const ObjectModel *> targets_;
+    const FeatureExtractor &extractor_;
+    TrackingParams params_;
+    DenoiseMode denoise_;
+    ThreadPool *pool_;
+    std::vector<Track> tracks_;
+    std::vector<cv::Mat> prevPyramid_;
+    size_t frameIndex_ = 0;
+    size_t sinceKeyframe_ = 0;
+};
+
+#endif // VIDEO_TRACKER_HPP
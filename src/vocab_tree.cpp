@@ -0,0 +1,422 @@
+#include "vocab_tree.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+
+struct VocabularyTree::Header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t branching;
+    uint32_t depth;
+    uint32_t dims;
+    uint32_t nodeCount;
+    uint32_t wordCount;
+    uint32_t docCount;
+    uint64_t postingCount;
+    uint64_t centersOffset;
+    uint64_t firstChildOffset;
+    uint64_t leafWordOffset;
+    uint64_t idfOffset;
+    uint64_t postingIndexOffset;
+    uint64_t postingsOffset;
+    uint64_t docTableOffset;
+};
+
+namespace
+{
+    const char kMagic[4] = {'O', 'D', 'V', 'T'};
+
+    // Descend from the root to a leaf, following the closest child center
+    uint32_t descend(const float *centers, const int32_t *firstChild, const int32_t *leafWord,
+                     int branching, int dims, const float *d)
+    {
+        int node = 0;
+        while (firstChild[node] >= 0)
+        {
+            const int first = firstChild[node];
+            int best = first;
+            float bestDist = std::numeric_limits<float>::max();
+            for (int c = first; c < first + branching; ++c)
+            {
+                const float *center = centers + static_cast<size_t>(c) * dims;
+                float dist = 0.0f;
+                for (int k = 0; k < dims; ++k)
+                {
+                    float diff = d[k] - center[k];
+                    dist += diff * diff;
+                }
+                if (dist < bestDist)
+                {
+                    bestDist = dist;
+                    best = c;
+                }
+            }
+            node = best;
+        }
+        return static_cast<uint32_t>(leafWord[node]);
+    }
+
+    cv::Mat toFloat(const cv::Mat &descriptors)
+    {
+        if (descriptors.type() == CV_32F)
+            return descriptors;
+        cv::Mat f;
+        descriptors.convertTo(f, CV_32F);
+        return f;
+    }
+
+    // Tree nodes while training
+    struct TreeBuilder
+    {
+        int branching;
+        int depth;
+        int dims;
+        int iterations;
+        std::vector<float> centers;
+        std::vector<int32_t> firstChild;
+        std::vector<int32_t> leafWord;
+        int32_t words = 0;
+
+        int32_t addNode(const float *center)
+        {
+            if (center)
+                centers.insert(centers.end(), center, center + dims);
+            else
+                centers.insert(centers.end(), dims, 0.0f);
+            firstChild.push_back(-1);
+            leafWord.push_back(-1);
+            return static_cast<int32_t>(firstChild.size() - 1);
+        }
+
+        void split(int32_t node, const cv::Mat &data, const std::vector<int> &rows, int level)
+        {
+            if (level == depth || static_cast<int>(rows.size()) < branching)
+            {
+                leafWord[node] = words++;
+                return;
+            }
+
+            cv::Mat subset(static_cast<int>(rows.size()), dims, CV_32F);
+            for (size_t i = 0; i < rows.size(); ++i)
+                data.row(rows[i]).copyTo(subset.row(static_cast<int>(i)));
+
+            cv::Mat labels, clusterCenters;
+            cv::kmeans(subset, branching, labels,
+                       cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, iterations, 1e-4),
+                       1, cv::KMEANS_PP_CENTERS, clusterCenters);
+
+            const int32_t first = static_cast<int32_t>(firstChild.size());
+            for (int c = 0; c < branching; ++c)
+                addNode(clusterCenters.ptr<float>(c));
+            firstChild[node] = first;
+
+            std::vector<std::vector<int>> groups(branching);
+            for (size_t i = 0; i < rows.size(); ++i)
+                groups[labels.at<int>(static_cast<int>(i))].push_back(rows[i]);
+            for (int c = 0; c < branching; ++c)
+                split(first + c, data, groups[c], level + 1);
+        }
+    };
+
+    // Byte buffer with aligned sections
+    struct Blob
+    {
+        std::vector<uint8_t> bytes;
+
+        uint64_t append(const void *data, size_t size)
+        {
+            while (bytes.size() % 8)
+                bytes.push_back(0);
+            uint64_t offset = bytes.size();
+            const uint8_t *p = static_cast<const uint8_t *>(data);
+            bytes.insert(bytes.end(), p, p + size);
+            return offset;
+        }
+    };
+}
+
+bool VocabularyTree::build(const std::vector<VocabDocument> &docs,
+                           const std::vector<cv::Mat> &descriptors,
+                           const VocabTreeParams &params,
+                           const std::filesystem::path &path)
+{
+    if (docs.size() != descriptors.size() || docs.empty())
+        return false;
+
+    // Training sample: every descriptor, or an even subsample of at most maxTrainDescriptors
+    std::vector<cv::Mat> floatDescs;
+    int total = 0, dims = 0;
+    for (const auto &d : descriptors)
+    {
+        floatDescs.push_back(toFloat(d));
+        total += d.rows;
+        if (!d.empty())
+            dims = d.cols;
+    }
+    if (total == 0)
+        return false;
+
+    cv::Mat data;
+    const double step = std::max(1.0, static_cast<double>(total) / params.maxTrainDescriptors);
+    double next = 0.0;
+    int index = 0;
+    for (const auto &d : floatDescs)
+    {
+        for (int r = 0; r < d.rows; ++r, ++index)
+        {
+            if (index >= next)
+            {
+                data.push_back(d.row(r));
+                next += step;
+            }
+        }
+    }
+
+    TreeBuilder tree{params.branching, params.depth, dims, params.kmeansIterations, {}, {}, {}, 0};
+    tree.addNode(nullptr);
+    std::vector<int> all(data.rows);
+    std::iota(all.begin(), all.end(), 0);
+    tree.split(0, data, all, 0);
+
+    // Term frequencies of every document
+    const uint32_t wordCount = static_cast<uint32_t>(tree.words);
+    std::vector<std::vector<std::pair<uint32_t, float>>> docWords(docs.size()); // (word, tf)
+    std::vector<uint32_t> df(wordCount, 0);
+    for (size_t doc = 0; doc < docs.size(); ++doc)
+    {
+        const cv::Mat &d = floatDescs[doc];
+        std::vector<uint32_t> words(d.rows);
+        for (int r = 0; r < d.rows; ++r)
+            words[r] = descend(tree.centers.data(), tree.firstChild.data(), tree.leafWord.data(),
+                               tree.branching, dims, d.ptr<float>(r));
+        std::sort(words.begin(), words.end());
+        for (size_t i = 0; i < words.size();)
+        {
+            size_t j = i;
+            while (j < words.size() && words[j] == words[i])
+                ++j;
+            docWords[doc].emplace_back(words[i], static_cast<float>(j - i));
+            ++df[words[i]];
+            i = j;
+        }
+    }
+
+    // IDF, and L2-normalized TF-IDF document vectors
+    std::vector<float> idf(wordCount, 0.0f);
+    for (uint32_t w = 0; w < wordCount; ++w)
+        if (df[w])
+            idf[w] = static_cast<float>(std::log(static_cast<double>(docs.size()) / df[w]));
+    for (auto &words : docWords)
+    {
+        double norm = 0.0;
+        for (auto &entry : words)
+        {
+            entry.second *= idf[entry.first];
+            norm += static_cast<double>(entry.second) * entry.second;
+        }
+        norm = std::sqrt(norm);
+        for (auto &entry : words)
+            entry.second = norm > 0.0 ? static_cast<float>(entry.second / norm) : 0.0f;
+    }
+
+    // Inverted file: postings grouped by word
+    std::vector<uint32_t> postingIndex(wordCount + 1, 0);
+    for (const auto &words : docWords)
+        for (const auto &entry : words)
+            if (entry.second > 0.0f)
+                ++postingIndex[entry.first + 1];
+    std::partial_sum(postingIndex.begin(), postingIndex.end(), postingIndex.begin());
+    std::vector<Posting> postings(postingIndex.back());
+    std::vector<uint32_t> fill(postingIndex.begin(), postingIndex.end() - 1);
+    for (uint32_t doc = 0; doc < docWords.size(); ++doc)
+        for (const auto &entry : docWords[doc])
+            if (entry.second > 0.0f)
+                postings[fill[entry.first]++] = {doc, entry.second};
+
+    // Serialize
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFormatVersion;
+    header.branching = params.branching;
+    header.depth = params.depth;
+    header.dims = dims;
+    header.nodeCount = static_cast<uint32_t>(tree.firstChild.size());
+    header.wordCount = wordCount;
+    header.docCount = static_cast<uint32_t>(docs.size());
+    header.postingCount = postings.size();
+
+    Blob blob;
+    blob.append(&header, sizeof(header));
+    header.centersOffset = blob.append(tree.centers.data(), tree.centers.size() * sizeof(float));
+    header.firstChildOffset = blob.append(tree.firstChild.data(), tree.firstChild.size() * sizeof(int32_t));
+    header.leafWordOffset = blob.append(tree.leafWord.data(), tree.leafWord.size() * sizeof(int32_t));
+    header.idfOffset = blob.append(idf.data(), idf.size() * sizeof(float));
+    header.postingIndexOffset = blob.append(postingIndex.data(), postingIndex.size() * sizeof(uint32_t));
+    header.postingsOffset = blob.append(postings.data(), postings.size() * sizeof(Posting));
+
+    std::vector<uint8_t> docTable;
+    auto appendString = [&](const std::string &s)
+    {
+        uint32_t len = static_cast<uint32_t>(s.size());
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(&len);
+        docTable.insert(docTable.end(), p, p + sizeof(len));
+        docTable.insert(docTable.end(), s.begin(), s.end());
+    };
+    for (const auto &doc : docs)
+    {
+        appendString(doc.objectKey);
+        appendString(doc.viewName);
+    }
+    header.docTableOffset = blob.append(docTable.data(), docTable.size());
+    std::memcpy(blob.bytes.data(), &header, sizeof(header));
+
+    // Write to a temporary file and rename, so a reader never maps a partial tree
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        std::cerr << "Failed to write vocabulary tree: " << tmpPath << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(blob.bytes.data()), blob.bytes.size());
+    out.close();
+    if (!out)
+        return false;
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+bool VocabularyTree::load(const std::filesystem::path &path)
+{
+    header_ = nullptr;
+    docs_.clear();
+    if (!file_.open(path) || file_.size() < sizeof(Header))
+        return false;
+
+    const uint8_t *base = file_.data();
+    const size_t size = file_.size();
+    const Header *h = reinterpret_cast<const Header *>(base);
+    if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 || h->version != kFormatVersion)
+        return false;
+
+    // Every section must lie inside the file
+    auto fits = [&](uint64_t offset, uint64_t bytes)
+    { return offset <= size && bytes <= size - offset; };
+    const uint64_t nodes = h->nodeCount;
+    if (!fits(h->centersOffset, nodes * h->dims * sizeof(float)) ||
+        !fits(h->firstChildOffset, nodes * sizeof(int32_t)) ||
+        !fits(h->leafWordOffset, nodes * sizeof(int32_t)) ||
+        !fits(h->idfOffset, uint64_t(h->wordCount) * sizeof(float)) ||
+        !fits(h->postingIndexOffset, (uint64_t(h->wordCount) + 1) * sizeof(uint32_t)) ||
+        !fits(h->postingsOffset, h->postingCount * sizeof(Posting)) ||
+        !fits(h->docTableOffset, 0))
+        return false;
+
+    centers_ = reinterpret_cast<const float *>(base + h->centersOffset);
+    firstChild_ = reinterpret_cast<const int32_t *>(base + h->firstChildOffset);
+    leafWord_ = reinterpret_cast<const int32_t *>(base + h->leafWordOffset);
+    idf_ = reinterpret_cast<const float *>(base + h->idfOffset);
+    postingIndex_ = reinterpret_cast<const uint32_t *>(base + h->postingIndexOffset);
+    postings_ = reinterpret_cast<const Posting *>(base + h->postingsOffset);
+    if (postingIndex_[h->wordCount] != h->postingCount)
+        return false;
+
+    // Document table (small, copied)
+    const uint8_t *p = base + h->docTableOffset;
+    const uint8_t *end = base + size;
+    auto readString = [&](std::string &s)
+    {
+        uint32_t len;
+        if (end - p < static_cast<ptrdiff_t>(sizeof(len)))
+            return false;
+        std::memcpy(&len, p, sizeof(len));
+        p += sizeof(len);
+        if (static_cast<size_t>(end - p) < len)
+            return false;
+        s.assign(reinterpret_cast<const char *>(p), len);
+        p += len;
+        return true;
+    };
+    docs_.resize(h->docCount);
+    for (auto &doc : docs_)
+    {
+        if (!readString(doc.objectKey) || !readString(doc.viewName))
+        {
+            docs_.clear();
+            return false;
+        }
+    }
+
+    header_ = h;
+    return true;
+}
+
+size_t VocabularyTree::wordCount() const
+{
+    return header_ ? header_->wordCount : 0;
+}
+
+uint32_t VocabularyTree::quantize(const float *descriptor) const
+{
+    return descend(centers_, firstChild_, leafWord_, header_->branching, header_->dims, descriptor);
+}
+
+std::vector<VocabCandidate> VocabularyTree::query(const cv::Mat &descriptors, size_t topN) const
+{
+    std::vector<VocabCandidate> ranked;
+    if (!header_ || descriptors.empty() || descriptors.cols != static_cast<int>(header_->dims))
+        return ranked;
+
+    // Query TF-IDF vector
+    cv::Mat d = toFloat(descriptors);
+    std::vector<uint32_t> words(d.rows);
+    for (int r = 0; r < d.rows; ++r)
+        words[r] = quantize(d.ptr<float>(r));
+    std::sort(words.begin(), words.end());
+
+    std::vector<std::pair<uint32_t, float>> q;
+    double norm = 0.0;
+    for (size_t i = 0; i < words.size();)
+    {
+        size_t j = i;
+        while (j < words.size() && words[j] == words[i])
+            ++j;
+        float w = static_cast<float>(j - i) * idf_[words[i]];
+        if (w > 0.0f)
+        {
+            q.emplace_back(words[i], w);
+            norm += static_cast<double>(w) * w;
+        }
+        i = j;
+    }
+    if (norm <= 0.0)
+        return ranked;
+    const float inv = static_cast<float>(1.0 / std::sqrt(norm));
+
+    // Accumulate dot products over the posting lists of the query words
+    std::vector<float> scores(header_->docCount, 0.0f);
+    for (const auto &entry : q)
+    {
+        const float qw = entry.second * inv;
+        for (uint32_t p = postingIndex_[entry.first]; p < postingIndex_[entry.first + 1]; ++p)
+            scores[postings_[p].doc] += qw * postings_[p].weight;
+    }
+
+    for (uint32_t doc = 0; doc < scores.size(); ++doc)
+        if (scores[doc] > 0.0f)
+            ranked.push_back({doc, scores[doc]});
+    size_t keep = std::min(topN, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + keep, ranked.end(),
+                      [](const VocabCandidate &a, const VocabCandidate &b)
+                      { return a.score > b.score; });
+    ranked.resize(keep);
+    return ranked;
+}
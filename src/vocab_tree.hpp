@@ -0,0 +1,85 @@
+#ifndef VOCAB_TREE_HPP
+#define VOCAB_TREE_HPP
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "mapped_file.hpp"
+
+// Shape of the vocabulary tree and its training budget
+struct VocabTreeParams
+{
+    int branching = 10;               // children per node
+    int depth = 4;                    // levels below the root (up to branching^depth words)
+    int kmeansIterations = 10;        // k-means iterations per split
+    int maxTrainDescriptors = 200000; // descriptors sampled for training
+};
+
+// A document of the inverted file: one model view of one object
+struct VocabDocument
+{
+    std::string objectKey;
+    std::string viewName;
+};
+
+// A ranked candidate view
+struct VocabCandidate
+{
+    uint32_t doc;
+    float score; // cosine similarity of the TF-IDF vectors
+};
+
+// Hierarchical k-means vocabulary tree with TF-IDF weighted inverted files
+// mapping visual words to model views of all registered objects.
+// Trained offline and written to a single file that is memory-mapped on load;
+// centers and posting lists are used in place.
+class VocabularyTree
+{
+public:
+    // Bump whenever the file layout changes
+    static constexpr uint32_t kFormatVersion = 1;
+
+    // Train a tree on the descriptors of all documents (one matrix per document,
+    // CV_32F or CV_8U) and write it to path
+    static bool build(const std::vector<VocabDocument> &docs,
+                      const std::vector<cv::Mat> &descriptors,
+                      const VocabTreeParams &params,
+                      const std::filesystem::path &path);
+
+    // Map a tree file; returns false if it is missing or invalid
+    bool load(const std::filesystem::path &path);
+
+    bool isLoaded() const { return header_ != nullptr; }
+    size_t wordCount() const;
+    size_t documentCount() const { return docs_.size(); }
+    const VocabDocument &document(size_t doc) const { return docs_[doc]; }
+    size_t fileBytes() const { return file_.size(); }
+
+    // Visual word of one descriptor
+    uint32_t quantize(const float *descriptor) const;
+
+    // Rank the documents for a set of test descriptors; returns the best topN
+    std::vector<VocabCandidate> query(const cv::Mat &descriptors, size_t topN) const;
+
+private:
+    struct Header;
+    struct Posting
+    {
+        uint32_t doc;
+        float weight; // L2-normalized TF-IDF weight of the word in the document
+    };
+
+    MappedFile file_;
+    const Header *header_ = nullptr;
+    const float *centers_ = nullptr;       // one row per node
+    const int32_t *firstChild_ = nullptr;  // -1 for leaves
+    const int32_t *leafWord_ = nullptr;    // -1 for inner nodes
+    const float *idf_ = nullptr;           // per word
+    const uint32_t *postingIndex_ = nullptr; // wordCount + 1 offsets into postings_
+    const Posting *postings_ = nullptr;
+    std::vector<VocabDocument> docs_;
+};
+
+#endif // VOCAB_TREE_HPP
@@ -0,0 +1,23 @@
+#ifndef TESTS_CHECK_HPP
+#define TESTS_CHECK_HPP
+
+#include <iostream>
+
+// Minimal assertions for the test executables: a failed CHECK is reported and
+// counted, and main() returns the count so ctest marks the test failed
+namespace check
+{
+    inline int failures = 0;
+}
+
+#define CHECK(cond)                                                                        \
+    do                                                                                     \
+    {                                                                                      \
+        if (!(cond))                                                                       \
+        {                                                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #cond << std::endl; \
+            ++check::failures;                                                             \
+        }                                                                                  \
+    } while (0)
+
+#endif // TESTS_CHECK_HPP
@@ -0,0 +1,37 @@
+#ifndef TESTS_TEMP_DIR_HPP
+#define TESTS_TEMP_DIR_HPP
+
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+
+// Empty directory under the system temp directory, removed with its contents when
+// the test ends
+class TempDir
+{
+public:
+    explicit TempDir(const std::string &name)
+        : path_(std::filesystem::temp_directory_path() / (name + "-" + std::to_string(::getpid())))
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(path_, ec);
+        std::filesystem::create_directories(path_, ec);
+    }
+
+    ~TempDir()
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(path_, ec);
+    }
+
+    TempDir(const TempDir &) = delete;
+    TempDir &operator=(const TempDir &) = delete;
+
+    const std::filesystem::path &path() const { return path_; }
+
+private:
+    std::filesystem::path path_;
+};
+
+#endif // TESTS_TEMP_DIR_HPP
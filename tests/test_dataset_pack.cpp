@@ -0,0 +1,119 @@
+#include <opencv2/opencv.hpp>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "dataset_pack.hpp"
+#include "temp_dir.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Same size, type and pixels
+    bool samePixels(const cv::Mat &a, const cv::Mat &b)
+    {
+        if (a.size() != b.size() || a.type() != b.type())
+            return false;
+        for (int y = 0; y < a.rows; ++y)
+            if (std::memcmp(a.ptr(y), b.ptr(y), a.cols * a.elemSize()) != 0)
+                return false;
+        return true;
+    }
+
+    cv::Mat noise(int rows, int cols, uint64_t seed)
+    {
+        cv::Mat image(rows, cols, CV_8U);
+        cv::RNG(seed).fill(image, cv::RNG::UNIFORM, cv::Scalar(0), cv::Scalar(256));
+        return image;
+    }
+
+    // Two objects with two views each (one without a mask), a labelled and an
+    // unlabelled test image, and a file that is not an image
+    void writeDataset(const fs::path &root)
+    {
+        uint64_t seed = 1;
+        for (const std::string key : {"004_sugar_box", "035_power_drill"})
+        {
+            fs::create_directories(root / key / "models");
+            fs::create_directories(root / key / "test_images");
+            fs::create_directories(root / key / "labels");
+            cv::imwrite((root / key / "models" / "view0_color.png").string(), noise(40, 30, seed++));
+            cv::imwrite((root / key / "models" / "view0_mask.png").string(), noise(40, 30, seed++) > 128);
+            cv::imwrite((root / key / "models" / "view1_color.png").string(), noise(32, 48, seed++));
+            cv::imwrite((root / key / "test_images" / "a-color.png").string(), noise(60, 80, seed++));
+            cv::imwrite((root / key / "test_images" / "b-color.png").string(), noise(50, 70, seed++));
+            std::ofstream(root / key / "labels" / "a-box.txt") << key << " 3 4 20 30\nother 1 2 5 6\n";
+            std::ofstream(root / key / "test_images" / ".DS_Store") << "not an image";
+        }
+    }
+
+    // The pack holds every readable view, mask, test image and label set of the files
+    void checkPack(const IDataLoader &files, const fs::path &root, const fs::path &packPath)
+    {
+        PackDataLoader pack;
+        CHECK(pack.open(packPath));
+        if (!pack.isOpen())
+            return;
+        CHECK(pack.checkIntegrity(root) == IntegrityCode::OK);
+        const std::vector<std::string> keys = files.listObjectKeys(root);
+        CHECK(pack.listObjectKeys(root) == keys);
+        for (const std::string &key : keys)
+        {
+            std::vector<ModelViewFiles> viewFiles = files.listModelViewFiles(root, key);
+            CHECK(pack.listModelViewFiles(root, key).size() == viewFiles.size());
+            for (const ModelViewFiles &view : viewFiles)
+            {
+                ModelView source = files.loadModelView(view);
+                ModelView packed = pack.loadModelView(view);
+                CHECK(samePixels(packed.gray, source.gray));
+                CHECK(samePixels(packed.mask, source.mask));
+            }
+
+            std::vector<TestImage> images;
+            for (const TestImage &image : files.listTestImages(root, key))
+                if (!files.loadTestImage(image).empty())
+                    images.push_back(image);
+            CHECK(images.size() == 2);
+            CHECK(pack.listTestImages(root, key).size() == images.size());
+            for (const TestImage &image : images)
+            {
+                CHECK(samePixels(pack.loadTestImage(image), files.loadTestImage(image)));
+                std::vector<GroundTruthBox> expected = files.loadLabels(root, key, image);
+                std::vector<GroundTruthBox> packed = pack.loadLabels(root, key, image);
+                CHECK(packed.size() == expected.size());
+                for (size_t l = 0; l < expected.size() && l < packed.size(); ++l)
+                    CHECK(packed[l].objectKey == expected[l].objectKey && packed[l].box == expected[l].box);
+            }
+        }
+    }
+}
+
+int main()
+{
+    TempDir dir("object-detect-pack-test");
+    const fs::path root = dir.path() / "data";
+    writeDataset(root);
+    FileSystemDataLoader files;
+    ThreadPool pool(2);
+
+    for (PackEncoding encoding : {PackEncoding::Planes, PackEncoding::Encoded})
+    {
+        const fs::path packPath = dir.path() / (std::string(packEncodingName(encoding)) + ".pack");
+        PackSummary summary;
+        CHECK(writeDatasetPack(files, root, packPath, encoding, &pool, &summary));
+        CHECK(summary.objects == 2 && summary.views == 4 && summary.testImages == 4 && summary.skipped == 2);
+        checkPack(files, root, packPath);
+    }
+
+    // A planes pack repacks from a pack; an encoded one needs the original files
+    PackDataLoader pack;
+    CHECK(pack.open(dir.path() / "planes.pack"));
+    CHECK(writeDatasetPack(pack, root, dir.path() / "repack.pack", PackEncoding::Planes));
+    checkPack(files, root, dir.path() / "repack.pack");
+    fs::remove_all(root);
+    CHECK(!writeDatasetPack(pack, root, dir.path() / "encoded-repack.pack", PackEncoding::Encoded));
+    CHECK(!fs::exists(dir.path() / "encoded-repack.pack"));
+    return check::failures;
+}
@@ -0,0 +1,36 @@
+#include <opencv2/opencv.hpp>
+#include "check.hpp"
+#include "descriptor_format.hpp"
+
+namespace
+{
+    bool sameMat(const cv::Mat &a, const cv::Mat &b)
+    {
+        return a.size() == b.size() && a.type() == b.type() && (a.empty() || cv::norm(a, b, cv::NORM_INF) == 0.0);
+    }
+
+    // Whole numbers in [0, 255], like OpenCV's float SIFT descriptors
+    cv::Mat siftLike(int rows)
+    {
+        cv::Mat values(rows, 128, CV_8U);
+        cv::RNG(7).fill(values, cv::RNG::UNIFORM, cv::Scalar(0), cv::Scalar(256));
+        cv::Mat descriptors;
+        values.convertTo(descriptors, CV_32F);
+        return descriptors;
+    }
+}
+
+int main()
+{
+    const cv::Mat descriptors = siftLike(50);
+    for (DescriptorFormat format : {DescriptorFormat::Float32, DescriptorFormat::Uint8, DescriptorFormat::RootSift8})
+    {
+        // The gallery converts rows that the model loader already converted
+        cv::Mat once = DescriptorQuantizer::convert(descriptors, format);
+        cv::Mat twice = DescriptorQuantizer::convert(once, format);
+        CHECK(once.type() == (format == DescriptorFormat::Float32 ? CV_32F : CV_8U));
+        CHECK(sameMat(once, twice));
+    }
+    CHECK(DescriptorQuantizer::convert(cv::Mat(), DescriptorFormat::RootSift8).empty());
+    return check::failures;
+}
@@ -0,0 +1,87 @@
+#include <opencv2/opencv.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "feature_cache.hpp"
+#include "temp_dir.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    ViewFeatures makeView(const std::string &name, int keypoints, int descriptorType, uint64_t seed)
+    {
+        cv::RNG rng(seed);
+        ViewFeatures vf;
+        vf.name = name;
+        vf.maskSize = cv::Size(640, 480);
+        for (int k = 0; k < keypoints; ++k)
+            vf.keypoints.emplace_back(cv::Point2f(rng.uniform(0.f, 640.f), rng.uniform(0.f, 480.f)),
+                                      rng.uniform(1.f, 20.f), rng.uniform(0.f, 360.f), rng.uniform(0.f, 1.f),
+                                      rng.uniform(0, 4), k);
+        vf.descriptors.create(keypoints, 128, descriptorType);
+        rng.fill(vf.descriptors, cv::RNG::UNIFORM, cv::Scalar(0), cv::Scalar(256));
+        return vf;
+    }
+
+    bool sameFeatures(const std::vector<ViewFeatures> &a, const std::vector<ViewFeatures> &b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (size_t v = 0; v < a.size(); ++v)
+        {
+            const ViewFeatures &x = a[v], &y = b[v];
+            if (x.name != y.name || x.maskSize != y.maskSize || x.keypoints.size() != y.keypoints.size() ||
+                x.descriptors.size() != y.descriptors.size() || x.descriptors.type() != y.descriptors.type())
+                return false;
+            for (size_t k = 0; k < x.keypoints.size(); ++k)
+            {
+                const cv::KeyPoint &p = x.keypoints[k], &q = y.keypoints[k];
+                if (p.pt != q.pt || p.size != q.size || p.angle != q.angle || p.response != q.response ||
+                    p.octave != q.octave || p.class_id != q.class_id)
+                    return false;
+            }
+            if (!x.descriptors.empty() && cv::norm(x.descriptors, y.descriptors, cv::NORM_INF) != 0.0)
+                return false;
+        }
+        return true;
+    }
+}
+
+int main()
+{
+    TempDir dir("object-detect-cache-test");
+    const fs::path models = dir.path() / "models";
+    fs::create_directories(models);
+
+    // The cache fingerprints the model files, so they have to exist
+    std::vector<ModelViewFiles> files(2);
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        files[i].name = "view" + std::to_string(i);
+        files[i].colorPath = models / (files[i].name + "_color.png");
+        files[i].maskPath = models / (files[i].name + "_mask.png");
+        std::ofstream(files[i].colorPath) << "color " << i;
+    }
+    std::ofstream(files[0].maskPath) << "mask";
+
+    FeatureCache cache(dir.path() / "cache");
+    const uint64_t key = FeatureCache::extractorKey(SiftParams(), DenoiseMode::Bilateral);
+    for (int type : {CV_32F, CV_8U})
+    {
+        std::vector<ViewFeatures> views = {makeView("view0", 200, type, 1), makeView("view1", 0, type, 2)};
+        CHECK(cache.store("004_sugar_box", files, key, views));
+        std::vector<ViewFeatures> loaded;
+        CHECK(cache.load("004_sugar_box", files, key, loaded));
+        CHECK(sameFeatures(loaded, views));
+    }
+
+    // Stale: other extraction settings, another object, or a changed model file
+    std::vector<ViewFeatures> loaded;
+    CHECK(!cache.load("004_sugar_box", files, key + 1, loaded));
+    CHECK(!cache.load("035_power_drill", files, key, loaded));
+    std::ofstream(files[1].colorPath) << "changed content";
+    CHECK(!cache.load("004_sugar_box", files, key, loaded));
+    return check::failures;
+}
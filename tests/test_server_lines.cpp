@@ -0,0 +1,36 @@
+#include <algorithm>
+#include <string>
+#include "check.hpp"
+#include "detection_server.hpp"
+
+namespace
+{
+    // An answer is one line: its only newline is the terminating one
+    bool oneLine(const std::string &line)
+    {
+        return !line.empty() && line.back() == '\n' && std::count(line.begin(), line.end(), '\n') == 1;
+    }
+}
+
+int main()
+{
+    std::string error = serverErrorLine("bad \"path\"\nnext");
+    CHECK(oneLine(error));
+    CHECK(error == "{\"error\":\"bad \\\"path\\\"\\nnext\"}\n");
+
+    ImageRecord record;
+    record.image = "dir/a\nb\r\"c\".png";
+    record.error = "failed to read image\n\tdetail";
+    ObjectRecord object;
+    object.objectKey = "obj\x01";
+    object.strategy = "prosac";
+    object.bestView = "view\"1\"";
+    record.objects.push_back(object);
+    std::string line = serverRecordLine(record);
+    CHECK(oneLine(line));
+    CHECK(line.find("\"image\":\"dir/a\\nb\\r\\\"c\\\".png\"") != std::string::npos);
+    CHECK(line.find("\"error\":\"failed to read image\\n\\tdetail\"") != std::string::npos);
+    CHECK(line.find("obj\\u0001") != std::string::npos);
+    CHECK(line.find("view\\\"1\\\"") != std::string::npos);
+    return check::failures;
+}
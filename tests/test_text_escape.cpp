@@ -0,0 +1,34 @@
+#include <string>
+#include "check.hpp"
+#include "text_escape.hpp"
+
+int main()
+{
+    CHECK(jsonEscape("plain.png") == "plain.png");
+    CHECK(jsonEscape("a\"b\\c") == "a\\\"b\\\\c");
+    CHECK(jsonEscape("line\nbreak\r\ttab") == "line\\nbreak\\r\\ttab");
+    CHECK(jsonEscape(std::string("nul\0bell\a", 9)) == "nul\\u0000bell\\u0007");
+    CHECK(jsonEscape("\x1f") == "\\u001f");
+    CHECK(jsonEscape("caf\xc3\xa9") == "caf\xc3\xa9"); // UTF-8 passes through
+
+    std::string json;
+    appendJsonString(json, "x\ny");
+    CHECK(json == "\"x\\ny\"");
+
+    std::string csv;
+    appendCsvField(csv, "plain");
+    CHECK(csv == "plain");
+    csv.clear();
+    appendCsvField(csv, "a,b");
+    CHECK(csv == "\"a,b\"");
+    csv.clear();
+    appendCsvField(csv, "say \"hi\"");
+    CHECK(csv == "\"say \"\"hi\"\"\"");
+    csv.clear();
+    appendCsvField(csv, "two\nlines");
+    CHECK(csv == "\"two\nlines\"");
+    csv.clear();
+    appendCsvField(csv, "cr\r");
+    CHECK(csv == "\"cr\r\"");
+    return check::failures;
+}
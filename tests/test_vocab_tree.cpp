@@ -0,0 +1,61 @@
+#include <opencv2/opencv.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "temp_dir.hpp"
+#include "vocab_tree.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Rows scattered around a centre of their own, so every document has its own words
+    cv::Mat cluster(int rows, float centre, uint64_t seed)
+    {
+        cv::Mat noise(rows, 128, CV_32F);
+        cv::RNG(seed).fill(noise, cv::RNG::NORMAL, cv::Scalar(0), cv::Scalar(4));
+        return noise + centre;
+    }
+}
+
+int main()
+{
+    TempDir dir("object-detect-vocab-test");
+    const fs::path treePath = dir.path() / "vocab.float.tree";
+
+    std::vector<VocabDocument> docs = {{"004_sugar_box", "view0"}, {"004_sugar_box", "view1"}, {"035_power_drill", "view0"}};
+    std::vector<cv::Mat> descriptors;
+    for (size_t d = 0; d < docs.size(); ++d)
+        descriptors.push_back(cluster(60, 40.0f * (d + 1), d + 1));
+
+    VocabTreeParams params;
+    params.branching = 4;
+    params.depth = 2;
+    CHECK(VocabularyTree::build(docs, descriptors, params, treePath));
+
+    VocabularyTree tree;
+    CHECK(tree.load(treePath));
+    CHECK(tree.documentCount() == docs.size());
+    for (size_t d = 0; d < docs.size() && d < tree.documentCount(); ++d)
+        CHECK(tree.document(d).objectKey == docs[d].objectKey && tree.document(d).viewName == docs[d].viewName);
+
+    // A document's own descriptors rank it first, also as bytes
+    for (size_t d = 0; d < docs.size(); ++d)
+    {
+        std::vector<VocabCandidate> ranked = tree.query(descriptors[d], 1);
+        CHECK(ranked.size() == 1 && ranked[0].doc == d);
+        cv::Mat bytes;
+        descriptors[d].convertTo(bytes, CV_8U);
+        ranked = tree.query(bytes, 1);
+        CHECK(ranked.size() == 1 && ranked[0].doc == d);
+    }
+
+    // A truncated file is rejected
+    std::vector<char> head(64);
+    std::ifstream(treePath, std::ios::binary).read(head.data(), head.size());
+    std::ofstream(treePath, std::ios::binary | std::ios::trunc).write(head.data(), head.size());
+    VocabularyTree truncated;
+    CHECK(!truncated.load(treePath));
+    return check::failures;
+}